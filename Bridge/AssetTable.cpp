@@ -0,0 +1,252 @@
+/**
+ * AssetTable.cpp
+ *
+ * Minimal perfect hash asset tables: lookup, reload and the builder.
+ */
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include "AssetTable.h"
+
+#define DIRECT_SLOT         0x80000000u
+#define KEYS_PER_BUCKET     4
+
+static uint64_t hashId(const uint8_t *id, size_t length) {
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < length; i++)
+        h = (h ^ id[i]) * 1099511628211ull;
+    return h;
+}
+
+static uint64_t mix(uint64_t h, uint32_t seed) {
+    h ^= (uint64_t) seed * 0x9E3779B97F4A7C15ull;
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+AssetTable::AssetTable()
+        : base_(MAP_FAILED), size_(0), header_(NULL), seeds_(NULL), slots_(NULL), blob_(NULL) {
+}
+
+AssetTable::~AssetTable() {
+    if (base_ != MAP_FAILED)
+        munmap(base_, size_);
+}
+
+bool AssetTable::open(const char *path) {
+    struct stat st;
+    int fd = ::open(path, O_RDONLY);
+
+    if (fd < 0)
+        return false;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(AssetFileHeader)) {
+        close(fd);
+        return false;
+    }
+    base_ = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base_ == MAP_FAILED)
+        return false;
+    size_ = (size_t) st.st_size;
+
+    const uint8_t *base = (const uint8_t *) base_;
+    const AssetFileHeader *header = (const AssetFileHeader *) base;
+    if (header->magic != ASSET_MAGIC || header->buckets == 0 ||
+        header->seedsOffset + (uint64_t) header->buckets * sizeof(uint32_t) > size_ ||
+        header->slotsOffset + (uint64_t) header->count * sizeof(AssetSlot) > size_ ||
+        header->blobOffset + header->blobSize > size_)
+        return false;
+    header_ = header;
+    seeds_ = (const uint32_t *) (base + header->seedsOffset);
+    slots_ = (const AssetSlot *) (base + header->slotsOffset);
+    blob_ = base + header->blobOffset;
+    return true;
+}
+
+const char *AssetTable::lookup(const uint8_t *id, size_t length, size_t &valueLength) const {
+    if (header_ == NULL || header_->count == 0)
+        return NULL;
+
+    uint64_t h = hashId(id, length);
+    uint32_t seed = seeds_[(h >> 32) % header_->buckets];
+    uint32_t slot = (seed & DIRECT_SLOT) ? seed & ~DIRECT_SLOT : (uint32_t) (mix(h, seed) % header_->count);
+    if (slot >= header_->count)
+        return NULL;
+
+    // Unknown IDs land on some slot too, so the key decides
+    const AssetSlot &s = slots_[slot];
+    if (s.key + 1 + length > header_->blobSize || blob_[s.key] != length ||
+        memcmp(blob_ + s.key + 1, id, length) != 0 || s.value + 2 > header_->blobSize)
+        return NULL;
+    valueLength = blob_[s.value] | (blob_[s.value + 1] << 8);
+    if (s.value + 2 + valueLength > header_->blobSize)
+        return NULL;
+    return (const char *) blob_ + s.value + 2;
+}
+
+bool AssetTable::build(const std::vector<AssetRecord> &records, const char *path) {
+    uint32_t count = (uint32_t) records.size();
+    uint32_t buckets = count / KEYS_PER_BUCKET + 1;
+    std::vector<uint64_t> hashes(count);
+    std::vector<std::vector<uint32_t> > members(buckets);
+    std::vector<uint32_t> seeds(buckets, 0);
+    std::vector<AssetSlot> slots(count);
+    std::vector<uint8_t> taken(count, 0);
+    std::vector<uint8_t> blob;
+
+    for (uint32_t i = 0; i < count; i++) {
+        const AssetRecord &r = records[i];
+        if (r.id.size() > 255 || r.json.size() > ASSET_MAX_VALUE)
+            return false;
+        hashes[i] = hashId(r.id.empty() ? NULL : &r.id[0], r.id.size());
+        members[(hashes[i] >> 32) % buckets].push_back(i);
+    }
+
+    // Place the biggest buckets first, while most slots are still free
+    std::vector<uint32_t> order(buckets);
+    for (uint32_t b = 0; b < buckets; b++)
+        order[b] = b;
+    std::sort(order.begin(), order.end(), [&members](uint32_t a, uint32_t b) {
+        return members[a].size() > members[b].size();
+    });
+
+    uint32_t nextFree = 0;
+    std::vector<uint32_t> placed;
+    for (uint32_t o = 0; o < buckets; o++) {
+        const std::vector<uint32_t> &keys = members[order[o]];
+        if (keys.empty())
+            break;
+        if (keys.size() == 1) {
+            // A lone key takes any free slot directly
+            while (taken[nextFree])
+                nextFree++;
+            taken[nextFree] = 1;
+            seeds[order[o]] = DIRECT_SLOT | nextFree;
+            slots[nextFree].key = keys[0];
+            continue;
+        }
+        // Keys with the same hash would never separate; only duplicate IDs get here in practice
+        for (size_t a = 0; a < keys.size(); a++) {
+            for (size_t b = a + 1; b < keys.size(); b++) {
+                if (hashes[keys[a]] == hashes[keys[b]])
+                    return false;
+            }
+        }
+        for (uint32_t seed = 1; seed != DIRECT_SLOT; seed++) {
+            placed.clear();
+            for (size_t k = 0; k < keys.size(); k++) {
+                uint32_t slot = (uint32_t) (mix(hashes[keys[k]], seed) % count);
+                if (taken[slot])
+                    break;
+                taken[slot] = 1;
+                placed.push_back(slot);
+            }
+            if (placed.size() == keys.size()) {
+                seeds[order[o]] = seed;
+                for (size_t k = 0; k < keys.size(); k++)
+                    slots[placed[k]].key = keys[k];
+                break;
+            }
+            for (size_t k = 0; k < placed.size(); k++)
+                taken[placed[k]] = 0;
+        }
+        if (seeds[order[o]] == 0)
+            return false;
+    }
+
+    // Lay out keys and values in slot order; slots[].key still holds the record index
+    for (uint32_t s = 0; s < count; s++) {
+        const AssetRecord &r = records[slots[s].key];
+        slots[s].key = (uint32_t) blob.size();
+        blob.push_back((uint8_t) r.id.size());
+        blob.insert(blob.end(), r.id.begin(), r.id.end());
+        slots[s].value = (uint32_t) blob.size();
+        blob.push_back((uint8_t) r.json.size());
+        blob.push_back((uint8_t) (r.json.size() >> 8));
+        blob.insert(blob.end(), r.json.begin(), r.json.end());
+    }
+
+    AssetFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = ASSET_MAGIC;
+    header.count = count;
+    header.buckets = buckets;
+    header.seedsOffset = sizeof(header);
+    header.slotsOffset = header.seedsOffset + (uint64_t) buckets * sizeof(uint32_t);
+    header.blobOffset = header.slotsOffset + (uint64_t) count * sizeof(AssetSlot);
+    header.blobSize = blob.size();
+
+    std::string tmp = std::string(path) + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (f == NULL)
+        return false;
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+              fwrite(&seeds[0], sizeof(uint32_t), buckets, f) == buckets &&
+              (count == 0 || fwrite(&slots[0], sizeof(AssetSlot), count, f) == count) &&
+              (blob.empty() || fwrite(&blob[0], 1, blob.size(), f) == blob.size());
+    ok = fflush(f) == 0 && fsync(fileno(f)) == 0 && ok;
+    fclose(f);
+    if (!ok || rename(tmp.c_str(), path) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+AssetCatalog::AssetCatalog(const char *path) : path_(path), inode_(0), mtime_(0) {
+}
+
+bool AssetCatalog::refresh() {
+    struct stat st;
+
+    if (stat(path_.c_str(), &st) != 0)
+        return false;
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (table_ && st.st_ino == inode_ && st.st_mtime == mtime_)
+            return true;
+    }
+
+    // Map outside the lock; lookups keep using the old table meanwhile
+    std::shared_ptr<AssetTable> table(new AssetTable());
+    if (!table->open(path_.c_str()))
+        return false;
+    std::lock_guard<std::mutex> guard(lock_);
+    table_ = table;
+    inode_ = st.st_ino;
+    mtime_ = st.st_mtime;
+    return true;
+}
+
+std::shared_ptr<const AssetTable> AssetCatalog::snapshot() {
+    std::lock_guard<std::mutex> guard(lock_);
+    return table_;
+}
+
+size_t AppendAssetJson(const AssetTable *table, const TagKey &tag, char *json, size_t length, size_t size) {
+    static const char key[] = ",\"asset\":";
+    size_t valueLength;
+    const char *value;
+
+    if (table == NULL || length == 0 || json[length - 1] != '}')
+        return length;
+    value = table->lookup(tag.id, tag.idLength, valueLength);
+    if (value == NULL || length + sizeof(key) - 1 + valueLength + 1 > size)
+        return length;
+    // Reopen the object, add the metadata and close it again
+    length--;
+    memcpy(json + length, key, sizeof(key) - 1);
+    length += sizeof(key) - 1;
+    memcpy(json + length, value, valueLength);
+    length += valueLength;
+    json[length++] = '}';
+    return length;
+}
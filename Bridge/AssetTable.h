@@ -0,0 +1,120 @@
+/**
+ * AssetTable.h
+ *
+ * Read-only asset metadata keyed by tag ID, stored in a file that is
+ * memory-mapped as is and indexed by a minimal perfect hash, so a
+ * lookup costs one hash, two array reads and one key comparison
+ * however many assets there are. Files are built offline from CSV by
+ * skyetek_assets. Layout, in host byte order:
+ *
+ *   AssetFileHeader
+ *   seeds       uint32 x buckets   per bucket: hash seed, or slot | 0x80000000
+ *   slots       AssetSlot x count  offsets of each entry's key and value
+ *   blob        keys as 1 byte length + ID bytes,
+ *               values as 2 byte length + JSON object text
+ *
+ * A key's bucket is hash(id) >> 32 modulo buckets; its slot is the
+ * bucket's direct slot, or mix(hash(id), seed) modulo count. The
+ * builder picks seeds so that every key gets its own slot.
+ *
+ * AssetCatalog watches the file and swaps in a new table when the file
+ * is replaced (e.g. renamed over), without stopping lookups in flight.
+ */
+#ifndef BRIDGE_ASSET_TABLE_H
+#define BRIDGE_ASSET_TABLE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "TagEvent.h"
+
+#define ASSET_MAGIC         0x31414B53  // "SKA1"
+#define ASSET_MAX_VALUE     1024
+
+struct AssetFileHeader {
+    uint32_t magic;
+    uint32_t count;
+    uint32_t buckets;
+    uint32_t reserved;
+    uint64_t seedsOffset;
+    uint64_t slotsOffset;
+    uint64_t blobOffset;
+    uint64_t blobSize;
+};
+
+struct AssetSlot {
+    uint32_t key;
+    uint32_t value;
+};
+
+/** One row of the builder's input. */
+struct AssetRecord {
+    std::vector<uint8_t> id;
+    std::string json;       // metadata as a JSON object
+};
+
+class AssetTable {
+public:
+    AssetTable();
+    ~AssetTable();
+
+    /** Maps a table file; returns false if it is missing or malformed. */
+    bool open(const char *path);
+
+    /**
+     * Looks up the metadata of a tag ID.
+     * @return JSON object text, not NUL terminated, or NULL if unknown
+     */
+    const char *lookup(const uint8_t *id, size_t length, size_t &valueLength) const;
+
+    uint32_t size() const { return header_ ? header_->count : 0; }
+
+    /**
+     * Builds a table file from records with distinct IDs. Writes
+     * path.tmp and renames it over path, so readers never see a
+     * partial file.
+     */
+    static bool build(const std::vector<AssetRecord> &records, const char *path);
+
+private:
+    void *base_;
+    size_t size_;
+    const AssetFileHeader *header_;
+    const uint32_t *seeds_;
+    const AssetSlot *slots_;
+    const uint8_t *blob_;
+
+    AssetTable(const AssetTable &);
+    AssetTable &operator=(const AssetTable &);
+};
+
+/** The current table of a path, reloaded when the file changes. */
+class AssetCatalog {
+public:
+    explicit AssetCatalog(const char *path);
+
+    /** Loads the file if it was replaced since the last call; returns false if loading failed. */
+    bool refresh();
+
+    /** Table to use for a lookup or batch; stays valid while held. */
+    std::shared_ptr<const AssetTable> snapshot();
+
+private:
+    std::string path_;
+    std::mutex lock_;
+    std::shared_ptr<const AssetTable> table_;
+    ino_t inode_;
+    time_t mtime_;
+};
+
+/**
+ * Adds "asset":{...} to the JSON object in json if the table knows the
+ * tag; returns the new length, or length if the tag is unknown or the
+ * buffer is too small.
+ */
+size_t AppendAssetJson(const AssetTable *table, const TagKey &tag, char *json, size_t length, size_t size);
+
+#endif
@@ -0,0 +1,29 @@
+/**
+ * BatchCodec.cpp
+ *
+ * JSON batch encoding.
+ */
+#include "AssetTable.h"
+#include "BatchCodec.h"
+
+void JsonBatchCodec::encode(const TagEvent *events, size_t count, std::vector<uint8_t> &out) {
+    char buf[512 + ASSET_MAX_VALUE];
+    std::shared_ptr<const AssetTable> table;
+
+    // One table for the whole batch, even if it is swapped meanwhile
+    if (assets_ != NULL)
+        table = assets_->snapshot();
+
+    out.clear();
+    out.push_back('[');
+    for (size_t i = 0; i < count; i++) {
+        size_t len = FormatTagEventJson(events[i], buf, sizeof(buf));
+        if (len == 0)
+            continue;
+        len = AppendAssetJson(table.get(), events[i].tag, buf, len, sizeof(buf));
+        if (out.size() > 1)
+            out.push_back(',');
+        out.insert(out.end(), buf, buf + len);
+    }
+    out.push_back(']');
+}
@@ -0,0 +1,37 @@
+/**
+ * BatchCodec.h
+ *
+ * Encodes a batch of tag events into one MQTT payload.
+ */
+#ifndef BRIDGE_BATCH_CODEC_H
+#define BRIDGE_BATCH_CODEC_H
+
+#include <stdint.h>
+#include <vector>
+#include "TagEvent.h"
+
+class AssetCatalog;
+
+class BatchCodec {
+public:
+    virtual ~BatchCodec() {}
+
+    /** Replaces out with the encoded batch. */
+    virtual void encode(const TagEvent *events, size_t count, std::vector<uint8_t> &out) = 0;
+};
+
+/**
+ * JSON array of the objects produced by FormatTagEventJson(), with the
+ * asset metadata of known tags added when a catalog is given.
+ */
+class JsonBatchCodec : public BatchCodec {
+public:
+    explicit JsonBatchCodec(AssetCatalog *assets = NULL) : assets_(assets) {}
+
+    void encode(const TagEvent *events, size_t count, std::vector<uint8_t> &out);
+
+private:
+    AssetCatalog *assets_;
+};
+
+#endif
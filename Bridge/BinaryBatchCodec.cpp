@@ -0,0 +1,160 @@
+/**
+ * BinaryBatchCodec.cpp
+ *
+ * Binary batch encoding with sorted, prefix-compressed tag IDs.
+ */
+#include <algorithm>
+#include "BinaryBatchCodec.h"
+
+#define EVENT_KIND_MASK     0x03
+#define EVENT_HAS_SPAN      0x04
+
+static void putVarint(std::vector<uint8_t> &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((uint8_t) (value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t) value);
+}
+
+static bool getVarint(const uint8_t *&p, const uint8_t *end, uint64_t &value) {
+    value = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t b = *p++;
+        value |= (uint64_t) (b & 0x7F) << shift;
+        if (!(b & 0x80))
+            return true;
+    }
+    return false;
+}
+
+static bool idLess(const TagEvent *a, const TagEvent *b) {
+    size_t n = std::min(a->tag.idLength, b->tag.idLength);
+    int c = memcmp(a->tag.id, b->tag.id, n);
+    if (c != 0)
+        return c < 0;
+    if (a->tag.idLength != b->tag.idLength)
+        return a->tag.idLength < b->tag.idLength;
+    return a->tag.type < b->tag.type;
+}
+
+void BinaryBatchCodec::encode(const TagEvent *events, size_t count, std::vector<uint8_t> &out) {
+    uint64_t base = UINT64_MAX;
+    size_t ridLength = count > 0 ? strlen(events[0].rid) : 0;
+
+    order_.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        order_[i] = &events[i];
+        base = std::min(base, events[i].timestamp);
+        if (events[i].count != 1 || events[i].firstSeen != events[i].timestamp ||
+            events[i].lastSeen != events[i].timestamp)
+            base = std::min(base, std::min(events[i].firstSeen, events[i].lastSeen));
+    }
+    if (count == 0)
+        base = 0;
+    std::sort(order_.begin(), order_.end(), idLess);
+
+    out.clear();
+    out.push_back('S');
+    out.push_back('B');
+    out.push_back(BINARY_BATCH_VERSION);
+    out.push_back(0);
+    out.push_back((uint8_t) ridLength);
+    if (ridLength > 0)
+        out.insert(out.end(), events[0].rid, events[0].rid + ridLength);
+    for (int i = 0; i < 8; i++)
+        out.push_back((uint8_t) (base >> (8 * i)));
+    putVarint(out, count);
+
+    const TagKey *prev = NULL;
+    for (size_t i = 0; i < count; i++) {
+        const TagEvent &e = *order_[i];
+        bool span = e.count != 1 || e.firstSeen != e.timestamp || e.lastSeen != e.timestamp;
+        uint8_t shared = 0;
+
+        if (prev != NULL) {
+            size_t n = std::min(prev->idLength, e.tag.idLength);
+            while (shared < n && prev->id[shared] == e.tag.id[shared])
+                shared++;
+        }
+        out.push_back((uint8_t) ((e.kind & EVENT_KIND_MASK) | (span ? EVENT_HAS_SPAN : 0)));
+        putVarint(out, e.tag.type);
+        putVarint(out, e.timestamp - base);
+        out.push_back(shared);
+        out.push_back((uint8_t) (e.tag.idLength - shared));
+        out.insert(out.end(), e.tag.id + shared, e.tag.id + e.tag.idLength);
+        if (span) {
+            putVarint(out, e.firstSeen - base);
+            putVarint(out, e.lastSeen - base);
+            putVarint(out, e.count);
+        }
+        prev = &e.tag;
+    }
+}
+
+bool BinaryBatchCodec::decode(const uint8_t *data, size_t length, std::vector<TagEvent> &events) {
+    const uint8_t *p = data;
+    const uint8_t *end = data + length;
+    char rid[TAG_EVENT_MAX_RID];
+    uint64_t base = 0, count, value;
+    TagKey prev;
+
+    events.clear();
+    if (length < 5 || p[0] != 'S' || p[1] != 'B' || p[2] != BINARY_BATCH_VERSION)
+        return false;
+    p += 4;
+    size_t ridLength = *p++;
+    if ((size_t) (end - p) < ridLength + 8)
+        return false;
+    size_t keep = std::min(ridLength, sizeof(rid) - 1);
+    memcpy(rid, p, keep);
+    rid[keep] = '\0';
+    p += ridLength;
+    for (int i = 0; i < 8; i++)
+        base |= (uint64_t) *p++ << (8 * i);
+    if (!getVarint(p, end, count))
+        return false;
+
+    for (uint64_t i = 0; i < count; i++) {
+        TagEvent e;
+        uint8_t header, shared, suffix;
+
+        if (p >= end)
+            return false;
+        header = *p++;
+        e.kind = (TagEventKind) (header & EVENT_KIND_MASK);
+        memcpy(e.rid, rid, sizeof(rid));
+        if (!getVarint(p, end, value))
+            return false;
+        e.tag.type = (uint16_t) value;
+        if (!getVarint(p, end, value))
+            return false;
+        e.timestamp = base + value;
+        if (end - p < 2)
+            return false;
+        shared = *p++;
+        suffix = *p++;
+        if (shared > prev.idLength || shared + suffix > TAG_EVENT_MAX_ID || end - p < suffix)
+            return false;
+        memcpy(e.tag.id, prev.id, shared);
+        memcpy(e.tag.id + shared, p, suffix);
+        e.tag.idLength = (uint8_t) (shared + suffix);
+        p += suffix;
+        e.firstSeen = e.lastSeen = e.timestamp;
+        e.count = 1;
+        if (header & EVENT_HAS_SPAN) {
+            if (!getVarint(p, end, value))
+                return false;
+            e.firstSeen = base + value;
+            if (!getVarint(p, end, value))
+                return false;
+            e.lastSeen = base + value;
+            if (!getVarint(p, end, value))
+                return false;
+            e.count = (uint32_t) value;
+        }
+        prev = e.tag;
+        events.push_back(e);
+    }
+    return true;
+}
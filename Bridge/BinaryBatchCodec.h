@@ -0,0 +1,52 @@
+/**
+ * BinaryBatchCodec.h
+ *
+ * Compact binary batch payload, version 1. Integers marked varint are
+ * unsigned LEB128; fixed-width integers are little endian.
+ *
+ *   magic       2 bytes   'S' 'B'
+ *   version     1 byte    1
+ *   flags       1 byte    0, reserved
+ *   ridLength   1 byte
+ *   rid         ridLength bytes
+ *   baseTime    8 bytes   ms since epoch, minimum of all event times
+ *   count       varint    number of events
+ *   events      count times, sorted by ID bytes then tag type:
+ *     header    1 byte    bits 0-1 kind (0 read, 1 enter, 2 leave, 3 window),
+ *                         bit 2 span present
+ *     type      varint    SKYETEK_TAGTYPE code
+ *     time      varint    timestamp - baseTime
+ *     shared    1 byte    leading ID bytes shared with the previous event
+ *     suffixLen 1 byte
+ *     suffix    suffixLen bytes
+ *     span, only when header bit 2 is set:
+ *       first   varint    firstSeen - baseTime
+ *       last    varint    lastSeen - baseTime
+ *       count   varint    reads folded into the event
+ *
+ * Without a span, firstSeen and lastSeen equal the timestamp and the
+ * read count is 1.
+ */
+#ifndef BRIDGE_BINARY_BATCH_CODEC_H
+#define BRIDGE_BINARY_BATCH_CODEC_H
+
+#include <string>
+#include "BatchCodec.h"
+
+#define BINARY_BATCH_VERSION 1
+
+class BinaryBatchCodec : public BatchCodec {
+public:
+    void encode(const TagEvent *events, size_t count, std::vector<uint8_t> &out);
+
+    /**
+     * Reference decoder.
+     * @return false if the payload is truncated or not a version 1 batch
+     */
+    static bool decode(const uint8_t *data, size_t length, std::vector<TagEvent> &events);
+
+private:
+    std::vector<const TagEvent *> order_;
+};
+
+#endif
@@ -0,0 +1,26 @@
+/**
+ * Clock.h
+ *
+ * Millisecond clocks shared by the bridge stages.
+ */
+#ifndef BRIDGE_CLOCK_H
+#define BRIDGE_CLOCK_H
+
+#include <stdint.h>
+#include <time.h>
+
+/** Wall clock, milliseconds since the epoch. Used for event timestamps. */
+inline uint64_t WallClockMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/** Monotonic clock in milliseconds. Used for timeouts and deadlines. */
+inline uint64_t MonotonicMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+#endif
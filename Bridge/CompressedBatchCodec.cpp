@@ -0,0 +1,163 @@
+/**
+ * CompressedBatchCodec.cpp
+ *
+ * zstd compression of batch payloads.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "CompressedBatchCodec.h"
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+bool ReadFile(const char *path, std::vector<uint8_t> &data) {
+    uint8_t buf[4096];
+    size_t n;
+    FILE *f = fopen(path, "rb");
+
+    if (f == NULL)
+        return false;
+    data.clear();
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        data.insert(data.end(), buf, buf + n);
+    fclose(f);
+    return true;
+}
+
+#ifdef HAVE_ZSTD
+static uint64_t threadCpuMicros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+#endif
+
+bool CompressedBatchCodec::available() {
+#ifdef HAVE_ZSTD
+    return true;
+#else
+    return false;
+#endif
+}
+
+CompressedBatchCodec::CompressedBatchCodec(BatchCodec *inner, int level)
+        : inner_(inner), level_(level), cctx_(NULL), cdict_(NULL), dictId_(0) {
+    memset(&stats_, 0, sizeof(stats_));
+#ifdef HAVE_ZSTD
+    cctx_ = ZSTD_createCCtx();
+#endif
+}
+
+CompressedBatchCodec::~CompressedBatchCodec() {
+#ifdef HAVE_ZSTD
+    ZSTD_freeCDict((ZSTD_CDict *) cdict_);
+    ZSTD_freeCCtx((ZSTD_CCtx *) cctx_);
+#endif
+    delete inner_;
+}
+
+bool CompressedBatchCodec::loadDictionary(const char *path) {
+#ifdef HAVE_ZSTD
+    std::vector<uint8_t> dict;
+    if (!ReadFile(path, dict) || dict.empty())
+        return false;
+    // Raw content dictionaries have no ID, so the header could not say
+    // that one was used and decompress() would skip it
+    uint32_t dictId = ZSTD_getDictID_fromDict(&dict[0], dict.size());
+    if (dictId == 0) {
+        fprintf(stderr, "skyetek-mqtt: %s has no dictionary ID, train it with zstd --train\n", path);
+        return false;
+    }
+    ZSTD_CDict *cdict = ZSTD_createCDict(&dict[0], dict.size(), level_);
+    if (cdict == NULL)
+        return false;
+    ZSTD_freeCDict((ZSTD_CDict *) cdict_);
+    cdict_ = cdict;
+    dictId_ = dictId;
+    return true;
+#else
+    (void) path;
+    return false;
+#endif
+}
+
+void CompressedBatchCodec::encode(const TagEvent *events, size_t count, std::vector<uint8_t> &out) {
+    inner_->encode(events, count, raw_);
+#ifdef HAVE_ZSTD
+    uint64_t start = threadCpuMicros();
+    size_t bound = ZSTD_compressBound(raw_.size());
+    size_t n;
+
+    out.resize(COMPRESSED_BATCH_HEADER + bound);
+    out[0] = 'S';
+    out[1] = 'Z';
+    out[2] = COMPRESSED_BATCH_VERSION;
+    out[3] = COMPRESSED_BATCH_ZSTD;
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = (uint8_t) (dictId_ >> (8 * i));
+    if (cdict_ != NULL)
+        n = ZSTD_compress_usingCDict((ZSTD_CCtx *) cctx_, &out[COMPRESSED_BATCH_HEADER], bound,
+                                     &raw_[0], raw_.size(), (const ZSTD_CDict *) cdict_);
+    else
+        n = ZSTD_compressCCtx((ZSTD_CCtx *) cctx_, &out[COMPRESSED_BATCH_HEADER], bound,
+                              &raw_[0], raw_.size(), level_);
+    if (ZSTD_isError(n)) {
+        // Fall back to the uncompressed payload rather than lose the batch
+        out.swap(raw_);
+        return;
+    }
+    out.resize(COMPRESSED_BATCH_HEADER + n);
+
+    uint64_t cpu = threadCpuMicros() - start;
+    stats_.batches++;
+    stats_.rawBytes += raw_.size();
+    stats_.compressedBytes += out.size();
+    stats_.cpuMicros += cpu;
+    printf("skyetek-mqtt: batch of %u events %u -> %u bytes (%.2fx) in %llu us CPU\n",
+           (unsigned int) count, (unsigned int) raw_.size(), (unsigned int) out.size(),
+           (double) raw_.size() / out.size(), (unsigned long long) cpu);
+#else
+    out.swap(raw_);
+#endif
+}
+
+bool CompressedBatchCodec::decompress(const uint8_t *data, size_t length,
+                                      const std::vector<uint8_t> *dictionary, std::vector<uint8_t> &out) {
+    if (length < COMPRESSED_BATCH_HEADER || data[0] != 'S' || data[1] != 'Z' ||
+        data[2] != COMPRESSED_BATCH_VERSION || data[3] != COMPRESSED_BATCH_ZSTD)
+        return false;
+#ifdef HAVE_ZSTD
+    uint32_t dictId = 0;
+    for (int i = 0; i < 4; i++)
+        dictId |= (uint32_t) data[4 + i] << (8 * i);
+    if (dictId != 0 && (dictionary == NULL || dictionary->empty() ||
+                        ZSTD_getDictID_fromDict(&(*dictionary)[0], dictionary->size()) != dictId))
+        return false;
+
+    const uint8_t *frame = data + COMPRESSED_BATCH_HEADER;
+    size_t frameLength = length - COMPRESSED_BATCH_HEADER;
+    unsigned long long size = ZSTD_getFrameContentSize(frame, frameLength);
+    if (size == ZSTD_CONTENTSIZE_ERROR || size == ZSTD_CONTENTSIZE_UNKNOWN)
+        return false;
+
+    ZSTD_DCtx *dctx = ZSTD_createDCtx();
+    size_t n;
+    out.resize((size_t) size);
+    if (dictId != 0)
+        n = ZSTD_decompress_usingDict(dctx, out.empty() ? NULL : &out[0], out.size(), frame, frameLength,
+                                      &(*dictionary)[0], dictionary->size());
+    else
+        n = ZSTD_decompressDCtx(dctx, out.empty() ? NULL : &out[0], out.size(), frame, frameLength);
+    ZSTD_freeDCtx(dctx);
+    if (ZSTD_isError(n))
+        return false;
+    out.resize(n);
+    return true;
+#else
+    (void) dictionary;
+    (void) out;
+    return false;
+#endif
+}
@@ -0,0 +1,81 @@
+/**
+ * CompressedBatchCodec.h
+ *
+ * Wraps another codec and compresses its output with zstd, optionally
+ * against a dictionary trained offline on captured payloads:
+ *
+ *   zstd --train captured/batch-* -o tags.dict
+ *
+ * Compressed payloads start with a header so consumers can tell them
+ * apart from plain JSON ('[' or '{') and binary ('S' 'B') payloads:
+ *
+ *   magic       2 bytes   'S' 'Z'
+ *   version     1 byte    1
+ *   codec       1 byte    1 = zstd
+ *   dictId      4 bytes   little endian zstd dictionary ID, 0 if none
+ *   frame       rest      zstd frame of the inner payload
+ *
+ * Only available when built with HAVE_ZSTD.
+ */
+#ifndef BRIDGE_COMPRESSED_BATCH_CODEC_H
+#define BRIDGE_COMPRESSED_BATCH_CODEC_H
+
+#include <string>
+#include "BatchCodec.h"
+
+#define COMPRESSED_BATCH_VERSION    1
+#define COMPRESSED_BATCH_ZSTD       1
+#define COMPRESSED_BATCH_HEADER     8
+
+struct CompressionStats {
+    uint64_t batches;
+    uint64_t rawBytes;
+    uint64_t compressedBytes;
+    uint64_t cpuMicros;
+};
+
+class CompressedBatchCodec : public BatchCodec {
+public:
+    /** Takes ownership of inner. */
+    CompressedBatchCodec(BatchCodec *inner, int level);
+    ~CompressedBatchCodec();
+
+    /**
+     * Loads a dictionary file trained with zstd --train; returns false if
+     * it cannot be read or used, or has no dictionary ID.
+     */
+    bool loadDictionary(const char *path);
+
+    void encode(const TagEvent *events, size_t count, std::vector<uint8_t> &out);
+
+    /** Cumulative totals since construction. */
+    CompressionStats stats() const { return stats_; }
+
+    /**
+     * Reference decompressor; dictionary may be NULL if the payload
+     * was compressed without one.
+     * @return false if the payload is not a valid compressed batch
+     */
+    static bool decompress(const uint8_t *data, size_t length,
+                           const std::vector<uint8_t> *dictionary, std::vector<uint8_t> &out);
+
+    /** True if the bridge was built with compression support. */
+    static bool available();
+
+private:
+    BatchCodec *inner_;
+    int level_;
+    void *cctx_;
+    void *cdict_;
+    uint32_t dictId_;
+    std::vector<uint8_t> raw_;
+    CompressionStats stats_;
+
+    CompressedBatchCodec(const CompressedBatchCodec &);
+    CompressedBatchCodec &operator=(const CompressedBatchCodec &);
+};
+
+/** Reads a whole file; returns false on error. */
+bool ReadFile(const char *path, std::vector<uint8_t> &data);
+
+#endif
@@ -0,0 +1,148 @@
+/**
+ * EventBatcher.cpp
+ *
+ * Count- and deadline-driven batching of tag events.
+ */
+#include <stdio.h>
+#include <chrono>
+#include "Clock.h"
+#include "EventBatcher.h"
+
+EventBatcher::EventBatcher(MqttPublisher *publisher, const char *topic, BatchCodec *codec,
+                           size_t maxCount, uint32_t maxLatencyMs, const ShedPolicy &shed)
+        : publisher_(publisher), topic_(topic), codec_(codec),
+          maxCount_(maxCount ? maxCount : 1), maxLatencyMs_(maxLatencyMs), shed_(shed),
+          oldest_(0), stopping_(false), inFlight_(0), indexed_(0),
+          collapsed_(0), sampled_(0), dropped_(0), reported_(0), batches_(0), events_(0) {
+    if (shed_.sampleEvery == 0)
+        shed_.sampleEvery = 1;
+    queue_.reserve(maxCount_);
+    thread_ = std::thread(&EventBatcher::run, this);
+}
+
+EventBatcher::~EventBatcher() {
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+}
+
+void EventBatcher::onEvent(const TagEvent &event) {
+    bool notify;
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (!admit(event))
+            return;
+        if (queue_.empty())
+            oldest_ = MonotonicMs();
+        queue_.push_back(event);
+        // Wake for a full batch, or so the thread arms the deadline of a new one
+        notify = queue_.size() == 1 || queue_.size() >= maxCount_;
+    }
+    if (notify)
+        wake_.notify_one();
+}
+
+// Called with lock_ held; false if the event was folded, sampled out or dropped
+bool EventBatcher::admit(const TagEvent &event) {
+    size_t depth = queue_.size() + inFlight_;
+
+    if (shed_.collapseAt == 0 || depth < shed_.collapseAt) {
+        // Back to normal, the next overload starts from scratch
+        if (!seen_.empty())
+            seen_.clear();
+        return true;
+    }
+
+    // Folding loses nothing but the individual timestamps, so it comes first
+    if (event.kind == TAG_EVENT_READ) {
+        for (; indexed_ < queue_.size(); indexed_++) {
+            if (queue_[indexed_].kind == TAG_EVENT_READ)
+                queued_[queue_[indexed_].tag] = indexed_;
+        }
+        std::unordered_map<TagKey, size_t, TagKeyHash>::iterator it = queued_.find(event.tag);
+        if (it != queued_.end()) {
+            TagEvent &queued = queue_[it->second];
+            queued.count += event.count;
+            if (event.lastSeen > queued.lastSeen)
+                queued.lastSeen = event.lastSeen;
+            seen_[event.tag]++;
+            collapsed_++;
+            return false;
+        }
+    }
+    if (shed_.dropAt != 0 && depth >= shed_.dropAt) {
+        dropped_++;
+        return false;
+    }
+    if (event.kind == TAG_EVENT_READ) {
+        uint32_t &reads = seen_[event.tag];
+        // The first read of a tag always goes through, repeats are thinned out
+        if (shed_.sampleAt != 0 && depth >= shed_.sampleAt && reads > 0 && reads % shed_.sampleEvery != 0) {
+            reads++;
+            sampled_++;
+            return false;
+        }
+        reads++;
+    }
+    return true;
+}
+
+void EventBatcher::run() {
+    std::vector<TagEvent> batch;
+    batch.reserve(maxCount_);
+
+    std::unique_lock<std::mutex> guard(lock_);
+    for (;;) {
+        if (queue_.empty()) {
+            if (stopping_)
+                break;
+            wake_.wait(guard);
+            continue;
+        }
+        uint64_t deadline = oldest_ + maxLatencyMs_;
+        uint64_t now = MonotonicMs();
+        if (queue_.size() < maxCount_ && now < deadline && !stopping_) {
+            wake_.wait_for(guard, std::chrono::milliseconds(deadline - now));
+            continue;
+        }
+
+        batch.swap(queue_);
+        inFlight_ = batch.size();
+        queued_.clear();
+        indexed_ = 0;
+        guard.unlock();
+        publish(batch);
+        batch.clear();
+        guard.lock();
+        // One line per batch while shedding, so the log shows when and how much
+        uint64_t shed = collapsed_ + sampled_ + dropped_;
+        if (shed != reported_) {
+            printf("skyetek-mqtt: %s overloaded, %u events waiting: %llu folded, %llu sampled out, %llu dropped\n",
+                   topic_.c_str(), (unsigned int) queue_.size(), (unsigned long long) collapsed_,
+                   (unsigned long long) sampled_, (unsigned long long) dropped_);
+            reported_ = shed;
+        }
+    }
+}
+
+void EventBatcher::publish(std::vector<TagEvent> &batch) {
+    // Events that piled up while publishing go out in maxCount-sized messages
+    for (size_t first = 0; first < batch.size(); first += maxCount_) {
+        size_t count = batch.size() - first;
+        int rc;
+
+        if (count > maxCount_)
+            count = maxCount_;
+        codec_->encode(&batch[first], count, payload_);
+        rc = publisher_->publish(topic_.c_str(), &payload_[0], payload_.size());
+        if (rc != MQTTCLIENT_SUCCESS)
+            printf("skyetek-mqtt: batch of %u events on %s failed, return code %d\n",
+                   (unsigned int) count, topic_.c_str(), rc);
+        batches_++;
+        events_ += count;
+        inFlight_ -= count;
+    }
+}
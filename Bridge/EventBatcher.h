@@ -0,0 +1,98 @@
+/**
+ * EventBatcher.h
+ *
+ * Gathers the events of one topic and publishes them as a single
+ * message once maxCount events are queued or the oldest queued event
+ * is maxLatencyMs old, whichever comes first. Publishing happens on
+ * the batcher's own thread, so the reader loop only appends.
+ *
+ * If publishing falls behind, a ShedPolicy keeps the backlog bounded
+ * instead: past each watermark the batcher first folds reads of a tag
+ * into the one already queued, then admits only every Nth further read
+ * of tags it already passed on, and finally drops new events. Only
+ * TAG_EVENT_READ events are folded or sampled; the others can only be
+ * dropped.
+ */
+#ifndef BRIDGE_EVENT_BATCHER_H
+#define BRIDGE_EVENT_BATCHER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "BatchCodec.h"
+#include "MqttPublisher.h"
+#include "TagEvent.h"
+
+/** Backlog depths in events at which each shedding stage starts; 0 disables it. */
+struct ShedPolicy {
+    size_t collapseAt;
+    size_t sampleAt;
+    size_t dropAt;
+    uint32_t sampleEvery;   // repeat reads admitted while sampling, 1 in N
+
+    ShedPolicy() : collapseAt(0), sampleAt(0), dropAt(0), sampleEvery(10) {}
+};
+
+class EventBatcher : public EventSink {
+public:
+    /**
+     * @param publisher Client to publish on
+     * @param topic Topic of every batch
+     * @param codec Payload encoding, owned by the caller
+     * @param maxCount Flush when this many events are queued
+     * @param maxLatencyMs Flush when the oldest event is this old
+     * @param shed Overload handling, off by default
+     */
+    EventBatcher(MqttPublisher *publisher, const char *topic, BatchCodec *codec,
+                 size_t maxCount, uint32_t maxLatencyMs, const ShedPolicy &shed = ShedPolicy());
+
+    /** Flushes whatever is queued and stops the thread. */
+    ~EventBatcher();
+
+    void onEvent(const TagEvent &event);
+
+    uint64_t batches() const { return batches_; }
+    uint64_t events() const { return events_; }
+    uint64_t collapsed() const { return collapsed_; }
+    uint64_t sampled() const { return sampled_; }
+    uint64_t dropped() const { return dropped_; }
+
+private:
+    void run();
+    void publish(std::vector<TagEvent> &batch);
+    bool admit(const TagEvent &event);
+
+    MqttPublisher *publisher_;
+    std::string topic_;
+    BatchCodec *codec_;
+    size_t maxCount_;
+    uint32_t maxLatencyMs_;
+    ShedPolicy shed_;
+
+    std::mutex lock_;
+    std::condition_variable wake_;
+    std::vector<TagEvent> queue_;
+    uint64_t oldest_;           // monotonic ms when the head of queue_ arrived
+    bool stopping_;
+    std::atomic<size_t> inFlight_;  // events of the batch being published not yet sent
+
+    // Overload state, guarded by lock_
+    std::unordered_map<TagKey, size_t, TagKeyHash> queued_;    // queue_ index of a tag's read
+    size_t indexed_;                // queue_ entries already in queued_
+    std::unordered_map<TagKey, uint32_t, TagKeyHash> seen_;    // reads per tag since the overload began
+    uint64_t collapsed_;
+    uint64_t sampled_;
+    uint64_t dropped_;
+    uint64_t reported_;             // shed events already logged, publisher thread only
+
+    std::vector<uint8_t> payload_;
+    uint64_t batches_;
+    uint64_t events_;
+    std::thread thread_;
+};
+
+#endif
@@ -0,0 +1,236 @@
+/**
+ * HistoryStore.cpp
+ *
+ * Columnar tag read segments and their read-only views.
+ */
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include "HistoryStore.h"
+
+#define ALIGN_UP(n, a)      (((n) + (a) - 1) / (a) * (a))
+
+static const size_t TS_OFFSET = ALIGN_UP(sizeof(HistoryHeader), 4096);
+static const size_t ID_OFFSET_OFFSET = TS_OFFSET + sizeof(uint64_t) * HISTORY_ROWS;
+static const size_t TYPE_OFFSET = ID_OFFSET_OFFSET + sizeof(uint32_t) * HISTORY_ROWS;
+static const size_t READER_OFFSET = TYPE_OFFSET + sizeof(uint16_t) * HISTORY_ROWS;
+static const size_t ID_LENGTH_OFFSET = READER_OFFSET + HISTORY_ROWS;
+static const size_t IDS_OFFSET = ID_LENGTH_OFFSET + HISTORY_ROWS;
+static const size_t FILE_SIZE = IDS_OFFSET + HISTORY_ID_BYTES;
+
+uint64_t HistoryIdHash(const uint8_t *id, size_t length) {
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < length; i++)
+        h = (h ^ id[i]) * 1099511628211ull;
+    // FNV leaves the high bits poorly mixed; both halves feed the probes
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+// Probe i is at h1 + i * h2, with the two halves of the hash as h1 and h2
+static void bloomAdd(uint64_t *bloom, uint64_t h) {
+    uint32_t bit = (uint32_t) h, step = (uint32_t) (h >> 32) | 1;
+    for (int i = 0; i < HISTORY_BLOOM_PROBES; i++, bit += step)
+        bloom[(bit % HISTORY_BLOOM_BITS) >> 6] |= (uint64_t) 1 << (bit & 0x3F);
+}
+
+static bool bloomTest(const uint64_t *bloom, uint64_t h) {
+    uint32_t bit = (uint32_t) h, step = (uint32_t) (h >> 32) | 1;
+    for (int i = 0; i < HISTORY_BLOOM_PROBES; i++, bit += step) {
+        if (!(bloom[(bit % HISTORY_BLOOM_BITS) >> 6] & ((uint64_t) 1 << (bit & 0x3F))))
+            return false;
+    }
+    return true;
+}
+
+bool ListHistorySegments(const char *dir, std::vector<std::string> &paths) {
+    std::vector<std::string> names;
+    struct dirent *entry;
+    DIR *d = opendir(dir);
+
+    if (d == NULL)
+        return false;
+    while ((entry = readdir(d)) != NULL) {
+        char *end;
+        strtoull(entry->d_name, &end, 16);
+        if (end == entry->d_name + 16 && strcmp(end, ".hist") == 0)
+            names.push_back(entry->d_name);
+    }
+    closedir(d);
+    // Fixed-width hex names sort in sequence order
+    std::sort(names.begin(), names.end());
+    paths.clear();
+    for (size_t i = 0; i < names.size(); i++)
+        paths.push_back(std::string(dir) + "/" + names[i]);
+    return true;
+}
+
+HistorySegment::HistorySegment()
+        : base_(MAP_FAILED), size_(0), header_(NULL), rows_(0), ts_(NULL), idOffset_(NULL),
+          type_(NULL), reader_(NULL), idLength_(NULL), ids_(NULL) {
+}
+
+HistorySegment::~HistorySegment() {
+    if (base_ != MAP_FAILED)
+        munmap(base_, size_);
+}
+
+bool HistorySegment::open(const char *path) {
+    struct stat st;
+    int fd = ::open(path, O_RDONLY);
+
+    if (fd < 0)
+        return false;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < FILE_SIZE) {
+        close(fd);
+        return false;
+    }
+    base_ = mmap(NULL, FILE_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base_ == MAP_FAILED)
+        return false;
+    size_ = FILE_SIZE;
+
+    const uint8_t *base = (const uint8_t *) base_;
+    header_ = (const HistoryHeader *) base;
+    if (header_->magic != HISTORY_MAGIC)
+        return false;
+    // Rows up to the count are complete even while the bridge appends
+    rows_ = std::min(header_->rows, (uint32_t) HISTORY_ROWS);
+    __sync_synchronize();
+    ts_ = (const uint64_t *) (base + TS_OFFSET);
+    idOffset_ = (const uint32_t *) (base + ID_OFFSET_OFFSET);
+    type_ = (const uint16_t *) (base + TYPE_OFFSET);
+    reader_ = base + READER_OFFSET;
+    idLength_ = base + ID_LENGTH_OFFSET;
+    ids_ = base + IDS_OFFSET;
+    return true;
+}
+
+bool HistorySegment::blockMayMatch(uint32_t block, uint64_t from, uint64_t to, const uint64_t *idHash) const {
+    const HistoryBlock &b = header_->blocks[block];
+    if (b.maxTs < from || b.minTs > to)
+        return false;
+    return idHash == NULL || bloomTest(b.bloom, *idHash);
+}
+
+HistoryWriter::HistoryWriter(const char *dir)
+        : dir_(dir), seq_(0), base_(NULL), header_(NULL), rows_(0) {
+}
+
+HistoryWriter::~HistoryWriter() {
+    closeSegment();
+}
+
+bool HistoryWriter::open() {
+    std::vector<std::string> paths;
+
+    if (mkdir(dir_.c_str(), 0755) != 0 && errno != EEXIST) {
+        perror(dir_.c_str());
+        return false;
+    }
+    if (!ListHistorySegments(dir_.c_str(), paths))
+        return false;
+    if (!paths.empty())
+        seq_ = strtoull(paths.back().c_str() + dir_.size() + 1, NULL, 16);
+
+    std::lock_guard<std::mutex> guard(lock_);
+    return startSegment();
+}
+
+bool HistoryWriter::startSegment() {
+    char name[32];
+    void *base;
+    int fd;
+
+    closeSegment();
+    snprintf(name, sizeof(name), "/%016llx.hist", (unsigned long long) ++seq_);
+    std::string path = dir_ + name;
+
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        perror(path.c_str());
+        return false;
+    }
+    // Sparse until written
+    if (ftruncate(fd, (off_t) FILE_SIZE) != 0) {
+        perror(path.c_str());
+        close(fd);
+        return false;
+    }
+    base = mmap(NULL, FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        perror(path.c_str());
+        return false;
+    }
+    base_ = (uint8_t *) base;
+    header_ = (HistoryHeader *) base_;
+    header_->magic = HISTORY_MAGIC;
+    readers_.clear();
+    return true;
+}
+
+void HistoryWriter::closeSegment() {
+    if (base_ == NULL)
+        return;
+    munmap(base_, FILE_SIZE);
+    base_ = NULL;
+    header_ = NULL;
+}
+
+bool HistoryWriter::append(const char *rid, uint64_t ts, const TagKey &tag) {
+    std::lock_guard<std::mutex> guard(lock_);
+
+    if (header_ == NULL)
+        return false;
+    std::map<std::string, uint8_t>::iterator it = readers_.find(rid);
+    if (header_->rows == HISTORY_ROWS || header_->idBytes + tag.idLength > HISTORY_ID_BYTES ||
+        (it == readers_.end() && header_->readers == HISTORY_MAX_READERS)) {
+        if (!startSegment())
+            return false;
+        it = readers_.end();
+    }
+    if (it == readers_.end()) {
+        uint8_t index = (uint8_t) header_->readers;
+        snprintf(header_->rid[index], TAG_EVENT_MAX_RID, "%s", rid);
+        header_->readers++;
+        it = readers_.insert(std::make_pair(std::string(rid), index)).first;
+    }
+
+    uint32_t row = header_->rows;
+    ((uint64_t *) (base_ + TS_OFFSET))[row] = ts;
+    ((uint32_t *) (base_ + ID_OFFSET_OFFSET))[row] = header_->idBytes;
+    ((uint16_t *) (base_ + TYPE_OFFSET))[row] = tag.type;
+    base_[READER_OFFSET + row] = it->second;
+    base_[ID_LENGTH_OFFSET + row] = tag.idLength;
+    memcpy(base_ + IDS_OFFSET + header_->idBytes, tag.id, tag.idLength);
+    header_->idBytes += tag.idLength;
+
+    HistoryBlock &block = header_->blocks[row / HISTORY_BLOCK];
+    if (row % HISTORY_BLOCK == 0 || ts < block.minTs)
+        block.minTs = ts;
+    if (row % HISTORY_BLOCK == 0 || ts > block.maxTs)
+        block.maxTs = ts;
+    bloomAdd(block.bloom, HistoryIdHash(tag.id, tag.idLength));
+    if (row == 0 || ts < header_->minTs)
+        header_->minTs = ts;
+    if (row == 0 || ts > header_->maxTs)
+        header_->maxTs = ts;
+
+    // Publish the row only once all of its columns are in place
+    __sync_synchronize();
+    header_->rows = row + 1;
+    rows_++;
+    return true;
+}
@@ -0,0 +1,132 @@
+/**
+ * HistoryStore.h
+ *
+ * Append-only on-box history of tag reads, for audits. Reads go to
+ * segment files <dir>/<seq as 16 hex digits>.hist of up to
+ * HISTORY_ROWS rows each, stored column by column in host byte order:
+ *
+ *   HistoryHeader   row count, time range, reader table, block index
+ *   ts              uint64  x HISTORY_ROWS   ms since epoch
+ *   idOffset        uint32  x HISTORY_ROWS   offset into ids
+ *   type            uint16  x HISTORY_ROWS   SKYETEK_TAGTYPE code
+ *   reader          uint8   x HISTORY_ROWS   index into the reader table
+ *   idLength        uint8   x HISTORY_ROWS
+ *   ids             HISTORY_ID_BYTES         tag ID bytes, back to back
+ *
+ * Every HISTORY_BLOCK rows form a block whose time range and a Bloom
+ * filter of its tag IDs are kept in the header, so queries can skip
+ * blocks outside a time range or without a given tag. The row count
+ * is updated after the row is written, so readers never see a partial
+ * row; a writer always starts a new segment when it opens.
+ */
+#ifndef BRIDGE_HISTORY_STORE_H
+#define BRIDGE_HISTORY_STORE_H
+
+#include <stdint.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "TagEvent.h"
+
+#define HISTORY_MAGIC           0x32484B53  // "SKH2"
+#define HISTORY_ROWS            65536
+#define HISTORY_BLOCK           256
+#define HISTORY_BLOOM_BITS      4096        // 16 bits per row of a block
+#define HISTORY_BLOOM_PROBES    7
+#define HISTORY_ID_BYTES        (HISTORY_ROWS * 16)
+#define HISTORY_MAX_READERS     64
+
+struct HistoryBlock {
+    uint64_t minTs;
+    uint64_t maxTs;
+    uint64_t bloom[HISTORY_BLOOM_BITS / 64];    // Bloom filter of the IDs in the block
+};
+
+struct HistoryHeader {
+    uint32_t magic;
+    uint32_t rows;          // committed rows
+    uint32_t idBytes;       // used bytes of the ids column
+    uint32_t readers;       // used entries of rid
+    uint64_t minTs;
+    uint64_t maxTs;
+    char rid[HISTORY_MAX_READERS][TAG_EVENT_MAX_RID];
+    HistoryBlock blocks[HISTORY_ROWS / HISTORY_BLOCK];
+};
+
+/** Read-only view of one segment file. */
+class HistorySegment {
+public:
+    HistorySegment();
+    ~HistorySegment();
+
+    /** Maps a segment; returns false if it is not a history segment. */
+    bool open(const char *path);
+
+    const HistoryHeader &header() const { return *header_; }
+    uint32_t rows() const { return rows_; }
+
+    uint64_t ts(uint32_t row) const { return ts_[row]; }
+    uint16_t type(uint32_t row) const { return type_[row]; }
+    uint8_t reader(uint32_t row) const { return reader_[row]; }
+    const uint8_t *id(uint32_t row, size_t &length) const {
+        length = idLength_[row];
+        return ids_ + idOffset_[row];
+    }
+
+    /** False if no row of block can be in [from, to] or carry the ID with the given hash. */
+    bool blockMayMatch(uint32_t block, uint64_t from, uint64_t to, const uint64_t *idHash) const;
+
+private:
+    void *base_;
+    size_t size_;
+    const HistoryHeader *header_;
+    uint32_t rows_;
+    const uint64_t *ts_;
+    const uint32_t *idOffset_;
+    const uint16_t *type_;
+    const uint8_t *reader_;
+    const uint8_t *idLength_;
+    const uint8_t *ids_;
+
+    HistorySegment(const HistorySegment &);
+    HistorySegment &operator=(const HistorySegment &);
+};
+
+/** Appends tag reads to the newest segment of a directory. */
+class HistoryWriter {
+public:
+    explicit HistoryWriter(const char *dir);
+    ~HistoryWriter();
+
+    /** Creates the directory if needed and starts a new segment. */
+    bool open();
+
+    /** Appends one read; returns false if it could not be stored. */
+    bool append(const char *rid, uint64_t ts, const TagKey &tag);
+
+    uint64_t rows() const { return rows_; }
+
+private:
+    bool startSegment();
+    void closeSegment();
+
+    std::string dir_;
+    uint64_t seq_;
+    std::mutex lock_;
+    uint8_t *base_;
+    HistoryHeader *header_;
+    std::map<std::string, uint8_t> readers_;
+    uint64_t rows_;
+
+    HistoryWriter(const HistoryWriter &);
+    HistoryWriter &operator=(const HistoryWriter &);
+};
+
+/** Hash of the ID bytes used by the block Bloom filters. */
+uint64_t HistoryIdHash(const uint8_t *id, size_t length);
+
+/** Paths of the segments in dir, oldest first. */
+bool ListHistorySegments(const char *dir, std::vector<std::string> &paths);
+
+#endif
@@ -0,0 +1,382 @@
+/**
+ * Journal.cpp
+ *
+ * Memory-mapped segment journal for messages the broker has not taken yet.
+ */
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include "Journal.h"
+
+#define RECORD_HEADER       8
+#define OFFSET_MAGIC        0x314F4A53  // "SJO1"
+#define OFFSET_FILE_SIZE    24
+
+struct Crc32Table {
+    uint32_t entry[256];
+
+    Crc32Table() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            entry[i] = c;
+        }
+    }
+};
+
+static uint32_t crc32(const uint8_t *data, size_t length) {
+    static const Crc32Table table;
+    uint32_t c = 0xFFFFFFFFu;
+    for (size_t i = 0; i < length; i++)
+        c = table.entry[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++)
+        p[i] = (uint8_t) (v >> (8 * i));
+}
+
+static uint32_t get32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static void put64(uint8_t *p, uint64_t v) {
+    for (int i = 0; i < 8; i++)
+        p[i] = (uint8_t) (v >> (8 * i));
+}
+
+static uint64_t get64(const uint8_t *p) {
+    return get32(p) | ((uint64_t) get32(p + 4) << 32);
+}
+
+Journal::Journal(const char *dir, size_t segmentBytes, size_t maxSegments)
+        : dir_(dir), segmentBytes_(segmentBytes), maxSegments_(maxSegments < 2 ? 2 : maxSegments),
+          readSeq_(0), readOffset_(0) {
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+Journal::~Journal() {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!segments_.empty())
+        msync(segments_.back().base, segments_.back().size, MS_SYNC);
+    while (!segments_.empty()) {
+        unmapSegment(segments_.front(), false);
+        segments_.pop_front();
+    }
+}
+
+std::string Journal::segmentPath(uint64_t seq) const {
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.seg", (unsigned long long) seq);
+    return dir_ + name;
+}
+
+size_t Journal::indexOf(uint64_t seq) const {
+    for (size_t i = 0; i < segments_.size(); i++) {
+        if (segments_[i].seq == seq)
+            return i;
+    }
+    return segments_.size();
+}
+
+bool Journal::open() {
+    std::vector<uint64_t> seqs;
+    struct dirent *entry;
+    DIR *d;
+
+    if (mkdir(dir_.c_str(), 0755) != 0 && errno != EEXIST) {
+        perror(dir_.c_str());
+        return false;
+    }
+    if ((d = opendir(dir_.c_str())) == NULL) {
+        perror(dir_.c_str());
+        return false;
+    }
+    while ((entry = readdir(d)) != NULL) {
+        char *end;
+        uint64_t seq = strtoull(entry->d_name, &end, 16);
+        if (end == entry->d_name + 16 && strcmp(end, ".seg") == 0)
+            seqs.push_back(seq);
+    }
+    closedir(d);
+    std::sort(seqs.begin(), seqs.end());
+
+    std::lock_guard<std::mutex> guard(lock_);
+    for (size_t i = 0; i < seqs.size(); i++) {
+        Segment segment;
+        if (!mapSegment(seqs[i], false, segment))
+            return false;
+        segments_.push_back(segment);
+    }
+    if (segments_.empty()) {
+        Segment segment;
+        if (!mapSegment(1, true, segment))
+            return false;
+        segments_.push_back(segment);
+    }
+
+    uint64_t seq, offset;
+    if (!readOffset(seq, offset) || seq < segments_.front().seq) {
+        readSeq_ = segments_.front().seq;
+        readOffset_ = 0;
+    } else if (seq > segments_.back().seq || indexOf(seq) == segments_.size()) {
+        // Segments we have not seen were consumed; resume after everything on disk
+        readSeq_ = segments_.back().seq;
+        readOffset_ = segments_.back().used;
+    } else {
+        readSeq_ = seq;
+        readOffset_ = std::min((size_t) offset, segments_[indexOf(seq)].used);
+    }
+    normalizeRead();
+    return true;
+}
+
+bool Journal::mapSegment(uint64_t seq, bool create, Segment &segment) {
+    std::string path = segmentPath(seq);
+    struct stat st;
+    void *base;
+    int fd;
+
+    fd = ::open(path.c_str(), O_RDWR | (create ? O_CREAT | O_TRUNC : 0), 0644);
+    if (fd < 0) {
+        perror(path.c_str());
+        return false;
+    }
+    if ((create && ftruncate(fd, (off_t) segmentBytes_) != 0) || fstat(fd, &st) != 0 || st.st_size == 0) {
+        perror(path.c_str());
+        close(fd);
+        return false;
+    }
+    base = mmap(NULL, (size_t) st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        perror(path.c_str());
+        return false;
+    }
+
+    segment.seq = seq;
+    segment.base = (uint8_t *) base;
+    segment.size = (size_t) st.st_size;
+    segment.used = create ? 0 : scan(segment, 0, NULL, NULL);
+    // Clear a record torn by a crash so it cannot be mistaken for data later
+    if (segment.used < segment.size)
+        memset(segment.base + segment.used, 0, std::min(segment.size - segment.used, (size_t) RECORD_HEADER));
+    return true;
+}
+
+void Journal::unmapSegment(Segment &segment, bool remove) {
+    munmap(segment.base, segment.size);
+    if (remove)
+        unlink(segmentPath(segment.seq).c_str());
+}
+
+size_t Journal::scan(const Segment &segment, size_t from, uint64_t *records, uint64_t *bytes) {
+    size_t offset = from;
+
+    while (offset + RECORD_HEADER <= segment.size) {
+        const uint8_t *p = segment.base + offset;
+        uint32_t length = get32(p);
+        if (length < 2 || length > segment.size - offset - RECORD_HEADER ||
+            crc32(p + RECORD_HEADER, length) != get32(p + 4))
+            break;
+        if (records != NULL)
+            (*records)++;
+        if (bytes != NULL)
+            *bytes += length;
+        offset += RECORD_HEADER + length;
+    }
+    return offset;
+}
+
+void Journal::normalizeRead() {
+    size_t i = indexOf(readSeq_);
+
+    while (i + 1 < segments_.size() && readOffset_ >= segments_[i].used) {
+        i++;
+        readSeq_ = segments_[i].seq;
+        readOffset_ = 0;
+    }
+    while (segments_.front().seq != readSeq_) {
+        unmapSegment(segments_.front(), true);
+        segments_.pop_front();
+    }
+}
+
+bool Journal::rotate() {
+    if (segments_.size() >= maxSegments_) {
+        Segment &oldest = segments_.front();
+        if (readSeq_ == oldest.seq) {
+            uint64_t records = 0;
+            scan(oldest, readOffset_, &records, NULL);
+            stats_.dropped += records;
+            readSeq_ = segments_[1].seq;
+            readOffset_ = 0;
+            writeOffset();
+        }
+        unmapSegment(oldest, true);
+        segments_.pop_front();
+    }
+    msync(segments_.back().base, segments_.back().size, MS_ASYNC);
+
+    Segment segment;
+    if (!mapSegment(segments_.back().seq + 1, true, segment))
+        return false;
+    segments_.push_back(segment);
+    return true;
+}
+
+bool Journal::append(const char *topic, const void *payload, size_t length) {
+    size_t topicLength = strlen(topic);
+    size_t body = 2 + topicLength + length;
+
+    std::lock_guard<std::mutex> guard(lock_);
+    if (topicLength > 0xFFFF || RECORD_HEADER + body > segmentBytes_) {
+        stats_.dropped++;
+        return false;
+    }
+    if (segments_.back().size - segments_.back().used < RECORD_HEADER + body && !rotate()) {
+        stats_.dropped++;
+        return false;
+    }
+
+    Segment &tail = segments_.back();
+    uint8_t *p = tail.base + tail.used;
+    p[RECORD_HEADER] = (uint8_t) topicLength;
+    p[RECORD_HEADER + 1] = (uint8_t) (topicLength >> 8);
+    memcpy(p + RECORD_HEADER + 2, topic, topicLength);
+    memcpy(p + RECORD_HEADER + 2 + topicLength, payload, length);
+    put32(p + 4, crc32(p + RECORD_HEADER, body));
+    // The length goes last: until it is set the record reads as the end of the segment
+    put32(p, (uint32_t) body);
+    tail.used += RECORD_HEADER + body;
+    stats_.appended++;
+    return true;
+}
+
+bool Journal::empty() {
+    std::lock_guard<std::mutex> guard(lock_);
+    normalizeRead();
+    return segments_.size() == 1 && readOffset_ >= segments_.back().used;
+}
+
+size_t Journal::peek(std::vector<JournalRecord> &records, size_t maxRecords, size_t maxBytes) {
+    size_t bytes = 0;
+
+    records.clear();
+    std::lock_guard<std::mutex> guard(lock_);
+    normalizeRead();
+    peeked_.clear();
+
+    size_t i = 0;
+    size_t offset = readOffset_;
+    while (records.size() < maxRecords && bytes < maxBytes) {
+        if (offset >= segments_[i].used) {
+            if (i + 1 == segments_.size())
+                break;
+            i++;
+            offset = 0;
+            continue;
+        }
+        const uint8_t *p = segments_[i].base + offset;
+        uint32_t length = get32(p);
+        size_t topicLength = p[RECORD_HEADER] | (p[RECORD_HEADER + 1] << 8);
+
+        records.push_back(JournalRecord());
+        JournalRecord &record = records.back();
+        record.topic.assign((const char *) p + RECORD_HEADER + 2, topicLength);
+        record.payload.assign(p + RECORD_HEADER + 2 + topicLength, p + RECORD_HEADER + length);
+        bytes += record.payload.size();
+        offset += RECORD_HEADER + length;
+        peeked_.push_back(Position(segments_[i].seq, offset));
+    }
+    return records.size();
+}
+
+void Journal::consume(size_t count) {
+    std::lock_guard<std::mutex> guard(lock_);
+    Position read(readSeq_, readOffset_);
+
+    // Records dropped by rotation since peek() are already behind the read position
+    for (size_t i = 0; i < count && i < peeked_.size(); i++) {
+        if (peeked_[i] > read) {
+            read = peeked_[i];
+            stats_.consumed++;
+        }
+    }
+    peeked_.clear();
+    if (read.first == readSeq_ && read.second == readOffset_)
+        return;
+    readSeq_ = read.first;
+    readOffset_ = read.second;
+    normalizeRead();
+    writeOffset();
+}
+
+JournalStats Journal::stats() {
+    std::lock_guard<std::mutex> guard(lock_);
+    JournalStats stats = stats_;
+    size_t i = indexOf(readSeq_);
+
+    stats.pendingBytes = 0;
+    for (size_t offset = readOffset_; i < segments_.size(); i++, offset = 0) {
+        while (offset < segments_[i].used) {
+            uint32_t length = get32(segments_[i].base + offset);
+            stats.pendingBytes += length;
+            offset += RECORD_HEADER + length;
+        }
+    }
+    return stats;
+}
+
+bool Journal::readOffset(uint64_t &seq, uint64_t &offset) {
+    std::string path = dir_ + "/offset";
+    uint8_t buf[OFFSET_FILE_SIZE];
+    FILE *f = fopen(path.c_str(), "rb");
+    size_t n;
+
+    if (f == NULL)
+        return false;
+    n = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    if (n != sizeof(buf) || get32(buf) != OFFSET_MAGIC || get32(buf + 20) != crc32(buf, 20))
+        return false;
+    seq = get64(buf + 4);
+    offset = get64(buf + 12);
+    return true;
+}
+
+void Journal::writeOffset() {
+    std::string path = dir_ + "/offset";
+    std::string tmp = path + ".tmp";
+    uint8_t buf[OFFSET_FILE_SIZE];
+    int fd;
+
+    put32(buf, OFFSET_MAGIC);
+    put64(buf + 4, readSeq_);
+    put64(buf + 12, readOffset_);
+    put32(buf + 20, crc32(buf, 20));
+
+    // Write aside and rename, so a crash leaves either the old or the new offset
+    fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror(tmp.c_str());
+        return;
+    }
+    if (write(fd, buf, sizeof(buf)) != (ssize_t) sizeof(buf) || fsync(fd) != 0) {
+        perror(tmp.c_str());
+        close(fd);
+        return;
+    }
+    close(fd);
+    if (rename(tmp.c_str(), path.c_str()) != 0)
+        perror(path.c_str());
+}
@@ -0,0 +1,115 @@
+/**
+ * Journal.h
+ *
+ * Disk-backed store-and-forward queue of MQTT messages. Messages are
+ * appended to fixed-size memory-mapped segment files in one directory:
+ *
+ *   <dir>/<seq as 16 hex digits>.seg   segments, oldest first
+ *   <dir>/offset                       committed read position
+ *
+ * Each record is
+ *
+ *   length      4 bytes   size of the body
+ *   crc         4 bytes   CRC-32 of the body
+ *   body        2 byte topic length, topic, payload
+ *
+ * and the unused tail of a segment is zero. On open the write position
+ * is recovered by scanning the newest segment up to the first empty or
+ * damaged record. The read position is only advanced by consume(),
+ * which replaces the offset file atomically, so a crash replays at most
+ * the records read since the last consume().
+ *
+ * The footprint is bounded by maxSegments: when a new segment is
+ * needed and all are in use, the oldest segment and any records still
+ * unread in it are dropped.
+ */
+#ifndef BRIDGE_JOURNAL_H
+#define BRIDGE_JOURNAL_H
+
+#include <stdint.h>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct JournalRecord {
+    std::string topic;
+    std::vector<uint8_t> payload;
+};
+
+struct JournalStats {
+    uint64_t appended;
+    uint64_t consumed;
+    uint64_t dropped;       // lost to segment rotation or too large to store
+    uint64_t pendingBytes;  // appended and not yet consumed
+};
+
+class Journal {
+public:
+    /**
+     * @param dir Directory of the segment files, created if missing
+     * @param segmentBytes Size of each segment file
+     * @param maxSegments Most segments kept on disk, at least 2
+     */
+    Journal(const char *dir, size_t segmentBytes, size_t maxSegments);
+    ~Journal();
+
+    /** Maps existing segments and recovers both positions; returns false on error. */
+    bool open();
+
+    /** Appends one message; returns false if it could not be stored. */
+    bool append(const char *topic, const void *payload, size_t length);
+
+    /** True if every appended record has been consumed. */
+    bool empty();
+
+    /**
+     * Copies records from the read position without consuming them.
+     * @param records Replaced with up to maxRecords records
+     * @param maxBytes Stop once this many payload bytes are copied
+     * @return number of records copied
+     */
+    size_t peek(std::vector<JournalRecord> &records, size_t maxRecords, size_t maxBytes);
+
+    /** Marks the first count peeked records as delivered and persists the read position. */
+    void consume(size_t count);
+
+    JournalStats stats();
+
+private:
+    typedef std::pair<uint64_t, size_t> Position;  // segment seq, offset
+
+    struct Segment {
+        uint64_t seq;
+        uint8_t *base;
+        size_t size;
+        size_t used;    // end of the last valid record
+    };
+
+    bool mapSegment(uint64_t seq, bool create, Segment &segment);
+    void unmapSegment(Segment &segment, bool remove);
+    size_t indexOf(uint64_t seq) const;
+    bool rotate();
+    size_t scan(const Segment &segment, size_t from, uint64_t *records, uint64_t *bytes);
+    bool readOffset(uint64_t &seq, uint64_t &offset);
+    void writeOffset();
+    void normalizeRead();
+    std::string segmentPath(uint64_t seq) const;
+
+    std::string dir_;
+    size_t segmentBytes_;
+    size_t maxSegments_;
+
+    std::mutex lock_;
+    std::deque<Segment> segments_;  // oldest first, never empty once open
+    uint64_t readSeq_;
+    size_t readOffset_;
+    std::vector<Position> peeked_;  // end of each record returned by peek()
+    JournalStats stats_;
+
+    Journal(const Journal &);
+    Journal &operator=(const Journal &);
+};
+
+#endif
@@ -0,0 +1,283 @@
+/**
+ * MqttPublisher.cpp
+ *
+ * Thread-safe wrapper around the synchronous Paho client.
+ */
+#include <stdio.h>
+#include <chrono>
+#include "MqttPublisher.h"
+
+#define DRAIN_RECORDS       256
+#define DRAIN_BYTES         (1024 * 1024)
+#define RETRY_MIN_MS        500
+#define RETRY_MAX_MS        30000
+#define INFLIGHT_MAX        32
+
+MqttPublisher::MqttPublisher(const char *address, const char *clientId, int qos, unsigned long timeoutMs,
+                             int mqttVersion)
+        : qos_(qos), timeoutMs_(timeoutMs), mqttVersion_(mqttVersion), aliasMax_(0), aliased_(0),
+          journal_(NULL), connected_(false), stopping_(false) {
+    MQTTClient_createOptions createOpts = MQTTClient_createOptions_initializer;
+    createOpts.MQTTVersion = mqttVersion;
+    MQTTClient_createWithOptions(&client_, address, clientId, MQTTCLIENT_PERSISTENCE_NONE, NULL, &createOpts);
+}
+
+MqttPublisher::~MqttPublisher() {
+    stopForwarder();
+    MQTTClient_destroy(&client_);
+}
+
+void MqttPublisher::attachJournal(Journal *journal) {
+    journal_ = journal;
+    // Delivery is tracked through callbacks instead of waiting on each token
+    MQTTClient_setCallbacks(client_, this, connectionLost, messageArrived, deliveryComplete);
+    forwarder_ = std::thread(&MqttPublisher::forward, this);
+}
+
+int MqttPublisher::connect() {
+    MQTTClient_connectOptions conn_opts = MQTTClient_connectOptions_initializer;
+    MQTTClient_connectOptions conn_opts5 = MQTTClient_connectOptions_initializer5;
+    conn_opts.keepAliveInterval = 20;
+    conn_opts.cleansession = 1;
+    conn_opts5.keepAliveInterval = 20;
+    conn_opts5.cleanstart = 1;
+
+    int rc = MQTTCLIENT_SUCCESS;
+    {
+        // The forwarder may have beaten the caller to it
+        std::lock_guard<std::mutex> guard(lock_);
+        if (!connected_) {
+            // A failed publish may leave the session half open
+            if (MQTTClient_isConnected(client_))
+                MQTTClient_disconnect(client_, 0);
+            // The clean session drops whatever was still unacknowledged
+            requeueInflight();
+            aliases_.clear();
+            aliasMax_ = 0;
+            if (mqttVersion_ == MQTTVERSION_5) {
+                MQTTResponse response = MQTTClient_connect5(client_, &conn_opts5, NULL, NULL);
+                rc = response.reasonCode;
+                // Absent means the broker accepts no aliases
+                if (rc == MQTTCLIENT_SUCCESS && response.properties != NULL) {
+                    int max = MQTTProperties_getNumericValue(response.properties,
+                                                             MQTTPROPERTY_CODE_TOPIC_ALIAS_MAXIMUM);
+                    aliasMax_ = max > 0 ? (uint16_t) max : 0;
+                }
+                MQTTResponse_free(response);
+            } else {
+                rc = MQTTClient_connect(client_, &conn_opts);
+            }
+        }
+        connected_ = rc == MQTTCLIENT_SUCCESS;
+    }
+    // Drain whatever an earlier run left in the journal
+    if (journal_ != NULL)
+        wakeForwarder();
+    return rc;
+}
+
+void MqttPublisher::disconnect() {
+    // Whatever is still journaled stays on disk for the next run
+    stopForwarder();
+    std::lock_guard<std::mutex> guard(lock_);
+    connected_ = false;
+    MQTTClient_disconnect(client_, 10000);
+}
+
+int MqttPublisher::publish(const char *topic, const void *payload, size_t length) {
+    if (journal_ == NULL)
+        return send(topic, payload, length);
+
+    // Queue behind the backlog so the broker still sees messages in order
+    if (connected_ && journal_->empty() && sendQueued(topic, payload, length))
+        return MQTTCLIENT_SUCCESS;
+    if (!journal_->append(topic, payload, length))
+        return MQTTCLIENT_FAILURE;
+    wakeForwarder();
+    return MQTTCLIENT_SUCCESS;
+}
+
+int MqttPublisher::send(const char *topic, const void *payload, size_t length) {
+    MQTTClient_deliveryToken token;
+    int rc;
+
+    std::lock_guard<std::mutex> guard(lock_);
+    if ((rc = start(topic, payload, length, token)) != MQTTCLIENT_SUCCESS)
+        return rc;
+    return MQTTClient_waitForCompletion(client_, token, timeoutMs_);
+}
+
+// Hands the message to Paho without waiting; false means journal it
+bool MqttPublisher::sendQueued(const char *topic, const void *payload, size_t length) {
+    MQTTClient_deliveryToken token;
+    int rc;
+
+    std::lock_guard<std::mutex> guard(lock_);
+    // Held across the publish so the acknowledgement cannot beat the insert
+    std::lock_guard<std::mutex> inflight(inflightLock_);
+    if (qos_ > 0 && inflight_.size() >= INFLIGHT_MAX)
+        return false;
+    if ((rc = start(topic, payload, length, token)) != MQTTCLIENT_SUCCESS) {
+        printf("skyetek-mqtt: publish failed, return code %d, journaling until the broker is back\n", rc);
+        connected_ = false;
+        return false;
+    }
+    if (qos_ > 0) {
+        // Kept until acknowledged so a lost connection can journal it again
+        JournalRecord &record = inflight_[token];
+        record.topic = topic;
+        record.payload.assign((const uint8_t *) payload, (const uint8_t *) payload + length);
+    }
+    return true;
+}
+
+// Called with lock_ held
+int MqttPublisher::start(const char *topic, const void *payload, size_t length, MQTTClient_deliveryToken &token) {
+    MQTTClient_message pubmsg = MQTTClient_message_initializer;
+
+    pubmsg.payload = (void *) payload;
+    pubmsg.payloadlen = (int) length;
+    pubmsg.qos = qos_;
+    pubmsg.retained = 0;
+
+    if (mqttVersion_ == MQTTVERSION_5)
+        return send5(topic, pubmsg, token);
+    return MQTTClient_publishMessage(client_, topic, &pubmsg, &token);
+}
+
+// Called with lock_ held
+int MqttPublisher::send5(const char *topic, MQTTClient_message &message, MQTTClient_deliveryToken &token) {
+    MQTTProperty alias;
+    const char *name = topic;
+    uint16_t assigned = 0;
+
+    std::unordered_map<std::string, uint16_t>::iterator it = aliases_.find(topic);
+    if (it != aliases_.end()) {
+        // Known to the broker, the topic string can go
+        name = "";
+        alias.value.integer2 = it->second;
+    } else if (aliases_.size() < aliasMax_) {
+        // First use carries both and binds the alias to the topic
+        assigned = (uint16_t) (aliases_.size() + 1);
+        alias.value.integer2 = assigned;
+    }
+    if (name[0] == '\0' || assigned != 0) {
+        alias.identifier = MQTTPROPERTY_CODE_TOPIC_ALIAS;
+        MQTTProperties_add(&message.properties, &alias);
+    }
+
+    MQTTResponse response = MQTTClient_publishMessage5(client_, name, &message, &token);
+    int rc = response.reasonCode;
+    MQTTResponse_free(response);
+    MQTTProperties_free(&message.properties);
+    if (rc != MQTTCLIENT_SUCCESS)
+        return rc;
+    if (assigned != 0)
+        aliases_[topic] = assigned;
+    else if (name[0] == '\0')
+        aliased_++;
+    return rc;
+}
+
+void MqttPublisher::requeueInflight() {
+    std::lock_guard<std::mutex> guard(inflightLock_);
+    if (inflight_.empty())
+        return;
+    // Tokens are message ids and the oldest is not always the lowest, but
+    // a reconnect already gives up strict ordering for these
+    for (std::map<MQTTClient_deliveryToken, JournalRecord>::iterator it = inflight_.begin();
+         it != inflight_.end(); ++it) {
+        JournalRecord &record = it->second;
+        journal_->append(record.topic.c_str(), record.payload.empty() ? NULL : &record.payload[0],
+                         record.payload.size());
+    }
+    printf("skyetek-mqtt: journaled %u unacknowledged messages\n", (unsigned) inflight_.size());
+    inflight_.clear();
+}
+
+void MqttPublisher::connectionLost(void *context, char *cause) {
+    MqttPublisher *self = (MqttPublisher *) context;
+
+    (void) cause;
+    self->connected_ = false;
+    self->requeueInflight();
+    self->wakeForwarder();
+}
+
+int MqttPublisher::messageArrived(void *context, char *topicName, int topicLen, MQTTClient_message *message) {
+    // Nothing is subscribed, but Paho requires the callback
+    (void) context;
+    (void) topicLen;
+    MQTTClient_freeMessage(&message);
+    MQTTClient_free(topicName);
+    return 1;
+}
+
+void MqttPublisher::deliveryComplete(void *context, MQTTClient_deliveryToken token) {
+    MqttPublisher *self = (MqttPublisher *) context;
+
+    // Tokens the forwarder waited on were never tracked
+    std::lock_guard<std::mutex> guard(self->inflightLock_);
+    self->inflight_.erase(token);
+}
+
+void MqttPublisher::wakeForwarder() {
+    // Taking the lock orders the notify after the forwarder's check of the journal
+    { std::lock_guard<std::mutex> guard(forwardLock_); }
+    wake_.notify_one();
+}
+
+void MqttPublisher::stopForwarder() {
+    if (!forwarder_.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> guard(forwardLock_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    forwarder_.join();
+}
+
+void MqttPublisher::forward() {
+    uint32_t retryMs = RETRY_MIN_MS;
+
+    std::unique_lock<std::mutex> guard(forwardLock_);
+    while (!stopping_) {
+        if (connected_ && journal_->empty()) {
+            wake_.wait_for(guard, std::chrono::milliseconds(RETRY_MAX_MS));
+            continue;
+        }
+        guard.unlock();
+        if (!connected_ && connect() == MQTTCLIENT_SUCCESS)
+            printf("skyetek-mqtt: reconnected to the broker\n");
+        if (connected_ && drain()) {
+            retryMs = RETRY_MIN_MS;
+            guard.lock();
+            continue;
+        }
+        guard.lock();
+        wake_.wait_for(guard, std::chrono::milliseconds(retryMs));
+        retryMs = retryMs * 2 > RETRY_MAX_MS ? RETRY_MAX_MS : retryMs * 2;
+    }
+}
+
+bool MqttPublisher::drain() {
+    size_t count = journal_->peek(records_, DRAIN_RECORDS, DRAIN_BYTES);
+    size_t sent;
+    int rc = MQTTCLIENT_SUCCESS;
+
+    for (sent = 0; sent < count; sent++) {
+        JournalRecord &record = records_[sent];
+        rc = send(record.topic.c_str(), record.payload.empty() ? NULL : &record.payload[0], record.payload.size());
+        if (rc != MQTTCLIENT_SUCCESS)
+            break;
+    }
+    // One offset update per chunk; a crash before it replays the chunk
+    journal_->consume(sent);
+    if (rc != MQTTCLIENT_SUCCESS) {
+        printf("skyetek-mqtt: journal drain failed, return code %d\n", rc);
+        connected_ = false;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,107 @@
+/**
+ * MqttPublisher.h
+ *
+ * Serializes publishes from the reader and timer threads onto one
+ * synchronous Paho client.
+ *
+ * With a journal attached, publish() hands the message to Paho without
+ * waiting for the broker's acknowledgement. Messages that cannot be
+ * sent, that find too many deliveries already in flight, or that are
+ * published while older ones are still journaled, are appended to the
+ * journal instead. A forwarder thread reconnects with backoff and drains
+ * the journal in order. Deliveries still in flight when the connection
+ * drops are journaled again, so the broker may see them twice.
+ *
+ * With MQTT v5 every topic is given a topic alias on its first publish,
+ * up to the maximum the broker grants in its CONNACK, and later
+ * publishes send the two byte alias instead of the topic string.
+ * Aliases only live as long as the connection and are reassigned after
+ * a reconnect.
+ */
+#ifndef BRIDGE_MQTT_PUBLISHER_H
+#define BRIDGE_MQTT_PUBLISHER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <MQTTClient.h>
+#include "Journal.h"
+
+class MqttPublisher {
+public:
+    /**
+     * @param mqttVersion MQTTVERSION_3_1_1 or MQTTVERSION_5
+     */
+    MqttPublisher(const char *address, const char *clientId, int qos, unsigned long timeoutMs,
+                  int mqttVersion = MQTTVERSION_3_1_1);
+    ~MqttPublisher();
+
+    /**
+     * Stores undeliverable messages in journal and starts the forwarder.
+     * Call before connect(); the journal is owned by the caller and must
+     * outlive the publisher.
+     */
+    void attachJournal(Journal *journal);
+
+    /**
+     * Connects to the broker; returns the Paho return code. With a
+     * journal the forwarder keeps retrying after a failure.
+     */
+    int connect();
+    void disconnect();
+
+    /**
+     * Publishes a message and waits for its delivery. With a journal the
+     * message is only queued, either with Paho or in the journal.
+     * @return MQTTCLIENT_SUCCESS or a Paho error code. With a journal,
+     * success also means the message was journaled for later delivery.
+     */
+    int publish(const char *topic, const void *payload, size_t length);
+
+    /** Number of publishes that sent an alias in place of the topic. */
+    uint64_t aliasedPublishes() const { return aliased_; }
+
+private:
+    int send(const char *topic, const void *payload, size_t length);
+    int start(const char *topic, const void *payload, size_t length, MQTTClient_deliveryToken &token);
+    bool sendQueued(const char *topic, const void *payload, size_t length);
+    void requeueInflight();
+    static void connectionLost(void *context, char *cause);
+    static int messageArrived(void *context, char *topicName, int topicLen, MQTTClient_message *message);
+    static void deliveryComplete(void *context, MQTTClient_deliveryToken token);
+    int send5(const char *topic, MQTTClient_message &message, MQTTClient_deliveryToken &token);
+    void wakeForwarder();
+    void stopForwarder();
+    void forward();
+    bool drain();
+
+    MQTTClient client_;
+    int qos_;
+    unsigned long timeoutMs_;
+    int mqttVersion_;
+    std::mutex lock_;               // guards client_ and the aliases
+
+    std::unordered_map<std::string, uint16_t> aliases_;
+    uint16_t aliasMax_;             // granted by the broker, 0 without v5
+    uint64_t aliased_;
+
+    Journal *journal_;
+    std::atomic<bool> connected_;
+    std::mutex forwardLock_;
+    std::condition_variable wake_;
+    bool stopping_;
+    std::vector<JournalRecord> records_;
+    std::mutex inflightLock_;       // taken after lock_, never before it
+    std::map<MQTTClient_deliveryToken, JournalRecord> inflight_;
+    std::thread forwarder_;
+
+    MqttPublisher(const MqttPublisher &);
+    MqttPublisher &operator=(const MqttPublisher &);
+};
+
+#endif
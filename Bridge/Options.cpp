@@ -0,0 +1,313 @@
+/**
+ * Options.cpp
+ *
+ * Command line parsing for the bridge.
+ */
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <MQTTClient.h>
+#include "Options.h"
+
+static void usage(const char *prog) {
+    printf("usage: %s [options]\n"
+           "  --broker=URI         MQTT broker (default tcp://localhost:1883)\n"
+           "  --client-id=ID       MQTT client id (default SkyeTekMQTT)\n"
+           "  --mqtt-version=3|5   MQTT protocol version, 5 replaces repeated topics by aliases (default 3)\n"
+           "  --client-per-reader  give every reader its own broker connection\n"
+           "  --mode=raw|presence|window|zones\n"
+           "                       publish every read, enter/leave events, per-tag counts per\n"
+           "                       time window or moves between readers (default presence)\n"
+           "  --absence-ms=N       presence, zones: time without reads before a tag leaves (default 3000)\n"
+           "  --tick-ms=N          presence, zones: departure timer resolution (default 100)\n"
+           "  --window-ms=N        window: window length (default 60000)\n"
+           "  --slide-ms=N         window: publish a sliding window every N ms (default tumbling)\n"
+           "  --zone-window-ms=N   zones: time over which readers' read counts are compared (default 2000)\n"
+           "  --batch-count=N      publish events in batches of up to N (default off)\n"
+           "  --batch-ms=N         publish a batch once its oldest event is N ms old\n"
+           "  --shed=C,S,D         when N events wait to be published, fold repeat reads of a tag\n"
+           "                       from N=C, sample them from N=S and drop new events from N=D\n"
+           "  --shed-sample=N      while sampling pass 1 in N repeat reads of a tag (default 10)\n"
+           "  --format=json|binary payload encoding of events (default json)\n"
+           "  --compress=none|zstd compress batch payloads (default none)\n"
+           "  --compress-level=N   zstd compression level (default 3)\n"
+           "  --dict=FILE          zstd dictionary trained with zstd --train\n"
+           "  --journal=DIR        keep undelivered messages in DIR until the broker takes them\n"
+           "  --journal-mb=N       disk space of the journal, oldest messages dropped first (default 64)\n"
+           "  --history=DIR        record every read in DIR for skyetek_query\n"
+           "  --allow=RULE         only publish reads matching [TYPE:]PREFIX[/MASK], repeatable\n"
+           "  --deny=RULE          drop reads matching [TYPE:]PREFIX[/MASK], repeatable\n"
+           "  --rules=FILE         allow and deny rules, one \"allow RULE\" or \"deny RULE\" per line\n"
+           "  --assets=FILE        add asset metadata from a skyetek_assets table to JSON events\n"
+           "  --upshift-baud[=MAX] move serial readers to the fastest baud rate both sides support\n"
+           "  --baud-cache=FILE    remember negotiated baud rates for the next start\n"
+           "  --bus=FIRST-LAST     treat serial ports as RS-485 lines and find readers by hex RID\n"
+           "  --bus-dwell=MS[,IDLE] inventory time per reader turn on a line, IDLE after a turn\n"
+           "                       without tags (default 200)\n"
+           "  --response-timeout=FLOOR,CEILING\n"
+           "                       bounds of the reader response timeouts learned from measured\n"
+           "                       round trips in ms, 0 ceiling for fixed timeouts (default 100,10000)\n",
+           prog);
+}
+
+int ParseOptions(int argc, char *argv[], BridgeOptions &options) {
+    static const struct option longOptions[] = {
+            {"broker",      required_argument, NULL, 'b'},
+            {"client-id",   required_argument, NULL, 'c'},
+            {"mqtt-version", required_argument, NULL, 'V'},
+            {"client-per-reader", no_argument, NULL, 'P'},
+            {"mode",        required_argument, NULL, 'm'},
+            {"absence-ms",  required_argument, NULL, 'a'},
+            {"tick-ms",     required_argument, NULL, 't'},
+            {"window-ms",   required_argument, NULL, 'w'},
+            {"slide-ms",    required_argument, NULL, 's'},
+            {"zone-window-ms", required_argument, NULL, 'Z'},
+            {"batch-count", required_argument, NULL, 'n'},
+            {"batch-ms",    required_argument, NULL, 'l'},
+            {"shed",        required_argument, NULL, 'O'},
+            {"shed-sample", required_argument, NULL, 'E'},
+            {"format",      required_argument, NULL, 'f'},
+            {"compress",    required_argument, NULL, 'z'},
+            {"compress-level", required_argument, NULL, 'L'},
+            {"dict",        required_argument, NULL, 'd'},
+            {"journal",     required_argument, NULL, 'j'},
+            {"journal-mb",  required_argument, NULL, 'J'},
+            {"history",     required_argument, NULL, 'H'},
+            {"allow",       required_argument, NULL, 'A'},
+            {"deny",        required_argument, NULL, 'D'},
+            {"rules",       required_argument, NULL, 'R'},
+            {"assets",      required_argument, NULL, 'S'},
+            {"upshift-baud", optional_argument, NULL, 'U'},
+            {"baud-cache",  required_argument, NULL, 'B'},
+            {"bus",         required_argument, NULL, 'X'},
+            {"bus-dwell",   required_argument, NULL, 'W'},
+            {"response-timeout", required_argument, NULL, 'T'},
+            {"help",        no_argument,       NULL, 'h'},
+            {NULL,          0,                 NULL, 0}
+    };
+    int c;
+
+    options.address = "tcp://localhost:1883";
+    options.clientId = "SkyeTekMQTT";
+    options.mqttVersion = MQTTVERSION_3_1_1;
+    options.clientPerReader = false;
+    options.mode = BRIDGE_MODE_PRESENCE;
+    options.absenceMs = 3000;
+    options.tickMs = 100;
+    options.windowMs = 60000;
+    options.slideMs = 0;
+    options.zoneWindowMs = 2000;
+    options.batchCount = 0;
+    options.batchMs = 0;
+    options.shedCollapse = 0;
+    options.shedSample = 0;
+    options.shedDrop = 0;
+    options.shedEvery = 10;
+    options.format = PAYLOAD_FORMAT_JSON;
+    options.compression = PAYLOAD_COMPRESSION_NONE;
+    options.compressionLevel = 3;
+    options.dictionary = NULL;
+    options.journalDir = NULL;
+    options.journalMb = 64;
+    options.historyDir = NULL;
+    options.allowRules.clear();
+    options.denyRules.clear();
+    options.rulesFile = NULL;
+    options.assetsFile = NULL;
+    options.upshiftBaud = false;
+    options.maxBaud = 0;
+    options.baudCache = NULL;
+    options.bus = false;
+    options.busFirstRid = 0;
+    options.busLastRid = 0;
+    options.busDwellMs = 200;
+    options.busIdleDwellMs = 0;
+    options.responseFloorMs = 100;
+    options.responseCeilingMs = 10000;
+
+    while ((c = getopt_long(argc, argv, "h", longOptions, NULL)) != -1) {
+        switch (c) {
+            case 'b':
+                options.address = optarg;
+                break;
+            case 'c':
+                options.clientId = optarg;
+                break;
+            case 'V':
+                if (strcmp(optarg, "3") == 0)
+                    options.mqttVersion = MQTTVERSION_3_1_1;
+                else if (strcmp(optarg, "5") == 0)
+                    options.mqttVersion = MQTTVERSION_5;
+                else {
+                    usage(argv[0]);
+                    return -1;
+                }
+                break;
+            case 'P':
+                options.clientPerReader = true;
+                break;
+            case 'm':
+                if (strcmp(optarg, "raw") == 0)
+                    options.mode = BRIDGE_MODE_RAW;
+                else if (strcmp(optarg, "presence") == 0)
+                    options.mode = BRIDGE_MODE_PRESENCE;
+                else if (strcmp(optarg, "window") == 0)
+                    options.mode = BRIDGE_MODE_WINDOW;
+                else if (strcmp(optarg, "zones") == 0)
+                    options.mode = BRIDGE_MODE_ZONES;
+                else {
+                    usage(argv[0]);
+                    return -1;
+                }
+                break;
+            case 'a':
+                options.absenceMs = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 't':
+                options.tickMs = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'w':
+                options.windowMs = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 's':
+                options.slideMs = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'Z':
+                options.zoneWindowMs = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'n':
+                options.batchCount = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'l':
+                options.batchMs = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'O': {
+                char *end;
+                options.shedCollapse = (uint32_t) strtoul(optarg, &end, 10);
+                options.shedSample = *end == ',' ? (uint32_t) strtoul(end + 1, &end, 10) : 0;
+                options.shedDrop = *end == ',' ? (uint32_t) strtoul(end + 1, &end, 10) : 0;
+                // Each stage builds on the one before
+                if (*end != '\0' || options.shedCollapse == 0 ||
+                    (options.shedSample != 0 && options.shedSample < options.shedCollapse) ||
+                    (options.shedDrop != 0 && options.shedDrop < options.shedSample)) {
+                    usage(argv[0]);
+                    return -1;
+                }
+                break;
+            }
+            case 'E':
+                options.shedEvery = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'f':
+                if (strcmp(optarg, "json") == 0)
+                    options.format = PAYLOAD_FORMAT_JSON;
+                else if (strcmp(optarg, "binary") == 0)
+                    options.format = PAYLOAD_FORMAT_BINARY;
+                else {
+                    usage(argv[0]);
+                    return -1;
+                }
+                break;
+            case 'z':
+                if (strcmp(optarg, "none") == 0)
+                    options.compression = PAYLOAD_COMPRESSION_NONE;
+                else if (strcmp(optarg, "zstd") == 0)
+                    options.compression = PAYLOAD_COMPRESSION_ZSTD;
+                else {
+                    usage(argv[0]);
+                    return -1;
+                }
+                break;
+            case 'L':
+                options.compressionLevel = atoi(optarg);
+                break;
+            case 'd':
+                options.dictionary = optarg;
+                break;
+            case 'j':
+                options.journalDir = optarg;
+                break;
+            case 'J':
+                options.journalMb = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'H':
+                options.historyDir = optarg;
+                break;
+            case 'A':
+                options.allowRules.push_back(optarg);
+                break;
+            case 'D':
+                options.denyRules.push_back(optarg);
+                break;
+            case 'R':
+                options.rulesFile = optarg;
+                break;
+            case 'S':
+                options.assetsFile = optarg;
+                break;
+            case 'U':
+                options.upshiftBaud = true;
+                options.maxBaud = optarg != NULL ? (uint32_t) strtoul(optarg, NULL, 10) : 0;
+                break;
+            case 'B':
+                options.baudCache = optarg;
+                break;
+            case 'X': {
+                char *end;
+                options.bus = true;
+                options.busFirstRid = (uint32_t) strtoul(optarg, &end, 16);
+                options.busLastRid = *end == '-' ? (uint32_t) strtoul(end + 1, &end, 16) : options.busFirstRid;
+                if (*end != '\0' || options.busLastRid < options.busFirstRid) {
+                    usage(argv[0]);
+                    return -1;
+                }
+                break;
+            }
+            case 'W': {
+                char *end;
+                options.busDwellMs = (uint32_t) strtoul(optarg, &end, 10);
+                options.busIdleDwellMs = *end == ',' ? (uint32_t) strtoul(end + 1, &end, 10) : 0;
+                if (*end != '\0' || options.busDwellMs == 0) {
+                    usage(argv[0]);
+                    return -1;
+                }
+                break;
+            }
+            case 'T': {
+                char *end;
+                options.responseFloorMs = (uint32_t) strtoul(optarg, &end, 10);
+                options.responseCeilingMs = *end == ',' ? (uint32_t) strtoul(end + 1, &end, 10) : 0;
+                if (*end != '\0' || (options.responseCeilingMs != 0 &&
+                                     options.responseCeilingMs < options.responseFloorMs)) {
+                    usage(argv[0]);
+                    return -1;
+                }
+                break;
+            }
+            default:
+                usage(argv[0]);
+                return -1;
+        }
+    }
+    if (options.tickMs == 0)
+        options.tickMs = 1;
+    // Zone events carry two reader ids, which the binary layout has no room for
+    if (options.mode == BRIDGE_MODE_ZONES && options.format == PAYLOAD_FORMAT_BINARY) {
+        fprintf(stderr, "zones mode publishes JSON, ignoring --format=binary\n");
+        options.format = PAYLOAD_FORMAT_JSON;
+    }
+    // A deadline without a count still needs a cap on the batch size
+    if (options.batchMs > 0 && options.batchCount == 0)
+        options.batchCount = 1000;
+    // A dictionary is only useful to the compressor
+    if (options.dictionary != NULL && options.compression == PAYLOAD_COMPRESSION_NONE)
+        options.compression = PAYLOAD_COMPRESSION_ZSTD;
+    // Binary and compressed payloads only exist as batches, if need be of one event,
+    // and only the batch queue lets the select loop run on while publishing lags
+    if ((options.format == PAYLOAD_FORMAT_BINARY || options.compression != PAYLOAD_COMPRESSION_NONE ||
+         options.shedCollapse != 0) &&
+        options.batchCount == 0)
+        options.batchCount = 1;
+    return 0;
+}
@@ -0,0 +1,72 @@
+/**
+ * Options.h
+ *
+ * Command line options of the bridge.
+ */
+#ifndef BRIDGE_OPTIONS_H
+#define BRIDGE_OPTIONS_H
+
+#include <stdint.h>
+#include <vector>
+
+enum BridgeMode {
+    BRIDGE_MODE_RAW = 0,    // one message per read on SkyeT1ek/<rid>
+    BRIDGE_MODE_PRESENCE,   // enter/leave events on SkyeT1ek/<rid>/presence
+    BRIDGE_MODE_WINDOW,     // per-tag window summaries on SkyeT1ek/<rid>/window
+    BRIDGE_MODE_ZONES       // moves between readers on SkyeT1ek/zones
+};
+
+enum PayloadFormat {
+    PAYLOAD_FORMAT_JSON = 0,
+    PAYLOAD_FORMAT_BINARY   // see BinaryBatchCodec.h
+};
+
+enum PayloadCompression {
+    PAYLOAD_COMPRESSION_NONE = 0,
+    PAYLOAD_COMPRESSION_ZSTD    // see CompressedBatchCodec.h
+};
+
+struct BridgeOptions {
+    const char *address;
+    const char *clientId;
+    int mqttVersion;        // MQTTVERSION_3_1_1 or MQTTVERSION_5
+    bool clientPerReader;   // one connection per reader, id <clientId>-<rid>
+    BridgeMode mode;
+    uint32_t absenceMs;
+    uint32_t tickMs;
+    uint32_t windowMs;
+    uint32_t slideMs;       // 0 for tumbling windows
+    uint32_t zoneWindowMs;
+    uint32_t batchCount;    // 0 disables batching
+    uint32_t batchMs;
+    uint32_t shedCollapse;  // overload watermarks of the batch queue, see EventBatcher.h
+    uint32_t shedSample;
+    uint32_t shedDrop;
+    uint32_t shedEvery;
+    PayloadFormat format;
+    PayloadCompression compression;
+    int compressionLevel;
+    const char *dictionary; // NULL compresses without a dictionary
+    const char *journalDir; // NULL disables store-and-forward
+    uint32_t journalMb;
+    const char *historyDir; // NULL disables the read history
+    std::vector<const char *> allowRules;   // see TagFilter.h
+    std::vector<const char *> denyRules;
+    const char *rulesFile;
+    const char *assetsFile; // NULL disables asset metadata
+    bool upshiftBaud;       // move serial readers to their fastest rate
+    uint32_t maxBaud;       // 0 for no limit
+    const char *baudCache;  // NULL forgets negotiated rates at exit
+    bool bus;               // serial devices are RS-485 lines scanned by RID
+    uint32_t busFirstRid;
+    uint32_t busLastRid;
+    uint32_t busDwellMs;
+    uint32_t busIdleDwellMs;    // 0 for busDwellMs
+    uint32_t responseFloorMs;   // bounds of the adaptive response timeouts
+    uint32_t responseCeilingMs; // 0 for the fixed timeouts of the SDK
+};
+
+/** Parses argv into options; returns 0 on success, -1 after printing usage. */
+int ParseOptions(int argc, char *argv[], BridgeOptions &options);
+
+#endif
@@ -0,0 +1,92 @@
+/**
+ * PresenceTracker.cpp
+ *
+ * Presence tracking with a timer wheel for departures.
+ */
+#include <stdio.h>
+#include "Clock.h"
+#include "PresenceTracker.h"
+
+PresenceTracker::PresenceTracker(const char *rid, uint32_t absenceMs, uint32_t tickMs, EventSink *sink)
+        : absenceMs_(absenceMs), sink_(sink), wheel_(tickMs, MonotonicMs()) {
+    snprintf(rid_, sizeof(rid_), "%s", rid);
+}
+
+void PresenceTracker::makeEvent(const Entry &entry, TagEventKind kind, TagEvent &event) {
+    event.kind = kind;
+    memcpy(event.rid, rid_, sizeof(rid_));
+    event.tag = entry.tag;
+    event.timestamp = WallClockMs();
+    event.firstSeen = entry.firstSeen;
+    event.lastSeen = entry.lastSeen;
+    event.count = entry.count;
+}
+
+// Releases guard; events leave in the order they were decided under it
+void PresenceTracker::emit(std::unique_lock<std::mutex> &guard, std::vector<TagEvent> &events) {
+    if (events.empty()) {
+        guard.unlock();
+        return;
+    }
+    std::lock_guard<std::mutex> order(emitLock_);
+    guard.unlock();
+    for (size_t i = 0; i < events.size(); i++)
+        sink_->onEvent(events[i]);
+    events.clear();
+}
+
+void PresenceTracker::observe(const TagKey &tag) {
+    std::vector<TagEvent> events;
+    uint64_t now = WallClockMs();
+    std::unique_lock<std::mutex> guard(lock_);
+    std::pair<Table::iterator, bool> slot = table_.emplace(tag, Entry());
+    Entry &entry = slot.first->second;
+    if (slot.second) {
+        entry.tag = tag;
+        entry.firstSeen = now;
+        entry.count = 0;
+    }
+    entry.lastSeen = now;
+    entry.count++;
+    wheel_.schedule(&entry, MonotonicMs() + absenceMs_);
+    if (slot.second) {
+        events.resize(1);
+        makeEvent(entry, TAG_EVENT_ENTER, events[0]);
+    }
+    emit(guard, events);
+}
+
+void PresenceTracker::onExpired(TimerNode *node, void *user) {
+    PresenceTracker *self = (PresenceTracker *) user;
+    Entry *entry = static_cast<Entry *>(node);
+    self->pending_.resize(self->pending_.size() + 1);
+    self->makeEvent(*entry, TAG_EVENT_LEAVE, self->pending_.back());
+    TagKey key = entry->tag;
+    self->table_.erase(key);
+}
+
+void PresenceTracker::tick() {
+    std::vector<TagEvent> events;
+    std::unique_lock<std::mutex> guard(lock_);
+    wheel_.advance(MonotonicMs(), onExpired, this);
+    events.swap(pending_);
+    emit(guard, events);
+}
+
+void PresenceTracker::flush() {
+    std::vector<TagEvent> events;
+    std::unique_lock<std::mutex> guard(lock_);
+    events.resize(table_.size());
+    size_t i = 0;
+    for (Table::iterator it = table_.begin(); it != table_.end(); ++it, ++i) {
+        wheel_.cancel(&it->second);
+        makeEvent(it->second, TAG_EVENT_LEAVE, events[i]);
+    }
+    table_.clear();
+    emit(guard, events);
+}
+
+size_t PresenceTracker::size() {
+    std::lock_guard<std::mutex> guard(lock_);
+    return table_.size();
+}
@@ -0,0 +1,64 @@
+/**
+ * PresenceTracker.h
+ *
+ * Turns the raw reads of one reader into enter/leave events. A tag
+ * enters on its first read and leaves once it has not been read for
+ * the absence timeout. Departure timeouts live in a timer wheel, so
+ * each read and each tick cost constant time however many tags are
+ * tracked. Events reach the sink in the order they were decided, so a
+ * tag's leave is never delivered after its next enter.
+ */
+#ifndef BRIDGE_PRESENCE_TRACKER_H
+#define BRIDGE_PRESENCE_TRACKER_H
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "TagEvent.h"
+#include "TimerWheel.h"
+
+class PresenceTracker {
+public:
+    /**
+     * @param rid Reader ID stamped on the events
+     * @param absenceMs Time without reads after which a tag has left
+     * @param tickMs Resolution of departure detection
+     * @param sink Receives enter and leave events
+     */
+    PresenceTracker(const char *rid, uint32_t absenceMs, uint32_t tickMs, EventSink *sink);
+
+    /** Records a read of tag. */
+    void observe(const TagKey &tag);
+
+    /** Emits leave events for every tag whose absence timeout has passed. */
+    void tick();
+
+    /** Emits leave events for every tracked tag, e.g. at shutdown. */
+    void flush();
+
+    size_t size();
+
+private:
+    struct Entry : TimerNode {
+        TagKey tag;
+        uint64_t firstSeen;
+        uint64_t lastSeen;
+        uint32_t count;
+    };
+    typedef std::unordered_map<TagKey, Entry, TagKeyHash> Table;
+
+    static void onExpired(TimerNode *node, void *user);
+    void makeEvent(const Entry &entry, TagEventKind kind, TagEvent &event);
+    void emit(std::unique_lock<std::mutex> &guard, std::vector<TagEvent> &events);
+
+    char rid_[TAG_EVENT_MAX_RID];
+    uint32_t absenceMs_;
+    EventSink *sink_;
+    std::mutex lock_;
+    Table table_;
+    TimerWheel wheel_;
+    std::vector<TagEvent> pending_;     // filled under lock_, emitted after
+    std::mutex emitLock_;               // taken before lock_ is released
+};
+
+#endif
@@ -0,0 +1,92 @@
+/**
+ * TagCounter.cpp
+ *
+ * Linear-probing tag counter table.
+ */
+#include "TagCounter.h"
+
+static uint32_t hashTag(uint16_t type, const uint8_t *id, size_t length) {
+    uint32_t h = 2166136261u;
+    h = (h ^ (type & 0xFF)) * 16777619u;
+    h = (h ^ (type >> 8)) * 16777619u;
+    for (size_t i = 0; i < length; i++)
+        h = (h ^ id[i]) * 16777619u;
+    return h ? h : 1;
+}
+
+TagCounter::TagCounter(size_t capacity) : size_(0) {
+    size_t n = 16;
+    while (n < capacity)
+        n <<= 1;
+    slots_.resize(n);
+    memset(&slots_[0], 0, n * sizeof(Entry));
+}
+
+void TagCounter::add(const TagKey &tag, uint32_t count, uint64_t first, uint64_t last) {
+    insert(hashTag(tag.type, tag.id, tag.idLength), tag.type, tag.id, tag.idLength, count, first, last);
+}
+
+void TagCounter::merge(const TagCounter &other) {
+    for (size_t i = 0; i < other.slots_.size(); i++) {
+        const Entry &e = other.slots_[i];
+        if (e.hash != 0)
+            insert(e.hash, e.type, other.ids_.data() + e.idOffset, e.idLength, e.count, e.firstSeen, e.lastSeen);
+    }
+}
+
+void TagCounter::clear() {
+    if (size_ > 0)
+        memset(&slots_[0], 0, slots_.size() * sizeof(Entry));
+    ids_.clear();
+    size_ = 0;
+}
+
+void TagCounter::insert(uint32_t hash, uint16_t type, const uint8_t *id, uint8_t idLength,
+                        uint32_t count, uint64_t first, uint64_t last) {
+    // Keep the load under 3/4 so probe runs stay short
+    if ((size_ + 1) * 4 > slots_.size() * 3)
+        grow();
+
+    size_t mask = slots_.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        Entry &e = slots_[i];
+        if (e.hash == 0) {
+            e.hash = hash;
+            e.idOffset = (uint32_t) ids_.size();
+            e.count = count;
+            e.type = type;
+            e.idLength = idLength;
+            e.firstSeen = first;
+            e.lastSeen = last;
+            ids_.insert(ids_.end(), id, id + idLength);
+            size_++;
+            return;
+        }
+        if (e.hash == hash && e.type == type && e.idLength == idLength &&
+            memcmp(ids_.data() + e.idOffset, id, idLength) == 0) {
+            e.count += count;
+            if (first < e.firstSeen)
+                e.firstSeen = first;
+            if (last > e.lastSeen)
+                e.lastSeen = last;
+            return;
+        }
+    }
+}
+
+void TagCounter::grow() {
+    std::vector<Entry> old(slots_.size() * 2);
+    memset(&old[0], 0, old.size() * sizeof(Entry));
+    old.swap(slots_);
+
+    // IDs stay where they are in the arena; only the slots move
+    size_t mask = slots_.size() - 1;
+    for (size_t i = 0; i < old.size(); i++) {
+        if (old[i].hash == 0)
+            continue;
+        size_t j = old[i].hash & mask;
+        while (slots_[j].hash != 0)
+            j = (j + 1) & mask;
+        slots_[j] = old[i];
+    }
+}
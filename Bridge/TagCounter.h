@@ -0,0 +1,60 @@
+/**
+ * TagCounter.h
+ *
+ * Compact per-tag read counters: an open-addressing table of 32-byte
+ * entries with the ID bytes kept in a separate arena. Clearing keeps
+ * the capacity, so a table reused window after window stops
+ * allocating once it has grown to the busiest window.
+ */
+#ifndef BRIDGE_TAG_COUNTER_H
+#define BRIDGE_TAG_COUNTER_H
+
+#include <stdint.h>
+#include <vector>
+#include "TagEvent.h"
+
+class TagCounter {
+public:
+    struct Entry {
+        uint32_t hash;          // 0 marks an empty slot
+        uint32_t idOffset;
+        uint32_t count;
+        uint16_t type;
+        uint8_t idLength;
+        uint8_t reserved;
+        uint64_t firstSeen;
+        uint64_t lastSeen;
+    };
+
+    /** @param capacity Initial number of slots, rounded up to a power of two */
+    explicit TagCounter(size_t capacity = 4096);
+
+    /** Adds count reads of tag seen between first and last. */
+    void add(const TagKey &tag, uint32_t count, uint64_t first, uint64_t last);
+    void add(const TagKey &tag, uint64_t ts) { add(tag, 1, ts, ts); }
+
+    /** Adds every counter of other. */
+    void merge(const TagCounter &other);
+
+    void clear();
+
+    size_t size() const { return size_; }
+    size_t capacity() const { return slots_.size(); }
+
+    /** Slot i, empty when its hash is 0. */
+    const Entry &slot(size_t i) const { return slots_[i]; }
+
+    /** Tag of an occupied slot. */
+    TagKey tag(const Entry &entry) const { return TagKey(entry.type, ids_.data() + entry.idOffset, entry.idLength); }
+
+private:
+    void insert(uint32_t hash, uint16_t type, const uint8_t *id, uint8_t idLength,
+                uint32_t count, uint64_t first, uint64_t last);
+    void grow();
+
+    std::vector<Entry> slots_;
+    std::vector<uint8_t> ids_;
+    size_t size_;
+};
+
+#endif
@@ -0,0 +1,70 @@
+/**
+ * TagEvent.cpp
+ *
+ * Tag event helpers.
+ */
+#include <stdio.h>
+#include "TagEvent.h"
+
+TagKey::TagKey(uint16_t t, const uint8_t *bytes, size_t length) : type(t) {
+    if (length > TAG_EVENT_MAX_ID)
+        length = TAG_EVENT_MAX_ID;
+    idLength = (uint8_t) length;
+    memcpy(id, bytes, length);
+}
+
+size_t TagKeyHash::operator()(const TagKey &key) const {
+    // FNV-1a over type and ID bytes
+    uint32_t h = 2166136261u;
+    h = (h ^ (key.type & 0xFF)) * 16777619u;
+    h = (h ^ (key.type >> 8)) * 16777619u;
+    for (size_t i = 0; i < key.idLength; i++)
+        h = (h ^ key.id[i]) * 16777619u;
+    return h;
+}
+
+const char *TagEventKindName(TagEventKind kind) {
+    switch (kind) {
+        case TAG_EVENT_READ:
+            return "read";
+        case TAG_EVENT_ENTER:
+            return "enter";
+        case TAG_EVENT_LEAVE:
+            return "leave";
+        case TAG_EVENT_WINDOW:
+            return "window";
+        case TAG_EVENT_ZONE:
+            return "zone";
+    }
+    return "unknown";
+}
+
+size_t FormatTagId(const TagKey &tag, char *buf, size_t size) {
+    static const char hex[] = "0123456789ABCDEF";
+    size_t n = 0;
+    for (size_t i = 0; i < tag.idLength && n + 2 < size; i++) {
+        buf[n++] = hex[tag.id[i] >> 4];
+        buf[n++] = hex[tag.id[i] & 0x0F];
+    }
+    if (size > 0)
+        buf[n] = '\0';
+    return n;
+}
+
+size_t FormatTagEventJson(const TagEvent &event, char *buf, size_t size) {
+    char id[TAG_EVENT_MAX_ID * 2 + 1];
+    FormatTagId(event.tag, id, sizeof(id));
+    char from[TAG_EVENT_MAX_RID + 12] = "";
+    if (event.kind == TAG_EVENT_ZONE)
+        snprintf(from, sizeof(from), "\"from\":\"%s\",", event.from);
+    int n = snprintf(buf, size,
+                     "{\"event\":\"%s\",\"rid\":\"%s\",%s\"type\":%u,\"id\":\"%s\","
+                     "\"ts\":%llu,\"firstSeen\":%llu,\"lastSeen\":%llu,\"count\":%u}",
+                     TagEventKindName(event.kind), event.rid, from, event.tag.type, id,
+                     (unsigned long long) event.timestamp,
+                     (unsigned long long) event.firstSeen,
+                     (unsigned long long) event.lastSeen, event.count);
+    if (n < 0 || (size_t) n >= size)
+        return 0;
+    return (size_t) n;
+}
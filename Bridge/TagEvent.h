@@ -0,0 +1,73 @@
+/**
+ * TagEvent.h
+ *
+ * Fixed-size tag event passed between the bridge stages.
+ */
+#ifndef BRIDGE_TAG_EVENT_H
+#define BRIDGE_TAG_EVENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define TAG_EVENT_MAX_ID    64
+#define TAG_EVENT_MAX_RID   32
+
+enum TagEventKind {
+    TAG_EVENT_READ = 0,
+    TAG_EVENT_ENTER,
+    TAG_EVENT_LEAVE,
+    TAG_EVENT_WINDOW,       // per-tag summary of a time window, see WindowAggregator.h
+    TAG_EVENT_ZONE          // tag moved between readers, see ZoneFusion.h; JSON only
+};
+
+struct TagKey {
+    uint16_t type;
+    uint8_t idLength;
+    uint8_t id[TAG_EVENT_MAX_ID];
+
+    TagKey() : type(0), idLength(0) {}
+    TagKey(uint16_t t, const uint8_t *bytes, size_t length);
+
+    bool operator==(const TagKey &other) const {
+        return type == other.type && idLength == other.idLength &&
+               memcmp(id, other.id, idLength) == 0;
+    }
+};
+
+struct TagKeyHash {
+    size_t operator()(const TagKey &key) const;
+};
+
+struct TagEvent {
+    TagEventKind kind;
+    char rid[TAG_EVENT_MAX_RID];
+    char from[TAG_EVENT_MAX_RID];   // zone events: previous reader, empty if none
+    TagKey tag;
+    uint64_t timestamp;     // ms since epoch when the event was produced
+    uint64_t firstSeen;     // ms since epoch of the first read
+    uint64_t lastSeen;      // ms since epoch of the latest read
+    uint32_t count;         // reads folded into this event
+
+    TagEvent() : kind(TAG_EVENT_READ), timestamp(0), firstSeen(0), lastSeen(0), count(0) {
+        rid[0] = '\0';
+        from[0] = '\0';
+    }
+};
+
+/** Receives events produced by a stage. */
+class EventSink {
+public:
+    virtual ~EventSink() {}
+    virtual void onEvent(const TagEvent &event) = 0;
+};
+
+const char *TagEventKindName(TagEventKind kind);
+
+/** Writes the tag ID as upper-case hex; returns the number of characters written. */
+size_t FormatTagId(const TagKey &tag, char *buf, size_t size);
+
+/** Formats the event as a JSON object; returns the length or 0 if buf is too small. */
+size_t FormatTagEventJson(const TagEvent &event, char *buf, size_t size);
+
+#endif
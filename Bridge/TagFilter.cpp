@@ -0,0 +1,164 @@
+/**
+ * TagFilter.cpp
+ *
+ * Rule parsing and the bit-parallel matcher.
+ */
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "TagFilter.h"
+
+static int hexDigit(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    c = (char) toupper((unsigned char) c);
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+// Parses count hex digit pairs of s into bytes; returns the number of bytes or -1
+static int parseHex(const char *s, size_t count, uint8_t *bytes, size_t size) {
+    if (count % 2 != 0 || count / 2 > size)
+        return -1;
+    for (size_t i = 0; i < count; i += 2) {
+        int hi = hexDigit(s[i]);
+        int lo = hexDigit(s[i + 1]);
+        if (hi < 0 || lo < 0)
+            return -1;
+        bytes[i / 2] = (uint8_t) (hi << 4 | lo);
+    }
+    return (int) (count / 2);
+}
+
+TagFilter::TagFilter() : allowRules_(0), denyRules_(0), depth_(0), accepted_(0), denied_(0), unmatched_(0) {
+    compile();
+}
+
+bool TagFilter::addRule(bool allow, const char *text) {
+    Rule rule;
+    const char *colon = strchr(text, ':');
+    const char *slash;
+    int n;
+
+    if (rules_.size() == TAG_FILTER_MAX_RULES)
+        return false;
+    rule.allow = allow;
+    rule.anyType = true;
+    rule.type = 0;
+    if (colon != NULL) {
+        if (colon - text != 1 || text[0] != '*') {
+            char *end;
+            unsigned long type = strtoul(text, &end, 16);
+            if (end != colon || colon == text || type > 0xFFFF)
+                return false;
+            rule.anyType = false;
+            rule.type = (uint16_t) type;
+        }
+        text = colon + 1;
+    }
+
+    slash = strchr(text, '/');
+    n = parseHex(text, slash ? (size_t) (slash - text) : strlen(text), rule.value, sizeof(rule.value));
+    if (n < 0)
+        return false;
+    rule.length = (size_t) n;
+    memset(rule.mask, 0xFF, sizeof(rule.mask));
+    if (slash != NULL && parseHex(slash + 1, strlen(slash + 1), rule.mask, sizeof(rule.mask)) != n)
+        return false;
+    for (size_t i = 0; i < rule.length; i++)
+        rule.value[i] &= rule.mask[i];
+    rules_.push_back(rule);
+    return true;
+}
+
+bool TagFilter::loadRules(const char *path) {
+    char line[256];
+    FILE *f = fopen(path, "r");
+    bool ok = true;
+
+    if (f == NULL)
+        return false;
+    while (ok && fgets(line, sizeof(line), f) != NULL) {
+        char verb[16], rule[200];
+        int fields = sscanf(line, "%15s %199s", verb, rule);
+        if (fields <= 0 || verb[0] == '#')
+            continue;
+        if (fields != 2 || (strcmp(verb, "allow") != 0 && strcmp(verb, "deny") != 0) ||
+            !addRule(strcmp(verb, "allow") == 0, rule)) {
+            fprintf(stderr, "%s: bad rule: %s", path, line);
+            ok = false;
+        }
+    }
+    fclose(f);
+    return ok;
+}
+
+void TagFilter::compile() {
+    allowRules_ = denyRules_ = 0;
+    depth_ = 0;
+    for (size_t r = 0; r < rules_.size(); r++) {
+        uint64_t bit = (uint64_t) 1 << r;
+        if (rules_[r].allow)
+            allowRules_ |= bit;
+        else
+            denyRules_ |= bit;
+        if (rules_[r].length > depth_)
+            depth_ = rules_[r].length;
+    }
+
+    for (int v = 0; v < 256; v++) {
+        typeLow_[v] = typeHigh_[v] = 0;
+        for (size_t r = 0; r < rules_.size(); r++) {
+            uint64_t bit = (uint64_t) 1 << r;
+            if (rules_[r].anyType || (rules_[r].type & 0xFF) == v)
+                typeLow_[v] |= bit;
+            if (rules_[r].anyType || (rules_[r].type >> 8) == v)
+                typeHigh_[v] |= bit;
+        }
+    }
+
+    bytes_.assign(depth_ * 256, 0);
+    for (size_t pos = 0; pos < depth_; pos++) {
+        for (int v = 0; v < 256; v++) {
+            uint64_t accept = 0;
+            for (size_t r = 0; r < rules_.size(); r++) {
+                const Rule &rule = rules_[r];
+                if (pos >= rule.length || (v & rule.mask[pos]) == rule.value[pos])
+                    accept |= (uint64_t) 1 << r;
+            }
+            bytes_[pos * 256 + v] = accept;
+        }
+    }
+
+    for (size_t n = 0; n <= TAG_EVENT_MAX_ID; n++) {
+        shorter_[n] = 0;
+        for (size_t r = 0; r < rules_.size(); r++) {
+            if (rules_[r].length <= n)
+                shorter_[n] |= (uint64_t) 1 << r;
+        }
+    }
+}
+
+bool TagFilter::accept(uint16_t type, const uint8_t *id, size_t length) {
+    uint64_t match = typeLow_[type & 0xFF] & typeHigh_[type >> 8];
+    size_t n = length < depth_ ? length : depth_;
+
+    for (size_t i = 0; i < n && match != 0; i++)
+        match &= bytes_[i * 256 + id[i]];
+    // A rule longer than the ID cannot match it
+    if (length < depth_)
+        match &= shorter_[length];
+
+    if (match & denyRules_) {
+        denied_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    if (allowRules_ != 0 && !(match & allowRules_)) {
+        unmatched_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    accepted_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
@@ -0,0 +1,84 @@
+/**
+ * TagFilter.h
+ *
+ * Allow and deny rules on tag type and ID bytes, compiled into lookup
+ * tables so a read is judged with one table lookup per ID byte and no
+ * string conversion. A rule is
+ *
+ *   [TYPE:]PREFIX[/MASK]
+ *
+ * where TYPE is a hex tag type or * for any, PREFIX the hex leading ID
+ * bytes and MASK, when given, as many hex bytes selecting the bits of
+ * PREFIX that must match. For example 8001:E28011 allows Gen 2 tags of
+ * one company prefix, and E2/F0 any ID whose first nibble is E.
+ *
+ * A read is dropped if it matches a deny rule, or if there are allow
+ * rules and it matches none of them.
+ *
+ * Each rule is one bit of a 64-bit mask: for every ID position a table
+ * gives the rules that accept each byte value there, and the rules
+ * still matching after the last byte are the AND of those entries.
+ */
+#ifndef BRIDGE_TAG_FILTER_H
+#define BRIDGE_TAG_FILTER_H
+
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+#include "TagEvent.h"
+
+#define TAG_FILTER_MAX_RULES    64
+
+class TagFilter {
+public:
+    TagFilter();
+
+    /**
+     * Adds a rule; takes effect at the next compile().
+     * @return false if the rule does not parse or there are too many
+     */
+    bool addRule(bool allow, const char *rule);
+
+    /**
+     * Adds the rules of a file with one "allow RULE" or "deny RULE" per
+     * line; blank lines and lines starting with # are skipped.
+     * @return false if the file cannot be read or a rule is invalid
+     */
+    bool loadRules(const char *path);
+
+    /** Builds the lookup tables from the rules added so far. */
+    void compile();
+
+    /** Judges one read; safe to call from several threads. */
+    bool accept(uint16_t type, const uint8_t *id, size_t length);
+
+    size_t rules() const { return rules_.size(); }
+    uint64_t accepted() const { return accepted_; }
+    uint64_t denied() const { return denied_; }         // matched a deny rule
+    uint64_t unmatched() const { return unmatched_; }   // matched no allow rule
+
+private:
+    struct Rule {
+        bool allow;
+        bool anyType;
+        uint16_t type;
+        size_t length;
+        uint8_t value[TAG_EVENT_MAX_ID];
+        uint8_t mask[TAG_EVENT_MAX_ID];
+    };
+
+    std::vector<Rule> rules_;
+    uint64_t allowRules_;
+    uint64_t denyRules_;
+    uint64_t typeLow_[256];             // rules accepting each low byte of the type
+    uint64_t typeHigh_[256];            // rules accepting each high byte of the type
+    std::vector<uint64_t> bytes_;       // [position * 256 + value], positions < depth_
+    uint64_t shorter_[TAG_EVENT_MAX_ID + 1];  // rules at most n bytes long
+    size_t depth_;                      // longest rule
+
+    std::atomic<uint64_t> accepted_;
+    std::atomic<uint64_t> denied_;
+    std::atomic<uint64_t> unmatched_;
+};
+
+#endif
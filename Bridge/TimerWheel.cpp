@@ -0,0 +1,96 @@
+/**
+ * TimerWheel.cpp
+ *
+ * Hierarchical timer wheel implementation.
+ */
+#include "TimerWheel.h"
+
+TimerWheel::TimerWheel(uint32_t tickMs, uint64_t nowMs)
+        : tickMs_(tickMs ? tickMs : 1), current_(nowMs / (tickMs ? tickMs : 1)) {
+    for (int level = 0; level < LEVELS; level++)
+        for (int slot = 0; slot < LEVEL_SLOTS; slot++)
+            slots_[level][slot].prev = slots_[level][slot].next = &slots_[level][slot];
+}
+
+void TimerWheel::link(TimerNode *head, TimerNode *node) {
+    node->prev = head->prev;
+    node->next = head;
+    head->prev->next = node;
+    head->prev = node;
+}
+
+void TimerWheel::unlink(TimerNode *node) {
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = node->next = NULL;
+}
+
+void TimerWheel::place(TimerNode *node) {
+    uint64_t expires = node->expires;
+    uint64_t delta;
+
+    if (expires < current_)
+        expires = current_;
+    delta = expires - current_;
+
+    for (int level = 0; level < LEVELS; level++) {
+        if (delta < ((uint64_t) 1 << (LEVEL_BITS * (level + 1)))) {
+            link(&slots_[level][(expires >> (LEVEL_BITS * level)) & LEVEL_MASK], node);
+            return;
+        }
+    }
+    // Beyond the wheel's range; park it in the top level and let it cascade again
+    expires = current_ + ((uint64_t) 1 << (LEVEL_BITS * LEVELS)) - 1;
+    link(&slots_[LEVELS - 1][(expires >> (LEVEL_BITS * (LEVELS - 1))) & LEVEL_MASK], node);
+}
+
+void TimerWheel::schedule(TimerNode *node, uint64_t expiresMs) {
+    if (node->pending())
+        unlink(node);
+    node->expires = (expiresMs + tickMs_ - 1) / tickMs_;
+    place(node);
+}
+
+void TimerWheel::cancel(TimerNode *node) {
+    if (node->pending())
+        unlink(node);
+}
+
+size_t TimerWheel::advance(uint64_t nowMs, ExpireHandler handler, void *user) {
+    uint64_t target = nowMs / tickMs_;
+    size_t expired = 0;
+
+    while (current_ <= target) {
+        unsigned int index = (unsigned int) (current_ & LEVEL_MASK);
+
+        // Entering a new revolution: pull the next slot of each higher level down
+        if (index == 0) {
+            for (int level = 1; level < LEVELS; level++) {
+                unsigned int slot = (unsigned int) ((current_ >> (LEVEL_BITS * level)) & LEVEL_MASK);
+                TimerNode *head = &slots_[level][slot];
+                while (head->next != head) {
+                    TimerNode *node = head->next;
+                    unlink(node);
+                    place(node);
+                }
+                if (slot != 0)
+                    break;
+            }
+        }
+
+        TimerNode *head = &slots_[0][index];
+        while (head->next != head) {
+            TimerNode *node = head->next;
+            unlink(node);
+            if (node->expires > current_) {
+                // Parked beyond range earlier; not due yet
+                place(node);
+                continue;
+            }
+            expired++;
+            handler(node, user);
+        }
+        current_++;
+    }
+    return expired;
+}
@@ -0,0 +1,70 @@
+/**
+ * TimerWheel.h
+ *
+ * Hierarchical timer wheel. Scheduling, cancelling and expiring a
+ * timer are O(1); timers further out are cascaded down a level once
+ * per revolution of the level below.
+ */
+#ifndef BRIDGE_TIMER_WHEEL_H
+#define BRIDGE_TIMER_WHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Intrusive timer; embed it in the object that owns the timeout. */
+struct TimerNode {
+    TimerNode *prev;
+    TimerNode *next;
+    uint64_t expires;       // absolute tick
+
+    TimerNode() : prev(NULL), next(NULL), expires(0) {}
+    bool pending() const { return next != NULL; }
+};
+
+class TimerWheel {
+public:
+    typedef void (*ExpireHandler)(TimerNode *node, void *user);
+
+    /**
+     * @param tickMs Resolution of the wheel in milliseconds
+     * @param nowMs Current monotonic time
+     */
+    TimerWheel(uint32_t tickMs, uint64_t nowMs);
+
+    /** Schedules node to expire at the monotonic time expiresMs, rescheduling if pending. */
+    void schedule(TimerNode *node, uint64_t expiresMs);
+
+    /** Removes node from the wheel if pending. */
+    void cancel(TimerNode *node);
+
+    /**
+     * Expires every timer due at or before nowMs. The handler may
+     * schedule or cancel any timer, but must not reschedule the
+     * expiring one at or before nowMs.
+     * @return Number of timers expired
+     */
+    size_t advance(uint64_t nowMs, ExpireHandler handler, void *user);
+
+    uint32_t tickMs() const { return tickMs_; }
+
+private:
+    enum {
+        LEVEL_BITS = 6,
+        LEVEL_SLOTS = 1 << LEVEL_BITS,
+        LEVEL_MASK = LEVEL_SLOTS - 1,
+        LEVELS = 4
+    };
+
+    void place(TimerNode *node);
+    static void link(TimerNode *head, TimerNode *node);
+    static void unlink(TimerNode *node);
+
+    uint32_t tickMs_;
+    uint64_t current_;      // next tick to process
+    TimerNode slots_[LEVELS][LEVEL_SLOTS];
+
+    TimerWheel(const TimerWheel &);
+    TimerWheel &operator=(const TimerWheel &);
+};
+
+#endif
@@ -0,0 +1,118 @@
+/**
+ * WindowAggregator.cpp
+ *
+ * Tumbling and sliding window counts per tag.
+ */
+#include <stdio.h>
+#include "Clock.h"
+#include "WindowAggregator.h"
+
+WindowAggregator::WindowAggregator(const char *rid, uint32_t windowMs, uint32_t slideMs, WindowSink *sink)
+        : sink_(sink) {
+    snprintf(rid_, sizeof(rid_), "%s", rid);
+    if (windowMs == 0)
+        windowMs = 1;
+    if (slideMs == 0 || slideMs > windowMs)
+        slideMs = windowMs;
+    slideMs_ = slideMs;
+    panes_ = (windowMs + slideMs - 1) / slideMs;
+    ring_.resize(panes_);
+    current_ = WallClockMs() / slideMs_;
+}
+
+void WindowAggregator::observe(const TagKey &tag) {
+    std::vector<Summary> summaries;
+    uint64_t now = WallClockMs();
+    std::unique_lock<std::mutex> guard(lock_);
+    advance(now / slideMs_);
+    ring_[current_ % panes_].add(tag, now);
+    summaries.swap(pending_);
+    emit(guard, summaries);
+}
+
+void WindowAggregator::tick() {
+    std::vector<Summary> summaries;
+    std::unique_lock<std::mutex> guard(lock_);
+    advance(WallClockMs() / slideMs_);
+    summaries.swap(pending_);
+    emit(guard, summaries);
+}
+
+void WindowAggregator::flush() {
+    std::vector<Summary> summaries;
+    std::unique_lock<std::mutex> guard(lock_);
+    summarize(current_);
+    for (size_t i = 0; i < panes_; i++)
+        ring_[i].clear();
+    summaries.swap(pending_);
+    emit(guard, summaries);
+}
+
+void WindowAggregator::advance(uint64_t pane) {
+    if (pane <= current_)
+        return;
+    // After a quiet spell only the last windows can still hold reads
+    if (pane - current_ > panes_) {
+        for (uint64_t p = current_; p < current_ + panes_; p++)
+            summarize(p);
+        for (size_t i = 0; i < panes_; i++)
+            ring_[i].clear();
+        current_ = pane;
+        return;
+    }
+    while (current_ < pane) {
+        summarize(current_);
+        current_++;
+        ring_[current_ % panes_].clear();
+    }
+}
+
+void WindowAggregator::summarize(uint64_t endPane) {
+    const TagCounter *counter = &ring_[endPane % panes_];
+    uint64_t first = endPane + 1 >= panes_ ? endPane + 1 - panes_ : 0;
+
+    if (panes_ > 1) {
+        // Only panes current_ - panes_ + 1 .. current_ are in the ring
+        merged_.clear();
+        for (uint64_t p = first; p <= endPane; p++) {
+            if (p + panes_ > current_ && p <= current_)
+                merged_.merge(ring_[p % panes_]);
+        }
+        counter = &merged_;
+    }
+    if (counter->size() == 0)
+        return;
+
+    pending_.resize(pending_.size() + 1);
+    Summary &summary = pending_.back();
+    summary.start = first * slideMs_;
+    summary.end = (endPane + 1) * slideMs_;
+    summary.events.resize(counter->size());
+    size_t n = 0;
+    for (size_t i = 0; i < counter->capacity(); i++) {
+        const TagCounter::Entry &entry = counter->slot(i);
+        if (entry.hash == 0)
+            continue;
+        TagEvent &event = summary.events[n++];
+        event.kind = TAG_EVENT_WINDOW;
+        memcpy(event.rid, rid_, sizeof(rid_));
+        event.tag = counter->tag(entry);
+        event.timestamp = summary.end;
+        event.firstSeen = entry.firstSeen;
+        event.lastSeen = entry.lastSeen;
+        event.count = entry.count;
+    }
+}
+
+// Releases guard; the sink sees windows in the order they were summarized,
+// and never from two threads at once
+void WindowAggregator::emit(std::unique_lock<std::mutex> &guard, std::vector<Summary> &summaries) {
+    if (summaries.empty()) {
+        guard.unlock();
+        return;
+    }
+    std::lock_guard<std::mutex> order(emitLock_);
+    guard.unlock();
+    for (size_t i = 0; i < summaries.size(); i++)
+        sink_->onWindow(summaries[i].start, summaries[i].end, &summaries[i].events[0], summaries[i].events.size());
+}
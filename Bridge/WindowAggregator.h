@@ -0,0 +1,78 @@
+/**
+ * WindowAggregator.h
+ *
+ * Folds the raw reads of one reader into per-tag summaries over time
+ * windows aligned to the wall clock. Reads are counted in panes of
+ * slideMs; every slideMs the window made of the last windowMs / slideMs
+ * panes is summarized. With slideMs equal to windowMs the windows are
+ * tumbling, with a smaller slide they overlap.
+ *
+ * A summary holds one TAG_EVENT_WINDOW event per tag seen in the window,
+ * carrying its read count and first and last read time, and is handed
+ * to the sink in one call, in window order even when reads and ticks
+ * come from different threads. Windows without reads are not reported.
+ */
+#ifndef BRIDGE_WINDOW_AGGREGATOR_H
+#define BRIDGE_WINDOW_AGGREGATOR_H
+
+#include <mutex>
+#include <vector>
+#include "TagCounter.h"
+#include "TagEvent.h"
+
+/** Receives window summaries. */
+class WindowSink {
+public:
+    virtual ~WindowSink() {}
+
+    /**
+     * @param start Window start, ms since epoch
+     * @param end Window end (exclusive), ms since epoch
+     */
+    virtual void onWindow(uint64_t start, uint64_t end, const TagEvent *events, size_t count) = 0;
+};
+
+class WindowAggregator {
+public:
+    /**
+     * @param rid Reader ID stamped on the events
+     * @param windowMs Window length, rounded up to a multiple of slideMs
+     * @param slideMs Distance between window ends; 0 or windowMs for tumbling windows
+     * @param sink Receives the summaries
+     */
+    WindowAggregator(const char *rid, uint32_t windowMs, uint32_t slideMs, WindowSink *sink);
+
+    /** Counts a read of tag. */
+    void observe(const TagKey &tag);
+
+    /** Reports the windows that ended since the last call. */
+    void tick();
+
+    /** Reports the window ending with the current pane, e.g. at shutdown. */
+    void flush();
+
+private:
+    struct Summary {
+        uint64_t start;
+        uint64_t end;
+        std::vector<TagEvent> events;
+    };
+
+    void advance(uint64_t pane);
+    void summarize(uint64_t endPane);
+    void emit(std::unique_lock<std::mutex> &guard, std::vector<Summary> &summaries);
+
+    char rid_[TAG_EVENT_MAX_RID];
+    uint64_t slideMs_;
+    size_t panes_;
+    WindowSink *sink_;
+
+    std::mutex lock_;
+    std::vector<TagCounter> ring_;  // pane p lives in ring_[p % panes_]
+    TagCounter merged_;
+    uint64_t current_;              // pane index, now / slideMs
+    std::vector<Summary> pending_;  // filled under lock_, emitted after
+    std::mutex emitLock_;           // taken before lock_ is released
+};
+
+#endif
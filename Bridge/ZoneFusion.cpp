@@ -0,0 +1,142 @@
+/**
+ * ZoneFusion.cpp
+ *
+ * Cross-reader zone assignment.
+ */
+#include <stdio.h>
+#include "Clock.h"
+#include "ZoneFusion.h"
+
+ZoneFusion::ZoneFusion(uint32_t windowMs, uint32_t absenceMs, uint32_t tickMs, EventSink *sink)
+        : windowMs_(windowMs ? windowMs : 1), absenceMs_(absenceMs), sink_(sink),
+          wheel_(tickMs, MonotonicMs()), changes_(0) {
+}
+
+int ZoneFusion::addReader(const char *rid) {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (rids_.size() == ZONE_MAX_READERS)
+        return -1;
+    rids_.push_back(rid);
+    return (int) rids_.size() - 1;
+}
+
+uint64_t ZoneFusion::score(const Entry &entry, int reader, uint64_t now) const {
+    // The previous bucket counts for the part of it still inside the window
+    uint64_t elapsed = now - entry.bucketStart;
+    uint64_t weight = elapsed < windowMs_ ? windowMs_ - elapsed : 0;
+    return (uint64_t) entry.current[reader] * windowMs_ + entry.previous[reader] * weight;
+}
+
+void ZoneFusion::makeEvent(const Entry &entry, uint8_t from, uint8_t to, TagEvent &event) {
+    event.kind = TAG_EVENT_ZONE;
+    snprintf(event.rid, sizeof(event.rid), "%s", to == ZONE_NONE ? "" : rids_[to].c_str());
+    snprintf(event.from, sizeof(event.from), "%s", from == ZONE_NONE ? "" : rids_[from].c_str());
+    event.tag = entry.tag;
+    event.timestamp = WallClockMs();
+    event.firstSeen = entry.firstSeen;
+    event.lastSeen = entry.lastSeen;
+    event.count = entry.count;
+}
+
+// Releases guard; events leave in the order they were decided under it
+void ZoneFusion::emit(std::unique_lock<std::mutex> &guard, std::vector<TagEvent> &events) {
+    if (events.empty()) {
+        guard.unlock();
+        return;
+    }
+    std::lock_guard<std::mutex> order(emitLock_);
+    guard.unlock();
+    for (size_t i = 0; i < events.size(); i++)
+        sink_->onEvent(events[i]);
+    events.clear();
+}
+
+void ZoneFusion::observe(int reader, const TagKey &tag) {
+    std::vector<TagEvent> events;
+    uint64_t now = WallClockMs();
+
+    if (reader < 0 || reader >= ZONE_MAX_READERS)
+        return;
+    std::unique_lock<std::mutex> guard(lock_);
+    std::pair<Table::iterator, bool> slot = table_.emplace(tag, Entry());
+    Entry &entry = slot.first->second;
+    uint64_t bucket = now / windowMs_ * windowMs_;
+
+    if (slot.second) {
+        entry.tag = tag;
+        entry.firstSeen = now;
+        entry.count = 0;
+        entry.zone = ZONE_NONE;
+        entry.bucketStart = bucket;
+        memset(entry.current, 0, sizeof(entry.current));
+        memset(entry.previous, 0, sizeof(entry.previous));
+    } else if (bucket != entry.bucketStart) {
+        if (bucket - entry.bucketStart == windowMs_)
+            memcpy(entry.previous, entry.current, sizeof(entry.current));
+        else
+            memset(entry.previous, 0, sizeof(entry.previous));
+        memset(entry.current, 0, sizeof(entry.current));
+        entry.bucketStart = bucket;
+    }
+    if (entry.current[reader] < 0xFFFF)
+        entry.current[reader]++;
+    entry.lastSeen = now;
+    entry.count++;
+    wheel_.schedule(&entry, MonotonicMs() + absenceMs_);
+
+    // Move only when another reader has strictly overtaken the current zone
+    uint8_t zone = entry.zone;
+    if (zone == ZONE_NONE) {
+        zone = (uint8_t) reader;
+    } else if (zone != reader && score(entry, reader, now) > score(entry, zone, now)) {
+        zone = (uint8_t) reader;
+        for (size_t r = 0; r < rids_.size(); r++) {
+            if (score(entry, (int) r, now) > score(entry, zone, now))
+                zone = (uint8_t) r;
+        }
+    }
+    if (zone != entry.zone) {
+        events.resize(1);
+        entry.count = 1;
+        makeEvent(entry, entry.zone, zone, events[0]);
+        entry.zone = zone;
+        changes_++;
+    }
+    emit(guard, events);
+}
+
+void ZoneFusion::onExpired(TimerNode *node, void *user) {
+    ZoneFusion *self = (ZoneFusion *) user;
+    Entry *entry = static_cast<Entry *>(node);
+    self->pending_.resize(self->pending_.size() + 1);
+    self->makeEvent(*entry, entry->zone, ZONE_NONE, self->pending_.back());
+    self->changes_++;
+    TagKey key = entry->tag;
+    self->table_.erase(key);
+}
+
+void ZoneFusion::tick() {
+    std::vector<TagEvent> events;
+    std::unique_lock<std::mutex> guard(lock_);
+    wheel_.advance(MonotonicMs(), onExpired, this);
+    events.swap(pending_);
+    emit(guard, events);
+}
+
+void ZoneFusion::flush() {
+    std::vector<TagEvent> events;
+    std::unique_lock<std::mutex> guard(lock_);
+    events.resize(table_.size());
+    size_t i = 0;
+    for (Table::iterator it = table_.begin(); it != table_.end(); ++it, ++i) {
+        wheel_.cancel(&it->second);
+        makeEvent(it->second, it->second.zone, ZONE_NONE, events[i]);
+    }
+    table_.clear();
+    emit(guard, events);
+}
+
+size_t ZoneFusion::size() {
+    std::lock_guard<std::mutex> guard(lock_);
+    return table_.size();
+}
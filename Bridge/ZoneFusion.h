@@ -0,0 +1,87 @@
+/**
+ * ZoneFusion.h
+ *
+ * Merges the reads of all local readers into one table of tags and
+ * places each tag in the zone of the reader that read it most over
+ * the last windowMs. A tag's zone changes only when another reader's
+ * count overtakes the current one, and a tag not read by any reader
+ * for absenceMs leaves to the empty zone. Each change is one
+ * TAG_EVENT_ZONE event whose rid is the new zone and from the old,
+ * and events reach the sink in the order the changes were decided.
+ *
+ * Counts are kept in two buckets of windowMs per tag, the previous one
+ * weighted by how much of it still lies inside the window, so a read
+ * costs a hash lookup and a scan over the registered readers.
+ */
+#ifndef BRIDGE_ZONE_FUSION_H
+#define BRIDGE_ZONE_FUSION_H
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "TagEvent.h"
+#include "TimerWheel.h"
+
+#define ZONE_MAX_READERS    16
+#define ZONE_NONE           0xFF
+
+class ZoneFusion {
+public:
+    /**
+     * @param windowMs Time over which read counts are compared
+     * @param absenceMs Time without reads after which a tag leaves
+     * @param tickMs Resolution of departure detection
+     * @param sink Receives zone events
+     */
+    ZoneFusion(uint32_t windowMs, uint32_t absenceMs, uint32_t tickMs, EventSink *sink);
+
+    /**
+     * Registers a reader before reads arrive.
+     * @return Reader index for observe(), or -1 if there are too many
+     */
+    int addReader(const char *rid);
+
+    /** Records a read of tag by a registered reader. */
+    void observe(int reader, const TagKey &tag);
+
+    /** Emits leave events for every tag whose absence timeout has passed. */
+    void tick();
+
+    /** Emits leave events for every tracked tag, e.g. at shutdown. */
+    void flush();
+
+    size_t size();
+    uint64_t changes() const { return changes_; }
+
+private:
+    struct Entry : TimerNode {
+        TagKey tag;
+        uint64_t firstSeen;
+        uint64_t lastSeen;
+        uint64_t bucketStart;       // wall clock ms, multiple of windowMs
+        uint32_t count;             // reads in the current zone
+        uint8_t zone;
+        uint16_t current[ZONE_MAX_READERS];
+        uint16_t previous[ZONE_MAX_READERS];
+    };
+    typedef std::unordered_map<TagKey, Entry, TagKeyHash> Table;
+
+    static void onExpired(TimerNode *node, void *user);
+    uint64_t score(const Entry &entry, int reader, uint64_t now) const;
+    void makeEvent(const Entry &entry, uint8_t from, uint8_t to, TagEvent &event);
+    void emit(std::unique_lock<std::mutex> &guard, std::vector<TagEvent> &events);
+
+    uint32_t windowMs_;
+    uint32_t absenceMs_;
+    EventSink *sink_;
+    std::vector<std::string> rids_;
+    std::mutex lock_;
+    Table table_;
+    TimerWheel wheel_;
+    std::vector<TagEvent> pending_;     // filled under lock_, emitted after
+    std::mutex emitLock_;               // taken before lock_ is released
+    uint64_t changes_;
+};
+
+#endif
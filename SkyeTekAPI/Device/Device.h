@@ -14,6 +14,21 @@
 extern "C" {
 #endif
 
+/**
+ * Transport state of one device. Every implementation allocates its
+ * per-device structure in device->transport, starting with this, so
+ * that devices are tuned and used independently of each other.
+ */
+typedef struct DEVICE_TRANSPORT
+{
+  unsigned int      timeout;      /* added to every read and write timeout */
+  unsigned int      retries;      /* further writes of the rest after a short write */
+} DEVICE_TRANSPORT, *LPDEVICE_TRANSPORT;
+
+/* Additional timeout of a device, 0 if it has no transport state */
+#define DEVICE_TIMEOUT(d) \
+  ((d)->transport != NULL ? ((LPDEVICE_TRANSPORT)(d)->transport)->timeout : 0)
+
 /**
  * Device that is connected to the host.
  */
@@ -83,7 +98,7 @@ typedef struct DEVICEIMPL
     );
 
   /**
-   * Sets an additional timeout value.
+   * Sets an additional timeout value of this device only.
    * @param timeout new timeout value
    */
   SKYETEK_STATUS
@@ -92,11 +107,6 @@ typedef struct DEVICEIMPL
     unsigned int      timeout
     );
 
-  /** 
-   * Timeout value for the device.
-   */
-  unsigned int timeout;
-
 } DEVICEIMPL, *LPDEVICEIMPL;
   
 extern DEVICEIMPL SerialDeviceImpl;
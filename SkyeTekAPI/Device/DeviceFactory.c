@@ -67,9 +67,9 @@ DiscoverDevicesImpl(
   
     if(localCount > 0) 
     {
-      *lpDevices = (LPSKYETEK_DEVICE*)realloc(*lpDevices, (deviceCount + localCount) * sizeof(LPSKYETEK_DEVICE));
+      *lpDevices = (LPSKYETEK_DEVICE*)SkyeTek_Realloc(*lpDevices, (deviceCount + localCount) * sizeof(LPSKYETEK_DEVICE));
       memcpy(((*lpDevices) + deviceCount), localDevices, localCount*sizeof(LPSKYETEK_DEVICE));
-      free(localDevices);
+      SkyeTek_Free(localDevices);
       deviceCount += localCount;
     }
   }
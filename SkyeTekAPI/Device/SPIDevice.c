@@ -16,13 +16,13 @@ SPIDevice_Open(LPSKYETEK_DEVICE device)
 {
   LPSPI_INFO info;
 
-	if( device == NULL || device->user == NULL )
+	if( device == NULL || device->transport == NULL )
 		return SKYETEK_INVALID_PARAMETER;
 
   if( device->readFD != 0 && device->writeFD != 0 )
 	  return SKYETEK_SUCCESS;
 
-  info = (LPSPI_INFO)device->user;
+  info = (LPSPI_INFO)device->transport;
   info->spiHandle = aa_open(info->port_number);
 
   if( info->spiHandle < 1 )
@@ -68,10 +68,10 @@ SKYETEK_STATUS
 SPIDevice_Close(LPSKYETEK_DEVICE device)
 {
   LPSPI_INFO info;
-	if(device == NULL || device->user == NULL)
+	if(device == NULL || device->transport == NULL)
 		return SKYETEK_INVALID_PARAMETER;
 	
-  info = (LPSPI_INFO)device->user;
+  info = (LPSPI_INFO)device->transport;
   if( info->spiHandle < 1 )
     return SKYETEK_INVALID_PARAMETER;
 
@@ -93,13 +93,13 @@ SPIDevice_Write(LPSKYETEK_DEVICE device,
   unsigned int i;
   aa_u16 len = (aa_u16)length;
 
-	if((device == NULL) || (buffer == NULL) || (device->user == NULL) )
+	if((device == NULL) || (buffer == NULL) || (device->transport == NULL) )
 		return 0;
 
   if( length == 0 )
     return 0;
 
-  info = (LPSPI_INFO)device->user;
+  info = (LPSPI_INFO)device->transport;
   if( info->spiHandle < 1 )
     return 0;
 
@@ -131,12 +131,12 @@ SPIDevice_Read(LPSKYETEK_DEVICE device,
   unsigned char bit;
   aa_u16 len = (aa_u16)length;
 
-  if( (device == NULL) || (buffer == NULL) || (device->user == NULL) )
+  if( (device == NULL) || (buffer == NULL) || (device->transport == NULL) )
 		return 0;
   if( length == 0 )
     return 0;
 
-  info = (LPSPI_INFO)device->user;
+  info = (LPSPI_INFO)device->transport;
   if( info->spiHandle < 1 )
     return SKYETEK_INVALID_PARAMETER;
 
@@ -173,14 +173,14 @@ SPIDevice_Free(LPSKYETEK_DEVICE device)
 {
 	LPSPI_INFO info;
 
-  if( device == NULL || device->user == NULL )
+  if( device == NULL || device->transport == NULL )
     return 0;
 
-  info = (LPSPI_INFO)device->user;
+  info = (LPSPI_INFO)device->transport;
   aa_close(info->spiHandle);  
   MUTEX_DESTROY(&info->lock);
   free(info);
-  device->user = NULL;
+  device->transport = NULL;
 
 	return 1;
 }
@@ -191,6 +191,9 @@ SPIDevice_SetAdditionalTimeout(
   unsigned int      timeout
   )
 {
+  if( lpDevice == NULL || lpDevice->transport == NULL )
+    return SKYETEK_INVALID_PARAMETER;
+  ((LPDEVICE_TRANSPORT)lpDevice->transport)->timeout = timeout;
   return SKYETEK_SUCCESS;
 }
 
@@ -217,7 +220,7 @@ SPIDevice_InitDevice(LPSKYETEK_DEVICE device)
   MUTEX_CREATE(&info->lock);
 
 	device->internal = &SPIDeviceImpl;
-	device->user = (void*)info;
+	device->transport = (void*)info;
 }
 
 DEVICEIMPL SPIDeviceImpl = {
@@ -227,6 +230,5 @@ DEVICEIMPL SPIDeviceImpl = {
 	SPIDevice_Write,
 	SPIDevice_Flush,
 	SPIDevice_Free,
-  SPIDevice_SetAdditionalTimeout,
-  0
+  SPIDevice_SetAdditionalTimeout
 };
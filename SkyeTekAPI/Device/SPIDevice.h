@@ -9,6 +9,7 @@
 #include "../SkyeTekAPI.h"
 #include "../SkyeTekProtocol.h"
 #include "../Drivers/aardvark.h"
+#include "Device.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -16,8 +17,10 @@ extern "C" {
 
 #define SPI_MSG_SIZE 2100
 
+/* Per-device state in device->transport */
 typedef struct SPI_INFO
 {
+  DEVICE_TRANSPORT base;
   aa_u16 port_number;
   Aardvark spiHandle;
   int type;
@@ -11,6 +11,7 @@
 #include <stdlib.h>
 #include <malloc.h>
 #include <string.h>
+#include <stdio.h>
 
 #ifndef WIN32
 #include <termios.h>
@@ -25,6 +26,11 @@
 #include <sys/poll.h>
 #include <errno.h>
 #endif
+#ifdef LINUX
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+#endif
 
 #include "../Platform.h"
 
@@ -39,6 +45,138 @@
 	#define SERIAL_WRITE(h, b, l, w) w = write(h, b, l)
 #endif
 
+/* Short writes are completed by up to this many further writes */
+#define SERIAL_WRITE_RETRIES 3
+
+#ifdef LINUX
+/*
+ * Received bytes are buffered per port. The protocol code reads
+ * responses a byte or a few bytes at a time; each such read is served
+ * from the ring, which is refilled with one read() of everything the
+ * driver holds once epoll reports the port readable.
+ */
+#define SERIAL_RING_SIZE 4096   /* power of two */
+#endif
+
+/* Per-device state in device->transport, from creation to Free */
+typedef struct SERIAL_PORT
+{
+  DEVICE_TRANSPORT  base;
+#ifdef LINUX
+  int             epollFD;      /* -1 while the port is closed */
+  unsigned int    head;         /* free running; head - tail bytes are buffered */
+  unsigned int    tail;
+  unsigned char   ring[SERIAL_RING_SIZE];
+#endif
+} SERIAL_PORT, *LPSERIAL_PORT;
+
+#ifdef LINUX
+/* Starts buffering reads of an opened port */
+static void 
+SerialPort_Attach(
+  LPSERIAL_PORT port,
+  int           fd
+  )
+{
+  struct epoll_event ev;
+  if( port == NULL )
+    return;
+  port->head = port->tail = 0;
+  if( (port->epollFD = epoll_create(1)) == -1 )
+    return;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  if( epoll_ctl(port->epollFD, EPOLL_CTL_ADD, fd, &ev) == -1 )
+  {
+    close(port->epollFD);
+    port->epollFD = -1;
+  }
+}
+
+static void 
+SerialPort_Detach(
+  LPSERIAL_PORT port
+  )
+{
+  if( port == NULL || port->epollFD == -1 )
+    return;
+  close(port->epollFD);
+  port->epollFD = -1;
+}
+
+/* Waits up to timeout ms for data and moves all of it into the ring */
+static int 
+SerialPort_Fill(
+  LPSERIAL_PORT port,
+  int           fd,
+  unsigned int  timeout
+  )
+{
+  struct epoll_event ev;
+  unsigned int space, offset;
+  int n, total = 0;
+
+  if( (n = epoll_wait(port->epollFD, &ev, 1, (int)timeout)) <= 0 )
+    return n;
+  while( (space = SERIAL_RING_SIZE - (port->head - port->tail)) > 0 )
+  {
+    /* Up to the end of the ring; a second pass wraps around */
+    offset = port->head & (SERIAL_RING_SIZE - 1);
+    if( space > SERIAL_RING_SIZE - offset )
+      space = SERIAL_RING_SIZE - offset;
+    if( (n = read(fd, port->ring + offset, space)) <= 0 )
+      break;
+    port->head += n;
+    total += n;
+    if( (unsigned int)n < space )
+      break;
+  }
+  return total > 0 ? total : n;
+}
+
+static int 
+SerialPort_Read(
+  LPSERIAL_PORT port,
+  int           fd,
+  unsigned char *buffer,
+  unsigned int  length,
+  unsigned int  timeout
+  )
+{
+  unsigned int count, offset, first;
+  int n;
+
+  if( port->head == port->tail && (n = SerialPort_Fill(port, fd, timeout)) <= 0 )
+    return n;
+  count = port->head - port->tail;
+  if( count > length )
+    count = length;
+  offset = port->tail & (SERIAL_RING_SIZE - 1);
+  first = SERIAL_RING_SIZE - offset;
+  if( first > count )
+    first = count;
+  memcpy(buffer, port->ring + offset, first);
+  memcpy(buffer + first, port->ring, count - first);
+  port->tail += count;
+  return (int)count;
+}
+
+/* Asks the driver to hand over received bytes at once; ttyUSB/FTDI
+ * otherwise hold them for its latency timer, 16ms by default */
+static void 
+SerialPort_SetLowLatency(
+  int fd
+  )
+{
+  struct serial_struct ss;
+  if( ioctl(fd, TIOCGSERIAL, &ss) == -1 )
+    return;
+  ss.flags |= ASYNC_LOW_LATENCY;
+  ioctl(fd, TIOCSSERIAL, &ss);
+}
+#endif
+
 #ifdef WIN32
 SKYETEK_STATUS 
 SerialDevice_Open(
@@ -356,8 +494,12 @@ SerialDevice_Open(
 		/* 4 is standard linux serial
 		 * 204 is S3C2410 serial
 		 * 188 is USB to serial
+		 * 166 is USB CDC ACM
+		 * 136 is a pty slave, as socat and the benchmarks use
 		 */
 		case 4:
+		case 136:
+		case 166:
 		case 188:
 		case 204:
 #elif defined(__sun)
@@ -375,6 +517,11 @@ SerialDevice_Open(
 			
 			device->readFD = device->writeFD;
 			device->asynchronous = 1;
+#ifdef LINUX
+			/* Without it reads fall back to read() and poll() */
+			SerialPort_SetLowLatency(device->readFD);
+			SerialPort_Attach((LPSERIAL_PORT)device->transport, device->readFD);
+#endif
 			break;
 		/*
 		 * 89 is I2C
@@ -520,6 +667,11 @@ SerialDevice_SetOptions(
   )
 {
   SKYETEK_STATUS st;
+#ifdef LINUX
+  /* Whatever arrived at the old settings is noise now */
+  if( device->transport != NULL )
+    ((LPSERIAL_PORT)device->transport)->tail = ((LPSERIAL_PORT)device->transport)->head;
+#endif
   if( (st = SerialDevice_SetOptionsImpl(device->readFD,lpSettings)) == SKYETEK_SUCCESS )
     st = SerialDevice_SetOptionsImpl(device->writeFD,lpSettings);
   return st;
@@ -540,45 +692,60 @@ SerialDevice_GetOptions(
   fd = device->readFD;
 	tcgetattr(fd, &options);
 
-  if( options.c_cflag & B110 )
+  /* Speeds and sizes are codes, not bits, so they cannot be tested with & */
+  switch( cfgetospeed(&options) )
+  {
+  case B110:
     lpSettings->baudRate = 110;
-  else if( options.c_cflag & B300 )
+    break;
+  case B300:
     lpSettings->baudRate = 300;
-  else if( options.c_cflag & B600 )
+    break;
+  case B600:
     lpSettings->baudRate = 600;
-  else if( options.c_cflag & B1200 )
+    break;
+  case B1200:
     lpSettings->baudRate = 1200;
-  else if( options.c_cflag & B2400 )
+    break;
+  case B2400:
     lpSettings->baudRate = 2400;
-  else if( options.c_cflag & B4800 )
+    break;
+  case B4800:
     lpSettings->baudRate = 4800;
-  else if( options.c_cflag & B9600 )
+    break;
+  case B9600:
     lpSettings->baudRate = 9600;
-  /*else if( options.c_cflag & B14400 )
-    lpSettings->baudRate = 14400;*/
-  else if( options.c_cflag & B19200 )
+    break;
+  case B19200:
     lpSettings->baudRate = 19200;
-  else if( options.c_cflag & B38400 )
+    break;
+  case B38400:
     lpSettings->baudRate = 38400;
-  /*else if( options.c_cflag & B56000 )
-    lpSettings->baudRate = 56000;*/
-  else if( options.c_cflag & B57600 )
+    break;
+  case B57600:
     lpSettings->baudRate = 57600;
-  else if( options.c_cflag & B115200 )
+    break;
+  case B115200:
     lpSettings->baudRate = 115200;
-  else
+    break;
+  default:
 		lpSettings->baudRate = 0;
+  }
 
-  if( options.c_cflag & CS5 )
+  switch( options.c_cflag & CSIZE )
+  {
+  case CS5:
     lpSettings->dataBits = 5;
-  else if( options.c_cflag & CS6 )
+    break;
+  case CS6:
     lpSettings->dataBits = 6;
-  else if( options.c_cflag & CS7 )
+    break;
+  case CS7:
     lpSettings->dataBits = 7;
-  else if( options.c_cflag & CS8 )
+    break;
+  default:
     lpSettings->dataBits = 8;
-  else
-    lpSettings->dataBits = 0;
+  }
 
   if( !(options.c_cflag & PARENB) )
     lpSettings->parity = NONE;
@@ -605,6 +772,9 @@ SerialDevice_Close(
 	if( device == NULL )
 		return SKYETEK_INVALID_PARAMETER;
 	
+#ifdef LINUX
+	SerialPort_Detach((LPSERIAL_PORT)device->transport);
+#endif
 	SERIAL_CLOSE(device->readFD);
 	
   	if(device->writeFD != device->readFD)
@@ -628,13 +798,14 @@ SerialDevice_Read(
 #ifdef WINCE
 	COMMTIMEOUTS ctos;
 #endif
-  LPDEVICEIMPL di;
+#ifdef LINUX
+  LPSERIAL_PORT port;
+#endif
 	int bytesRead = 0;
   unsigned int to;
 	if( (device == NULL) || (buffer == NULL) || (device->internal == NULL) )
 		return 0;
-  di = (LPDEVICEIMPL)device->internal;
-  to = max(di->timeout + timeout,100);
+  to = max(DEVICE_TIMEOUT(device) + timeout,100);
 
 #if defined(WIN32) && !defined(WINCE)
 	ZeroMemory(&overlap, sizeof(OVERLAPPED));
@@ -651,6 +822,11 @@ SerialDevice_Read(
 	SetCommTimeouts(device->readFD, &ctos);
 	ReadFile(device->readFD, buffer, length, &bytesRead, NULL);
 #else
+#ifdef LINUX
+  port = (LPSERIAL_PORT)device->transport;
+  if( port != NULL && port->epollFD != -1 )
+    return SerialPort_Read(port, device->readFD, buffer, length, to);
+#endif
   if (((bytesRead = read(device->readFD, buffer, length)) == -1) &&
       (errno == EAGAIN)) {
     struct pollfd fds;
@@ -685,13 +861,15 @@ SerialDevice_Write(
 #ifdef WINCE
 	COMMTIMEOUTS ctos;
 #endif
-  LPDEVICEIMPL di;
   int bytesWritten = 0;
   unsigned int to;
+#if !defined(WIN32)
+  unsigned int retries;
+  int n;
+#endif
 	if( (device == NULL) || (buffer == NULL) || (device->internal == NULL) )
 		return 0;
-  di = (LPDEVICEIMPL)device->internal;
-  to = max(timeout + di->timeout,100);
+  to = max(timeout + DEVICE_TIMEOUT(device),100);
 
 #if defined(WIN32) && !defined(WINCE)
 	ZeroMemory(&overlap, sizeof(OVERLAPPED));
@@ -708,20 +886,29 @@ SerialDevice_Write(
 	SetCommTimeouts(device->writeFD, &ctos);
 	WriteFile(device->writeFD, buffer, length, &bytesWritten, NULL);
 #else
-  if (((bytesWritten = write(device->writeFD, buffer, length)) == -1) &&
-      (errno == EAGAIN)) {
-    struct pollfd fds;
-    int i;
-
-    fds.fd = device->writeFD;
-    fds.events = POLLOUT;
-    fds.revents = 0;
-
-    i = poll(&fds, 1, to);
-    if (i <= 0)
-      return i;
-
-    bytesWritten = write(device->writeFD, buffer, length);
+  retries = device->transport != NULL ? ((LPDEVICE_TRANSPORT)device->transport)->retries : 0;
+  for (;;) {
+    if (((n = write(device->writeFD, buffer + bytesWritten, length - bytesWritten)) == -1) &&
+        (errno == EAGAIN)) {
+      struct pollfd fds;
+      int i;
+
+      fds.fd = device->writeFD;
+      fds.events = POLLOUT;
+      fds.revents = 0;
+
+      i = poll(&fds, 1, to);
+      if (i <= 0)
+        return bytesWritten > 0 ? bytesWritten : i;
+
+      n = write(device->writeFD, buffer + bytesWritten, length - bytesWritten);
+    }
+    if (n < 0)
+      return bytesWritten > 0 ? bytesWritten : n;
+    bytesWritten += n;
+    /* The driver took part of it; the rest goes after the next POLLOUT */
+    if ((unsigned int)bytesWritten == length || retries-- == 0)
+      break;
   }
 #endif
 	
@@ -744,7 +931,8 @@ SerialDevice_Free(
 	if(device == NULL)
 		return 0;
   SerialDevice_Close(device);
-  free(device);
+  SkyeTek_Free(device->transport);
+  SkyeTek_Free(device);
   return 1;
 }
 
@@ -754,24 +942,117 @@ SerialDevice_SetAdditionalTimeout(
   unsigned int      timeout
   )
 {
-  LPDEVICEIMPL di;
-
-  if( lpDevice == NULL || lpDevice->internal == NULL )
+  if( lpDevice == NULL || lpDevice->transport == NULL )
     return SKYETEK_INVALID_PARAMETER;
-  di = (LPDEVICEIMPL)lpDevice->internal;
-  di->timeout = timeout;
+  ((LPDEVICE_TRANSPORT)lpDevice->transport)->timeout = timeout;
 
   return SKYETEK_SUCCESS;
 }
 
+/* One "<address> <baud>" line per port, rewritten under g_baudLock by
+   whichever reader thread settles on a rate */
+static char g_baudCache[256];
+STATIC_MUTEX(g_baudLock);
+
+void 
+SerialDevice_SetBaudCache(
+  const TCHAR   *path
+  )
+{
+  STATIC_MUTEX_LOCK(&g_baudLock);
+  if( path == NULL )
+    g_baudCache[0] = 0;
+  else
+  {
+    strncpy(g_baudCache, path, sizeof(g_baudCache) - 1);
+    g_baudCache[sizeof(g_baudCache) - 1] = 0;
+  }
+  STATIC_MUTEX_UNLOCK(&g_baudLock);
+}
+
+unsigned int 
+SerialDevice_GetCachedBaud(
+  const TCHAR   *address
+  )
+{
+  FILE *fp;
+  char line[300], port[256];
+  unsigned int baud, found = 0;
+
+  if( address == NULL )
+    return 0;
+  STATIC_MUTEX_LOCK(&g_baudLock);
+  if( g_baudCache[0] != 0 && (fp = fopen(g_baudCache, "r")) != NULL )
+  {
+    while( fgets(line, sizeof(line), fp) != NULL )
+    {
+      if( sscanf(line, "%255s %u", port, &baud) == 2 && strcmp(port, address) == 0 )
+        found = baud;
+    }
+    fclose(fp);
+  }
+  STATIC_MUTEX_UNLOCK(&g_baudLock);
+  return found;
+}
+
+void 
+SerialDevice_SetCachedBaud(
+  const TCHAR   *address,
+  unsigned int  baudRate
+  )
+{
+  FILE *in, *out;
+  char line[300], port[256], tmp[270];
+  unsigned int baud;
+
+  if( address == NULL )
+    return;
+  STATIC_MUTEX_LOCK(&g_baudLock);
+  if( g_baudCache[0] == 0 )
+    goto done;
+  sprintf(tmp, "%s.tmp", g_baudCache);
+  if( (out = fopen(tmp, "w")) == NULL )
+    goto done;
+  if( (in = fopen(g_baudCache, "r")) != NULL )
+  {
+    while( fgets(line, sizeof(line), in) != NULL )
+    {
+      if( sscanf(line, "%255s %u", port, &baud) == 2 && strcmp(port, address) != 0 )
+        fprintf(out, "%s %u\n", port, baud);
+    }
+    fclose(in);
+  }
+  fprintf(out, "%s %u\n", address, baudRate);
+  fclose(out);
+  /* Replaced in one step, so a crash never leaves half a file */
+#ifdef WIN32
+  remove(g_baudCache);
+#endif
+  rename(tmp, g_baudCache);
+done:
+  STATIC_MUTEX_UNLOCK(&g_baudLock);
+}
+
 void 
 SerialDevice_InitDevice(
   LPSKYETEK_DEVICE device
   )
 {
+  LPSERIAL_PORT port;
+
 	if( device == NULL )
 		return;
   device->internal = &SerialDeviceImpl;
+
+  port = (LPSERIAL_PORT)SkyeTek_Malloc(sizeof(SERIAL_PORT));
+  if( port == NULL )
+    return;
+  memset(port, 0, sizeof(SERIAL_PORT));
+  port->base.retries = SERIAL_WRITE_RETRIES;
+#ifdef LINUX
+  port->epollFD = -1;
+#endif
+  device->transport = port;
 }
 
 DEVICEIMPL SerialDeviceImpl = {
@@ -781,6 +1062,5 @@ DEVICEIMPL SerialDeviceImpl = {
 	SerialDevice_Write,
 	SerialDevice_Flush,
 	SerialDevice_Free,
-  SerialDevice_SetAdditionalTimeout,
-  0
+  SerialDevice_SetAdditionalTimeout
 };
@@ -66,6 +66,36 @@ static SKYETEK_SERIAL_SETTINGS SerialDiscoverySettings [] = {
 
 #define NUM_SERIAL_DISCOVERY_SETTINGS (sizeof(SerialDiscoverySettings)/sizeof(SKYETEK_SERIAL_SETTINGS))
 
+/**
+ * Sets the file that remembers the baud rate of each serial port.
+ * @param path File path, or NULL to stop remembering
+ */
+void 
+SerialDevice_SetBaudCache(
+  const TCHAR   *path
+  );
+
+/**
+ * Looks up the remembered baud rate of a serial port.
+ * @param address Port address
+ * @return Baud rate, or 0 if none is remembered
+ */
+unsigned int 
+SerialDevice_GetCachedBaud(
+  const TCHAR   *address
+  );
+
+/**
+ * Remembers the baud rate of a serial port for the next start.
+ * @param address Port address
+ * @param baudRate Baud rate
+ */
+void 
+SerialDevice_SetCachedBaud(
+  const TCHAR   *address,
+  unsigned int  baudRate
+  );
+
 #ifdef __cplusplus
 }
 #endif
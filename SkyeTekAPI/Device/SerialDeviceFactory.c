@@ -21,6 +21,10 @@
 #endif
 #include <fcntl.h>
 #endif
+#ifdef LINUX
+#include <dirent.h>
+#include <limits.h>
+#endif
 
 #if defined(WIN32)
 SKYETEK_STATUS 
@@ -41,7 +45,7 @@ SerialDeviceFactory_CreateDevice(
 	if( h == INVALID_HANDLE_VALUE )
 		return SKYETEK_FAILURE;
 	CloseHandle(h);
-	*lpDevice = (LPSKYETEK_DEVICE)malloc(sizeof(SKYETEK_DEVICE));
+	*lpDevice = (LPSKYETEK_DEVICE)SkyeTek_Malloc(sizeof(SKYETEK_DEVICE));
 	memset((*lpDevice),0,sizeof(SKYETEK_DEVICE));
 
   _tcscpy((*lpDevice)->friendly,address);
@@ -64,7 +68,7 @@ SerialDeviceFactory_DiscoverDevices(
     return 0;
 
 	/* Allocate for 10 but might not use all */
-  *lpDevices = (LPSKYETEK_DEVICE*)malloc(10 * sizeof(LPSKYETEK_DEVICE));
+  *lpDevices = (LPSKYETEK_DEVICE*)SkyeTek_Malloc(10 * sizeof(LPSKYETEK_DEVICE));
 	memset(*lpDevices,0,(10*sizeof(LPSKYETEK_DEVICE)));
 
 	/* Scan for 10 serial ports */
@@ -95,7 +99,11 @@ SerialDeviceFactory_CreateDevice(
 	struct stat deviceStat;
 	unsigned int major;
 	int fd;
+	char *tty;
 
+	/* A cut-off address would name another file */
+	if(strlen(address) >= sizeof((*lpDevice)->address))
+		return SKYETEK_INVALID_PARAMETER;
 	if(stat(address, &deviceStat) == -1)
 		return SKYETEK_INVALID_PARAMETER;
 
@@ -109,10 +117,14 @@ SerialDeviceFactory_CreateDevice(
 		 * 153 is S3C2410 SPI
 		 * 204 is S3C2410 serial
 		 * 188 is USB to serial
+		 * 166 is USB CDC ACM
+		 * 136 is a pty slave, as socat and the benchmarks use
 		 */
 		case 4:
 		case 89:
+		case 136:
 		case 153:
+		case 166:
 		case 188:
 		case 204:
 #elif defined(__sun)
@@ -125,9 +137,12 @@ SerialDeviceFactory_CreateDevice(
 				return SKYETEK_FAILURE;
 
 			close(fd);
-			*lpDevice = (LPSKYETEK_DEVICE)malloc(sizeof(SKYETEK_DEVICE));
+			*lpDevice = (LPSKYETEK_DEVICE)SkyeTek_Malloc(sizeof(SKYETEK_DEVICE));
 			memset((*lpDevice),0,sizeof(SKYETEK_DEVICE));
-      			strcpy((*lpDevice)->friendly,address);
+			/* A /dev/serial/by-id link can outgrow friendly, the tty it points to cannot */
+			tty = strlen(address) < sizeof((*lpDevice)->friendly) ? NULL : realpath(address, NULL);
+			snprintf((*lpDevice)->friendly, sizeof((*lpDevice)->friendly), "%s", tty != NULL ? tty : address);
+			free(tty);
       			strcpy((*lpDevice)->address,address);
   			strcpy((*lpDevice)->type,SKYETEK_SERIAL_DEVICE_TYPE);
 			SerialDevice_InitDevice(*lpDevice);
@@ -137,16 +152,182 @@ SerialDeviceFactory_CreateDevice(
 	return SKYETEK_FAILURE;
 }
 
+#ifdef LINUX
+/* USB vendors of serial and RS-485 adapters worth probing */
+static const char *SerialAdapterVendors[] = {
+  "0403",   /* FTDI */
+  "067b",   /* Prolific */
+  "10c4",   /* Silicon Labs */
+  "1a86",   /* WCH */
+  "110a",   /* Moxa */
+  "04e2",   /* Exar */
+  NULL
+};
+
+/* Reads the first line of a sysfs attribute without its newline */
+static int 
+ReadSysfsValue(
+  const char  *path,
+  char        *value,
+  int         size
+  )
+{
+  FILE *fp;
+  char *end;
+
+  if( (fp = fopen(path, "r")) == NULL )
+    return 0;
+  if( fgets(value, size, fp) == NULL )
+  {
+    fclose(fp);
+    return 0;
+  }
+  fclose(fp);
+  if( (end = strchr(value, '\n')) != NULL )
+    *end = 0;
+  return 1;
+}
+
+/* True if the tty is backed by a USB serial adapter or a real UART */
+static int 
+IsSerialAdapter(
+  const char  *name
+  )
+{
+  char path[PATH_MAX], device[PATH_MAX], value[16];
+  char *slash;
+  int level, ix;
+
+  /* Virtual terminals and ptys have no device */
+  snprintf(path, sizeof(path), "/sys/class/tty/%s/device", name);
+  if( realpath(path, device) == NULL )
+    return 0;
+
+  /* The vendor sits on the USB device, an interface or two above the tty */
+  for( level = 0; level < 4; level++ )
+  {
+    if( snprintf(path, sizeof(path), "%s/idVendor", device) < (int)sizeof(path) &&
+        ReadSysfsValue(path, value, sizeof(value)) )
+    {
+      for( ix = 0; SerialAdapterVendors[ix] != NULL; ix++ )
+      {
+        if( strcmp(value, SerialAdapterVendors[ix]) == 0 )
+          return 1;
+      }
+      return 0;
+    }
+    if( (slash = strrchr(device, '/')) == NULL || slash == device )
+      break;
+    *slash = 0;
+  }
+
+  /* The 8250 driver registers ports without hardware as type 0 */
+  snprintf(path, sizeof(path), "/sys/class/tty/%s/type", name);
+  return ReadSysfsValue(path, value, sizeof(value)) && atoi(value) != 0;
+}
+
+/* Finds the /dev/serial/by-id link of a port, which survives reboots and re-plugging */
+static void 
+GetStableSerialName(
+  const char  *dev,
+  char        *name,
+  int         size
+  )
+{
+  char path[PATH_MAX], target[PATH_MAX];
+  struct dirent *entry;
+  DIR *dir;
+
+  /* Left empty if even the tty name does not fit */
+  if( snprintf(name, size, "%s", dev) >= size )
+    name[0] = 0;
+  if( (dir = opendir("/dev/serial/by-id")) == NULL )
+    return;
+  while( (entry = readdir(dir)) != NULL )
+  {
+    if( entry->d_name[0] == '.' )
+      continue;
+    snprintf(path, sizeof(path), "/dev/serial/by-id/%s", entry->d_name);
+    if( realpath(path, target) != NULL && strcmp(target, dev) == 0 )
+    {
+      /* A cut-off link would not open, so the tty name is kept then */
+      if( strlen(path) < (size_t)size )
+        strcpy(name, path);
+      break;
+    }
+  }
+  closedir(dir);
+}
+
+static int 
+CompareNames(
+  const void *a, 
+  const void *b
+  )
+{
+  return strcmp(*(const char **)a, *(const char **)b);
+}
+
+/*
+ * Adds every serial adapter listed in sysfs to lpDevices.
+ * Returns -1 if sysfs is not available.
+ */
+static int 
+DiscoverSysfsDevices(
+  LPSKYETEK_DEVICE  **lpDevices,
+  unsigned int      *deviceCount
+  )
+{
+  char dev[PATH_MAX], address[256];
+  char **names = NULL;
+  unsigned int count = 0, ix;
+  struct dirent *entry;
+  LPSKYETEK_DEVICE lpDevice;
+  DIR *dir;
+
+  if( (dir = opendir("/sys/class/tty")) == NULL )
+    return -1;
+  while( (entry = readdir(dir)) != NULL )
+  {
+    if( entry->d_name[0] == '.' || !IsSerialAdapter(entry->d_name) )
+      continue;
+    names = (char **)SkyeTek_Realloc(names, (count + 1) * sizeof(char *));
+    names[count] = (char *)SkyeTek_Malloc(strlen(entry->d_name) + 1);
+    strcpy(names[count], entry->d_name);
+    count++;
+  }
+  closedir(dir);
+
+  /* readdir order is arbitrary; keep ttyUSB0 before ttyUSB1 */
+  if( count > 1 )
+    qsort(names, count, sizeof(char *), CompareNames);
+  for( ix = 0; ix < count; ix++ )
+  {
+    snprintf(dev, sizeof(dev), "/dev/%s", names[ix]);
+    GetStableSerialName(dev, address, sizeof(address));
+    SkyeTek_Free(names[ix]);
+    if( SerialDeviceFactory_CreateDevice(address, &lpDevice) != SKYETEK_SUCCESS )
+      continue;
+    (*deviceCount)++;
+    *lpDevices = (LPSKYETEK_DEVICE*)SkyeTek_Realloc(*lpDevices, (*deviceCount * sizeof(LPSKYETEK_DEVICE)));
+    (*lpDevices)[(*deviceCount - 1)] = lpDevice;
+  }
+  SkyeTek_Free(names);
+  return (int)count;
+}
+#endif
+
 unsigned int
 SerialDeviceFactory_DiscoverDevices(
   LPSKYETEK_DEVICE  **lpDevices
   )
 {
 	struct stat devStat;
-	unsigned char buffer[64];
+	char buffer[64];
 	unsigned int ix, iy, deviceCount;
 #ifdef LINUX
-  char* devPrefixes[] = {"/dev/ttyS", "/dev/ttyUSB", "/dev/spi/", "/dev/i2c/", NULL};
+  char* devPrefixes[] = {"/dev/spi/", "/dev/i2c/", NULL};
+  char* ttyPrefixes[] = {"/dev/ttyS", "/dev/ttyUSB", NULL};
   char* devPaths[] = { NULL };
 #elif defined(__sun)
   char* devPrefixes[] = { NULL };
@@ -159,6 +340,27 @@ SerialDeviceFactory_DiscoverDevices(
 	
 	deviceCount = 0;
 
+#ifdef LINUX
+  /* Without sysfs, probe the first two ports of each kind */
+  if( DiscoverSysfsDevices(lpDevices, &deviceCount) < 0 )
+  {
+    for(iy = 0; ttyPrefixes[iy] != NULL; iy++)
+    {
+      for(ix = 0; ix < 2; ix++)
+      {
+        snprintf(buffer, 64, "%s%d", ttyPrefixes[iy], ix);
+        if(stat(buffer, &devStat) == -1)
+          continue;
+        if( SerialDeviceFactory_CreateDevice(buffer, &lpDevice) != SKYETEK_SUCCESS )
+          continue;
+        deviceCount++;
+        *lpDevices = (LPSKYETEK_DEVICE*)SkyeTek_Realloc(*lpDevices, (deviceCount * sizeof(LPSKYETEK_DEVICE)));
+        (*lpDevices)[(deviceCount - 1)] = lpDevice;
+      }
+    }
+  }
+#endif
+
   for(iy = 0; devPrefixes[iy] != NULL; iy++)
   {
     /* Do 2 ports per device type*/
@@ -173,7 +375,7 @@ SerialDeviceFactory_DiscoverDevices(
         continue;
 	
       deviceCount++;
-      *lpDevices = (LPSKYETEK_DEVICE*)realloc(*lpDevices, (deviceCount * sizeof(LPSKYETEK_DEVICE)));
+      *lpDevices = (LPSKYETEK_DEVICE*)SkyeTek_Realloc(*lpDevices, (deviceCount * sizeof(LPSKYETEK_DEVICE)));
       (*lpDevices)[(deviceCount - 1)] = lpDevice;
     }
   }
@@ -187,7 +389,7 @@ SerialDeviceFactory_DiscoverDevices(
       continue;
 		
     deviceCount++;
-    *lpDevices = (LPSKYETEK_DEVICE*)realloc(*lpDevices, (deviceCount * sizeof(LPSKYETEK_DEVICE)));
+    *lpDevices = (LPSKYETEK_DEVICE*)SkyeTek_Realloc(*lpDevices, (deviceCount * sizeof(LPSKYETEK_DEVICE)));
     (*lpDevices)[(deviceCount - 1)] = lpDevice;
   }
 
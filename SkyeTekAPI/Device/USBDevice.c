@@ -32,7 +32,6 @@ USBDevice_internalFlush(LPSKYETEK_DEVICE device, BOOL lockSendBuffer)
 	OVERLAPPED overlap;
 	#else
 	COMMTIMEOUTS ctos;
-	DEVICEIMPL* pImpl;
 	#endif
 	unsigned char sendBuffer[65];
 	LPUSB_DEVICE usbDevice;
@@ -41,7 +40,7 @@ USBDevice_internalFlush(LPSKYETEK_DEVICE device, BOOL lockSendBuffer)
 	if(device == NULL)
 		return;
 
-	usbDevice = (LPUSB_DEVICE)device->user;
+	usbDevice = (LPUSB_DEVICE)device->transport;
 
 	if(lockSendBuffer)
 		EnterCriticalSection(&usbDevice->sendBufferMutex);
@@ -70,9 +69,8 @@ USBDevice_internalFlush(LPSKYETEK_DEVICE device, BOOL lockSendBuffer)
 	if(!HasOverlappedIoCompleted(&overlap))
 		CancelIo(device->writeFD);
 #else
-	pImpl = (DEVICEIMPL*)device->internal;
 	ZeroMemory(&ctos,sizeof(COMMTIMEOUTS));
-	ctos.WriteTotalTimeoutConstant = pImpl->timeout;
+	ctos.WriteTotalTimeoutConstant = usbDevice->base.timeout;
 	SetCommTimeouts(device->writeFD, &ctos);
 	WriteFile(device->writeFD, sendBuffer, 65, &bytesWritten, NULL);
 #endif
@@ -159,16 +157,15 @@ USBDevice_internalFillReceiveBuffer(LPSKYETEK_DEVICE device, unsigned int timeou
 	OVERLAPPED overlap;
 	#else
 	COMMTIMEOUTS ctos;
-	DEVICEIMPL* pImpl;
 	#endif
 	int bytesRead;
 	unsigned char receiveBuffer[65];
 	LPUSB_DEVICE usbDevice;
 
-	if((device == NULL) || (device->user == NULL))
+	if((device == NULL) || (device->transport == NULL))
 		return 0;
 
-	usbDevice = (LPUSB_DEVICE)device->user;
+	usbDevice = (LPUSB_DEVICE)device->transport;
 
 	/* We emptied the buffer so reset all of our pointers */
 	usbDevice->receiveBufferReadPtr = usbDevice->receiveBufferWritePtr = usbDevice->receiveBuffer;
@@ -199,9 +196,8 @@ USBDevice_internalFillReceiveBuffer(LPSKYETEK_DEVICE device, unsigned int timeou
 		if(!GetOverlappedResult(device->readFD, &overlap, &bytesRead, 0))
 			return 0;
 	#else
-		pImpl = (DEVICEIMPL*)device->internal;
 		ZeroMemory(&ctos,sizeof(COMMTIMEOUTS));
-		ctos.ReadTotalTimeoutConstant = pImpl->timeout;
+		ctos.ReadTotalTimeoutConstant = usbDevice->base.timeout;
 		SetCommTimeouts(device->readFD, &ctos);
 		ReadFile(device->readFD, receiveBuffer, 65, &bytesRead, NULL);
 	#endif
@@ -217,6 +213,21 @@ USBDevice_internalFillReceiveBuffer(LPSKYETEK_DEVICE device, unsigned int timeou
 #endif
 
 #ifdef HAVE_LIBUSB
+/* libusb-0.1 keeps one bus list for the process, rebuilt by usb_find_devices */
+STATIC_MUTEX(g_busLock);
+
+void 
+USBDevice_LockBusses(void)
+{
+	STATIC_MUTEX_LOCK(&g_busLock);
+}
+
+void 
+USBDevice_UnlockBusses(void)
+{
+	STATIC_MUTEX_UNLOCK(&g_busLock);
+}
+
 void 
 USBDevice_internalFlush(LPSKYETEK_DEVICE device, unsigned char lockSendBuffer)
 {
@@ -224,10 +235,10 @@ USBDevice_internalFlush(LPSKYETEK_DEVICE device, unsigned char lockSendBuffer)
 	unsigned char sendBuffer[64];
 	int result;
 	
-	if((device == NULL) || (device->user == NULL))
+	if((device == NULL) || (device->transport == NULL))
 		return;
 	
-	usbDevice = (LPUSB_DEVICE)device->user;
+	usbDevice = (LPUSB_DEVICE)device->transport;
 
 #ifdef HAVE_PTHREAD
 	if(lockSendBuffer)
@@ -274,10 +285,10 @@ USBDevice_internalFillReceiveBuffer(LPSKYETEK_DEVICE device, unsigned int timeou
 	unsigned char flushBuffer[3];
 #endif
 
-	if((device == NULL) || (device->user == NULL))
+	if((device == NULL) || (device->transport == NULL))
 		return 0;
 
-	usbDevice = (LPUSB_DEVICE)device->user;
+	usbDevice = (LPUSB_DEVICE)device->transport;
 
 	/* We emptied the buffer so reset all of our pointers */
 	usbDevice->receiveBufferReadPtr = usbDevice->receiveBufferWritePtr = usbDevice->receiveBuffer;
@@ -328,10 +339,10 @@ USBDevice_Close(LPSKYETEK_DEVICE device)
 	unsigned char flushBuffer[8];
 	
 	
-	if((device == NULL) || (device->user == NULL))
+	if((device == NULL) || (device->transport == NULL))
 		return SKYETEK_INVALID_PARAMETER;
 
-	usbDevice = (LPUSB_DEVICE)device->user;
+	usbDevice = (LPUSB_DEVICE)device->transport;
 	
 	/*printf("packetParity = %d\r\n", usbDevice->packetParity);*/
 
@@ -359,8 +370,8 @@ USBDevice_Close(LPSKYETEK_DEVICE device)
 	return SKYETEK_SUCCESS;
 }
 
-SKYETEK_STATUS
-USBDevice_Open(LPSKYETEK_DEVICE device)
+static SKYETEK_STATUS
+USBDevice_OpenLocked(LPSKYETEK_DEVICE device)
 {
 	struct usb_bus *bus;
 	struct usb_device *dev;
@@ -371,13 +382,13 @@ USBDevice_Open(LPSKYETEK_DEVICE device)
 	char DriverName[32];
 
 	
-	if((device == NULL) || (device->user == NULL))
+	if((device == NULL) || (device->transport == NULL))
 		return SKYETEK_INVALID_PARAMETER;
 	
 	if( device->readFD != 0 && device->writeFD != 0 )
 	  return SKYETEK_SUCCESS;
 	
-	usbDevice = (LPUSB_DEVICE)device->user;
+	usbDevice = (LPUSB_DEVICE)device->transport;
 
 start:
 	usb_busses = usb_get_busses ();
@@ -484,6 +495,17 @@ done:
 	usbDevice->usbDevHandle = NULL;
 	return SKYETEK_READER_IO_ERROR;
 }
+
+SKYETEK_STATUS
+USBDevice_Open(LPSKYETEK_DEVICE device)
+{
+	SKYETEK_STATUS status;
+
+	USBDevice_LockBusses();
+	status = USBDevice_OpenLocked(device);
+	USBDevice_UnlockBusses();
+	return status;
+}
 #endif
 
 #if defined(LINUX) || defined(WIN32)
@@ -497,10 +519,10 @@ USBDevice_Write(LPSKYETEK_DEVICE device,
 	unsigned char writeSize;
 	LPUSB_DEVICE usbDevice;
 	
-	if((device == NULL) || (buffer == NULL) || (device->user == NULL) )
+	if((device == NULL) || (buffer == NULL) || (device->transport == NULL) )
 		return 0;
 
-	usbDevice = (LPUSB_DEVICE)device->user;
+	usbDevice = (LPUSB_DEVICE)device->transport;
 
 	ptr = buffer;
 
@@ -536,14 +558,11 @@ USBDevice_Read(LPSKYETEK_DEVICE device,
 	unsigned char readSize;
 	unsigned char* ptr;
 	LPUSB_DEVICE usbDevice;
-  LPDEVICEIMPL di;
 
-	if( (device == NULL) || (buffer == NULL) || (device->user == NULL) || (device->internal == NULL))
+	if( (device == NULL) || (buffer == NULL) || (device->transport == NULL) || (device->internal == NULL))
 		return 0;
 
-  di = (LPDEVICEIMPL)device->internal;
-
-	usbDevice = (LPUSB_DEVICE)device->user;
+	usbDevice = (LPUSB_DEVICE)device->transport;
 	
 	USBDevice_internalFlush(device, 0);
 	
@@ -567,7 +586,7 @@ USBDevice_Read(LPSKYETEK_DEVICE device,
 		if(length == 0)
 			goto end;
 		
-		if(!USBDevice_internalFillReceiveBuffer(device, timeout + di->timeout))
+		if(!USBDevice_internalFillReceiveBuffer(device, timeout + usbDevice->base.timeout))
 			goto end;
 	};
 
@@ -593,20 +612,20 @@ USBDevice_Free(LPSKYETEK_DEVICE device)
 	if(device == NULL)
 		return 0;
 
-	if(device->user == NULL)
+	if(device->transport == NULL)
 		return 0;
 
 	USBDevice_Close(device);
 
-	usbDevice = (LPUSB_DEVICE)device->user;
+	usbDevice = (LPUSB_DEVICE)device->transport;
 
 	MUTEX_DESTROY(&usbDevice->receiveBufferMutex);
 	MUTEX_DESTROY(&usbDevice->sendBufferMutex);
 
-	free(usbDevice);
-	device->user = NULL;
+	SkyeTek_Free(usbDevice);
+	device->transport = NULL;
 
-	free(device);
+	SkyeTek_Free(device);
 	return 1;
 }
 
@@ -616,11 +635,9 @@ USBDevice_SetAdditionalTimeout(
   unsigned int      timeout
   )
 {
-  LPDEVICEIMPL di;
-  if( lpDevice == NULL || lpDevice->internal == NULL )
+  if( lpDevice == NULL || lpDevice->transport == NULL )
     return SKYETEK_INVALID_PARAMETER;
-  di = (LPDEVICEIMPL)lpDevice->internal;
-  di->timeout = timeout;
+  ((LPDEVICE_TRANSPORT)lpDevice->transport)->timeout = timeout;
   return SKYETEK_SUCCESS;
 }
 
@@ -634,7 +651,7 @@ USBDevice_InitDevice(LPSKYETEK_DEVICE device)
 
 	device->internal = &USBDeviceImpl;
 	
-	usbDevice = (LPUSB_DEVICE)malloc(sizeof(USB_DEVICE));
+	usbDevice = (LPUSB_DEVICE)SkyeTek_Malloc(sizeof(USB_DEVICE));
 	memset(usbDevice, 0, sizeof(USB_DEVICE));
 
 	usbDevice->sendBufferWritePtr = usbDevice->sendBuffer;
@@ -652,7 +669,7 @@ USBDevice_InitDevice(LPSKYETEK_DEVICE device)
 	
 	usbDevice->packetParity = 0;
 	
-	device->user = (void*)usbDevice;
+	device->transport = (void*)usbDevice;
 }
 
 DEVICEIMPL USBDeviceImpl = {
@@ -662,7 +679,6 @@ DEVICEIMPL USBDeviceImpl = {
 	USBDevice_Write,
 	USBDevice_Flush,
 	USBDevice_Free,
-  USBDevice_SetAdditionalTimeout,
-  0
+  USBDevice_SetAdditionalTimeout
 };
 #endif
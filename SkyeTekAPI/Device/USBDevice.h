@@ -7,6 +7,7 @@
 #define USB_DEVICE_H
 
 #include "../SkyeTekAPI.h"
+#include "Device.h"
 
 #ifdef HAVE_PTHREAD
 #include <pthread.h>
@@ -16,8 +17,10 @@
 extern "C" {
 #endif
 
-/* This structure is used internally by the USBDevice driver */
+/* This structure is used internally by the USBDevice driver,
+   one per device in device->transport */
 typedef struct USB_DEVICE {
+	DEVICE_TRANSPORT base;
 	unsigned int packetParity;
 	unsigned char* sendBufferWritePtr;
 	unsigned int endOfSendBuffer;
@@ -51,6 +54,21 @@ USBDevice_Free(
   LPSKYETEK_DEVICE    device
   );
 
+#ifdef HAVE_LIBUSB
+/**
+ * Serializes use of the libusb bus list, which is shared by the process.
+ * Hold it while rescanning or walking usb_busses.
+ */
+void 
+USBDevice_LockBusses(void);
+
+/**
+ * Releases the lock taken by USBDevice_LockBusses.
+ */
+void 
+USBDevice_UnlockBusses(void);
+#endif
+
 
 #ifdef __cplusplus
 }
@@ -50,7 +50,7 @@ USBDeviceFactory_CreateDevice(
 	if(_tcsstr(address, _T("COM")) != NULL || _tcsstr(address, _T("SPI")) != NULL || _tcsstr(address, _T("I2C")) != NULL)
 		return SKYETEK_INVALID_PARAMETER;
 
-	*lpDevice = (LPSKYETEK_DEVICE)malloc(sizeof(SKYETEK_DEVICE));
+	*lpDevice = (LPSKYETEK_DEVICE)SkyeTek_Malloc(sizeof(SKYETEK_DEVICE));
 	memset((*lpDevice),0,sizeof(SKYETEK_DEVICE));
 	_tcscpy((*lpDevice)->address, address);
 	_tcscpy((*lpDevice)->type,SKYETEK_USB_DEVICE_TYPE);
@@ -103,7 +103,7 @@ USBDeviceFactory_DiscoverDevices(
 	if ( deviceInfo == INVALID_HANDLE_VALUE ) 
 		return 0; 
 
-	*lpDevices = (LPSKYETEK_DEVICE*)malloc(20 * sizeof(LPSKYETEK_DEVICE));
+	*lpDevices = (LPSKYETEK_DEVICE*)SkyeTek_Malloc(20 * sizeof(LPSKYETEK_DEVICE));
 	memset(*lpDevices,0,(20*sizeof(LPSKYETEK_DEVICE)));
 	size = sizeof(SP_INTERFACE_DEVICE_DETAIL_DATA); 
 	for ( ix = 0; ix < 20; ix++ ) 
@@ -119,7 +119,7 @@ USBDeviceFactory_DiscoverDevices(
         continue; 
     } 
     SetupDiGetInterfaceDeviceDetail( deviceInfo, &deviceData, 0, 0, &bytes, 0);       
-    deviceInterfaceData = (PSP_INTERFACE_DEVICE_DETAIL_DATA)malloc(bytes * sizeof(BYTE));
+    deviceInterfaceData = (PSP_INTERFACE_DEVICE_DETAIL_DATA)SkyeTek_Malloc(bytes * sizeof(BYTE));
     if ( !deviceInterfaceData ) { 
       SetupDiDestroyDeviceInfoList( deviceInfo ); 
       return deviceCount; 
@@ -128,7 +128,7 @@ USBDeviceFactory_DiscoverDevices(
     deviceInterfaceData->cbSize  = size;
     isSuccess = SetupDiGetInterfaceDeviceDetail( deviceInfo, &deviceData, deviceInterfaceData, bytes, &bytes, 0); 
     if ( !isSuccess ) { 
-      free(deviceInterfaceData);
+      SkyeTek_Free(deviceInterfaceData);
       SetupDiDestroyDeviceInfoList( deviceInfo ); 
       return deviceCount; 
     }
@@ -140,13 +140,13 @@ USBDeviceFactory_DiscoverDevices(
 			status = USBDeviceFactory_CreateDevice(deviceInterfaceData->DevicePath, &((*lpDevices)[deviceCount]));
 			if( status != SKYETEK_SUCCESS )
 			{
-				free(deviceInterfaceData);
+				SkyeTek_Free(deviceInterfaceData);
 				continue;
 			}
 			deviceCount++;
 		}
 
-		free(deviceInterfaceData);
+		SkyeTek_Free(deviceInterfaceData);
   }
 
 	return deviceCount;
@@ -169,6 +169,7 @@ USBDeviceFactory_DiscoverDevices(
 
 	deviceCount = 0;
 
+	USBDevice_LockBusses();
 	usb_init();
 	usb_find_busses();
 	usb_find_devices();
@@ -186,11 +187,12 @@ USBDeviceFactory_DiscoverDevices(
 				
 				/*printf("USB CreateDevice succeded\r\n");*/
 				deviceCount++;
-				*lpDevices = (LPSKYETEK_DEVICE*)realloc(*lpDevices, (deviceCount * sizeof(LPSKYETEK_DEVICE)));
-				*lpDevices[(deviceCount - 1)] = lpDevice;
+				*lpDevices = (LPSKYETEK_DEVICE*)SkyeTek_Realloc(*lpDevices, (deviceCount * sizeof(LPSKYETEK_DEVICE)));
+				(*lpDevices)[(deviceCount - 1)] = lpDevice;
 			}
 		}
 	}
+	USBDevice_UnlockBusses();
 
 	return deviceCount;
 }
@@ -215,7 +217,7 @@ USBDeviceFactory_DiscoverDevices(
 	pDevInfo = NULL;
 	hSearch = INVALID_HANDLE_VALUE;
 
-	pDevInfo = (PDEVMGR_DEVICE_INFORMATION)malloc(sizeof(DEVMGR_DEVICE_INFORMATION));
+	pDevInfo = (PDEVMGR_DEVICE_INFORMATION)SkyeTek_Malloc(sizeof(DEVMGR_DEVICE_INFORMATION));
 	memset(pDevInfo, 0, sizeof(DEVMGR_DEVICE_INFORMATION));
 	pDevInfo->dwSize = sizeof(DEVMGR_DEVICE_INFORMATION);
 	hSearch = FindFirstDevice(DeviceSearchByDeviceName, L"SKY*", pDevInfo);
@@ -241,7 +243,7 @@ done:
 		FindClose(hSearch);
 	
 	if(pDevInfo)
-		free(pDevInfo);
+		SkyeTek_Free(pDevInfo);
 
 	return deviceCount;
 }
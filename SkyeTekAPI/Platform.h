@@ -29,6 +29,9 @@
 
 #include <unistd.h>
 #include <stdint.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 #define SKYETEK_DEVICE_FILE int
 #define SKYETEK_API
@@ -69,6 +72,37 @@
 	#define MUTEX_UNLOCK(m)
 #endif
 
+/* Mutexes for file-scope state, ready without a create call */
+#if defined(WIN32) && !defined(WINCE)
+	#define STATIC_MUTEX(m) static SRWLOCK m = SRWLOCK_INIT
+	#define STATIC_MUTEX_LOCK(m) AcquireSRWLockExclusive(m)
+	#define STATIC_MUTEX_UNLOCK(m) ReleaseSRWLockExclusive(m)
+#elif defined(HAVE_PTHREAD)
+	#define STATIC_MUTEX(m) static pthread_mutex_t m = PTHREAD_MUTEX_INITIALIZER
+	#define STATIC_MUTEX_LOCK(m) pthread_mutex_lock(m)
+	#define STATIC_MUTEX_UNLOCK(m) pthread_mutex_unlock(m)
+#else
+	#define STATIC_MUTEX(m) static int m
+	#define STATIC_MUTEX_LOCK(m)
+	#define STATIC_MUTEX_UNLOCK(m)
+#endif
+
+#if defined(WIN32) || defined(WINCE)
+	#define THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+	#define THREAD_LOCAL __thread
+#else
+	#define THREAD_LOCAL
+#endif
+
+#if defined(WIN32) || defined(WINCE)
+	#define ATOMIC_ADD(p,v) InterlockedExchangeAdd((p),(v))
+#elif defined(__GNUC__)
+	#define ATOMIC_ADD(p,v) __sync_fetch_and_add((p),(v))
+#else
+	#define ATOMIC_ADD(p,v) (*(p) += (v))
+#endif
+
 #if defined(WIN32) || defined(WINCE)
 typedef unsigned char  UINT8; 
 typedef unsigned short UINT16; 
@@ -132,7 +166,9 @@ extern "C" {
 #ifndef WIN32
 #include <string.h>
 
+#ifndef __cplusplus
 #define max(a,b) (a > b) ? a : b
+#endif
 #define _T(s) s
 
 #define _tcscpy strcpy
@@ -145,7 +181,8 @@ extern "C" {
 #define _ttoi atoi
 #define _tfopen fopen
 #define _tcstoul strtoul
-#define _vsntprintf snprintf
+#define _vsntprintf vsnprintf
+#define _sntprintf snprintf
 #define _tcsncpy strncpy
 
 typedef char TCHAR;
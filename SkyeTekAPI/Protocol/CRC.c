@@ -5,6 +5,7 @@
  * CRC funtions.
  */
 #include "CRC.h"
+#include "../SkyeTekAPI.h"
 #include <stdlib.h>
 
 #pragma warning(disable:4761)       // disable "integral size mismatch in argument" warning
@@ -117,14 +118,14 @@ unsigned short crca16(unsigned short preset, unsigned char *dataP, unsigned shor
 	
 	iy = 0;
 	checkLen = n/2;
-	check = (unsigned char *)malloc(checkLen *sizeof(unsigned char));
+	check = (unsigned char *)SkyeTek_Malloc(checkLen *sizeof(unsigned char));
 	for( ix = 0; ix < checkLen; ix++ )
 	{
 		check[ix] = crcGetHexFromASCII(&dataP[iy],2);
 		iy += 2;
 	}
 	ret = crc16(preset,check,checkLen);
-	free(check);
+	SkyeTek_Free(check);
 	return ret;
 }
 
@@ -175,7 +176,7 @@ unsigned char verifyacrc(unsigned char *resp, unsigned short len, unsigned char
 	
 	iy = 0;
 	checkLen = len/2;
-	check = (unsigned char *)malloc(checkLen *sizeof(unsigned char));
+	check = (unsigned char *)SkyeTek_Malloc(checkLen *sizeof(unsigned char));
 	for( ix = 0; ix < checkLen; ix++ )
 	{
 		check[ix] = crcGetHexFromASCII(&resp[iy],2);
@@ -202,6 +203,6 @@ unsigned char verifyacrc(unsigned char *resp, unsigned short len, unsigned char
 		else
 			ret = 0;
 	}
-	free(check);
+	SkyeTek_Free(check);
 	return ret;
 }
@@ -0,0 +1,108 @@
+/**
+ * DuplicateFilter.c
+ * Copyright  2006 - 2008 Skyetek, Inc. All Rights Reserved.
+ *
+ * Open-addressing table of recently reported tags. Each entry
+ * remembers when the tag was last reported; reads of the same
+ * tag within the hold-off are dropped before any tag object is
+ * built.
+ */
+#include "DuplicateFilter.h"
+#include "utils.h"
+#include <string.h>
+
+static UINT32
+DuplicateFilter_Hash(
+  SKYETEK_TAGTYPE type,
+  unsigned char   *id,
+  unsigned int    length
+  )
+{
+  /* FNV-1a */
+  UINT32 h = 2166136261u;
+  unsigned int ix;
+  h = (h ^ (UINT8)(type & 0xFF)) * 16777619u;
+  h = (h ^ (UINT8)((type >> 8) & 0xFF)) * 16777619u;
+  for( ix = 0; ix < length; ix++ )
+    h = (h ^ id[ix]) * 16777619u;
+  return h;
+}
+
+LPDUPLICATE_FILTER
+DuplicateFilter_Create(
+  unsigned int holdOff
+  )
+{
+  LPDUPLICATE_FILTER lpFilter;
+  lpFilter = (LPDUPLICATE_FILTER)SkyeTek_Malloc(sizeof(DUPLICATE_FILTER));
+  if( lpFilter == NULL )
+    return NULL;
+  memset(lpFilter, 0, sizeof(DUPLICATE_FILTER));
+  lpFilter->holdOff = holdOff;
+  return lpFilter;
+}
+
+void
+DuplicateFilter_Free(
+  LPDUPLICATE_FILTER lpFilter
+  )
+{
+  SkyeTek_Free(lpFilter);
+}
+
+int
+DuplicateFilter_Check(
+  LPDUPLICATE_FILTER lpFilter,
+  SKYETEK_TAGTYPE    type,
+  unsigned char      *id,
+  unsigned int       length
+  )
+{
+  LPDUPLICATE_ENTRY e, victim = NULL;
+  UINT32 hash, now, age, victimAge = 0;
+  unsigned int ix, slot;
+
+  if( lpFilter == NULL || id == NULL || length > DUPLICATE_FILTER_MAX_ID )
+    return 1;
+
+  now = st_get_ticks();
+  hash = DuplicateFilter_Hash(type, id, length);
+  slot = hash & (DUPLICATE_FILTER_SIZE - 1);
+
+  for( ix = 0; ix < DUPLICATE_FILTER_PROBES; ix++ )
+  {
+    e = &lpFilter->entries[(slot + ix) & (DUPLICATE_FILTER_SIZE - 1)];
+    if( !e->used )
+    {
+      victim = e;
+      break;
+    }
+    age = now - e->reported;
+    if( e->hash == hash && e->type == (UINT16)type && e->idLength == length &&
+        memcmp(e->id, id, length) == 0 )
+    {
+      if( age < lpFilter->holdOff )
+      {
+        lpFilter->suppressed++;
+        return 0;
+      }
+      victim = e;
+      break;
+    }
+    /* Evict the entry reported longest ago if the probe run is full */
+    if( victim == NULL || age > victimAge )
+    {
+      victim = e;
+      victimAge = age;
+    }
+  }
+
+  victim->hash = hash;
+  victim->reported = now;
+  victim->type = (UINT16)type;
+  victim->idLength = (UINT8)length;
+  victim->used = 1;
+  memcpy(victim->id, id, length);
+  lpFilter->reported++;
+  return 1;
+}
@@ -0,0 +1,81 @@
+/**
+ * DuplicateFilter.h
+ * Copyright  2006 - 2008 Skyetek, Inc. All Rights Reserved.
+ *
+ * Fixed-size duplicate read suppression for select loops.
+ */
+#ifndef STAPI_DUPLICATE_FILTER_H
+#define STAPI_DUPLICATE_FILTER_H
+
+#include "../SkyeTekAPI.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Table size, must be a power of two */
+#define DUPLICATE_FILTER_SIZE       256
+/* Slots examined per lookup before evicting the oldest */
+#define DUPLICATE_FILTER_PROBES     8
+/* Longer IDs are never suppressed */
+#define DUPLICATE_FILTER_MAX_ID     32
+
+typedef struct DUPLICATE_ENTRY
+{
+  UINT32          hash;
+  UINT32          reported;
+  UINT16          type;
+  UINT8           idLength;
+  UINT8           used;
+  UINT8           id[DUPLICATE_FILTER_MAX_ID];
+} DUPLICATE_ENTRY, *LPDUPLICATE_ENTRY;
+
+typedef struct DUPLICATE_FILTER
+{
+  unsigned int      holdOff;
+  unsigned long     reported;
+  unsigned long     suppressed;
+  DUPLICATE_ENTRY   entries[DUPLICATE_FILTER_SIZE];
+} DUPLICATE_FILTER, *LPDUPLICATE_FILTER;
+
+/**
+ * Allocates an empty filter.
+ * @param holdOff Milliseconds a reported tag stays suppressed
+ * @return Filter or NULL if out of memory
+ */
+LPDUPLICATE_FILTER
+DuplicateFilter_Create(
+  unsigned int holdOff
+  );
+
+/**
+ * Frees a filter.
+ * @param lpFilter Filter to free, may be NULL
+ */
+void
+DuplicateFilter_Free(
+  LPDUPLICATE_FILTER lpFilter
+  );
+
+/**
+ * Checks a read against the filter and records it if it is reported.
+ * Does not allocate.
+ * @param lpFilter Filter to check
+ * @param type Tag type of the read
+ * @param id ID bytes of the read
+ * @param length Number of ID bytes
+ * @return 1 if the read should be reported, 0 if it is a repeat
+ */
+int
+DuplicateFilter_Check(
+  LPDUPLICATE_FILTER lpFilter,
+  SKYETEK_TAGTYPE    type,
+  unsigned char      *id,
+  unsigned int       length
+  );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,40 @@
+/**
+ * Lookup.c
+ * Copyright  2006 - 2008 Skyetek, Inc. All Rights Reserved.
+ *
+ * Name searches of the generated lookup indexes.
+ */
+#include "Lookup.h"
+
+int 
+Lookup_FindName(
+  const void            *table,
+  size_t                size,
+  size_t                offset,
+  const unsigned char   *byName,
+  unsigned int          count,
+  const TCHAR           *name
+  )
+{
+  unsigned int lo, hi, mid;
+  TCHAR *entry;
+  int cmp;
+
+  if( table == NULL || byName == NULL || name == NULL )
+    return -1;
+  lo = 0;
+  hi = count;
+  while( lo < hi )
+  {
+    mid = lo + (hi - lo) / 2;
+    entry = *(TCHAR **)((const char *)table + byName[mid] * size + offset);
+    cmp = _tcscmp(entry, name);
+    if( cmp == 0 )
+      return byName[mid];
+    if( cmp < 0 )
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return -1;
+}
@@ -0,0 +1,59 @@
+/**
+ * Lookup.h
+ * Copyright  2006 - 2008 Skyetek, Inc. All Rights Reserved.
+ *
+ * Constant time lookups into the tag type and STPv3 code tables. The
+ * indexes are generated from those tables at build time by
+ * Tools/GenLookups.c into TagLookups.h and STPV3Lookups.h.
+ */
+#ifndef STAPI_LOOKUP_H
+#define STAPI_LOOKUP_H
+
+#include "../SkyeTekAPI.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Slots in a page, one per value of the low byte of a code */
+#define LOOKUP_PAGE_SIZE  256
+
+/**
+ * Finds a 16-bit code in a generated code index. pages maps the high byte
+ * of the code to a page of slots, page 0 being empty; each slot holds the
+ * table index of the code plus one.
+ * @return Table index plus one, or 0 if the code is not in the table
+ */
+#define LOOKUP_CODE(pages, slots, code) \
+  ( ((code) & ~0xFFFFu) ? 0 : (slots)[(pages)[((code) >> 8) & 0xFF]][(code) & 0xFF] )
+
+/**
+ * Finds a name by binary search of a generated name index.
+ * @param table First entry of the table
+ * @param size Size of an entry
+ * @param offset Offset of the name pointer within an entry
+ * @param byName Table indexes in ascending name order
+ * @param count Number of indexes
+ * @param name Name to find
+ * @return Table index, or -1 if the name is not in the table
+ */
+int 
+Lookup_FindName(
+  const void            *table,
+  size_t                size,
+  size_t                offset,
+  const unsigned char   *byName,
+  unsigned int          count,
+  const TCHAR           *name
+  );
+
+#define LOOKUP_NAME(table, type, field, byName, name) \
+  Lookup_FindName((table), sizeof(type), offsetof(type, field), (byName), \
+                  sizeof(byName)/sizeof((byName)[0]), (name))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
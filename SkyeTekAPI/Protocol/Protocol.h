@@ -69,6 +69,14 @@ typedef struct PROTOCOLIMPL
     unsigned int       timeout
     );
 
+  SKYETEK_STATUS 
+  (*GetTagsInto)(
+    LPSKYETEK_READER       lpReader, 
+    SKYETEK_TAGTYPE        tagType, 
+    LPSKYETEK_TAG_BUFFER   lpBuffer,
+    unsigned int           timeout
+    );
+
   SKYETEK_STATUS 
   (*GetTagsWithMask)(
     LPSKYETEK_READER   lpReader, 
@@ -0,0 +1,136 @@
+/**
+ * ResponseTimer.c
+ * Copyright \xa9 2006 - 2008 Skyetek, Inc. All Rights Reserved.
+ *
+ * Smoothed round trip time and deviation per command, kept in fixed
+ * point as in TCP (RFC 6298): the timeout is the smoothed round trip
+ * plus four deviations, held between a floor and a ceiling and
+ * doubled after each timeout until the next answer.
+ */
+#include "ResponseTimer.h"
+#include <string.h>
+
+LPRESPONSE_TIMER
+ResponseTimer_Create(void)
+{
+  LPRESPONSE_TIMER lpTimer;
+  lpTimer = (LPRESPONSE_TIMER)SkyeTek_Malloc(sizeof(RESPONSE_TIMER));
+  if( lpTimer == NULL )
+    return NULL;
+  memset(lpTimer, 0, sizeof(RESPONSE_TIMER));
+  lpTimer->floor = RESPONSE_TIMER_FLOOR;
+  lpTimer->ceiling = RESPONSE_TIMER_CEILING;
+  return lpTimer;
+}
+
+void
+ResponseTimer_Free(
+  LPRESPONSE_TIMER lpTimer
+  )
+{
+  SkyeTek_Free(lpTimer);
+}
+
+/* Finds the entry of a key, or claims a free one if create is set */
+static LPRESPONSE_TIME
+ResponseTimer_Find(
+  LPRESPONSE_TIMER  lpTimer,
+  UINT32            key,
+  int               create
+  )
+{
+  unsigned int ix, slot;
+  slot = (key ^ (key >> 7) ^ (key >> 16)) & (RESPONSE_TIMER_SLOTS - 1);
+  for( ix = 0; ix < RESPONSE_TIMER_SLOTS; ix++ )
+  {
+    LPRESPONSE_TIME lpTime = &lpTimer->entries[(slot + ix) & (RESPONSE_TIMER_SLOTS - 1)];
+    if( lpTime->used && lpTime->key == key )
+      return lpTime;
+    if( !lpTime->used )
+    {
+      if( !create )
+        return NULL;
+      lpTime->used = 1;
+      lpTime->key = key;
+      return lpTime;
+    }
+  }
+  return NULL;
+}
+
+unsigned int
+ResponseTimer_Timeout(
+  LPRESPONSE_TIMER  lpTimer,
+  UINT32            key,
+  unsigned int      units,
+  unsigned int      timeout
+  )
+{
+  LPRESPONSE_TIME lpTime;
+  UINT32 rto, var;
+
+  if( lpTimer == NULL || lpTimer->ceiling == 0 )
+    return timeout;
+  lpTime = ResponseTimer_Find(lpTimer, key, 0);
+  if( lpTime == NULL || lpTime->samples == 0 )
+    return timeout;
+  if( units == 0 )
+    units = 1;
+  var = lpTime->rttvar;
+  if( var < RESPONSE_TIMER_GRANULARITY )
+    var = RESPONSE_TIMER_GRANULARITY;
+  rto = ((lpTime->srtt >> 3) + var) * units;
+  if( rto < lpTimer->floor )
+    rto = lpTimer->floor;
+  rto <<= lpTime->backoff;
+  if( rto > lpTimer->ceiling )
+    rto = lpTimer->ceiling;
+  return rto;
+}
+
+void
+ResponseTimer_Sample(
+  LPRESPONSE_TIMER  lpTimer,
+  UINT32            key,
+  unsigned int      units,
+  UINT32            rtt
+  )
+{
+  LPRESPONSE_TIME lpTime;
+  UINT32 err;
+
+  if( lpTimer == NULL || (lpTime = ResponseTimer_Find(lpTimer, key, 1)) == NULL )
+    return;
+  if( units == 0 )
+    units = 1;
+  rtt = (rtt + units - 1) / units;
+  if( lpTime->samples == 0 )
+  {
+    lpTime->srtt = rtt << 3;
+    lpTime->rttvar = rtt << 1;
+  }
+  else
+  {
+    /* rttvar += (|srtt - rtt| - rttvar) / 4, srtt += (rtt - srtt) / 8 */
+    err = (lpTime->srtt >> 3) > rtt ? (lpTime->srtt >> 3) - rtt : rtt - (lpTime->srtt >> 3);
+    lpTime->rttvar = lpTime->rttvar - (lpTime->rttvar >> 2) + err;
+    lpTime->srtt = lpTime->srtt - (lpTime->srtt >> 3) + rtt;
+  }
+  lpTime->samples++;
+  lpTime->backoff = 0;
+}
+
+void
+ResponseTimer_Backoff(
+  LPRESPONSE_TIMER  lpTimer,
+  UINT32            key
+  )
+{
+  LPRESPONSE_TIME lpTime;
+  if( lpTimer == NULL )
+    return;
+  lpTimer->timeouts++;
+  lpTime = ResponseTimer_Find(lpTimer, key, 0);
+  if( lpTime != NULL && lpTime->backoff < RESPONSE_TIMER_MAX_BACKOFF )
+    lpTime->backoff++;
+}
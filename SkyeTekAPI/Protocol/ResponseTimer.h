@@ -0,0 +1,107 @@
+/**
+ * ResponseTimer.h
+ * Copyright  2006 - 2008 Skyetek, Inc. All Rights Reserved.
+ *
+ * Per-reader response time estimates that set read timeouts.
+ */
+#ifndef STAPI_RESPONSE_TIMER_H
+#define STAPI_RESPONSE_TIMER_H
+
+#include "../SkyeTekAPI.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Commands tracked per reader, must be a power of two */
+#define RESPONSE_TIMER_SLOTS        32
+/* Default bounds of an estimated timeout in milliseconds */
+#define RESPONSE_TIMER_FLOOR        100
+#define RESPONSE_TIMER_CEILING      10000
+/* Smallest variance term, covers the polling granularity of the devices */
+#define RESPONSE_TIMER_GRANULARITY  10
+/* Most doublings of a timeout after consecutive timeouts */
+#define RESPONSE_TIMER_MAX_BACKOFF  4
+
+typedef struct RESPONSE_TIME
+{
+  UINT32          key;          /* command and mode flags */
+  UINT32          samples;
+  UINT32          srtt;         /* smoothed round trip per unit, ms * 8 */
+  UINT32          rttvar;       /* mean deviation per unit, ms * 4 */
+  UINT8           used;
+  UINT8           backoff;
+} RESPONSE_TIME, *LPRESPONSE_TIME;
+
+typedef struct RESPONSE_TIMER
+{
+  unsigned int    floor;
+  unsigned int    ceiling;
+  unsigned long   timeouts;     /* first answers that never came */
+  RESPONSE_TIME   entries[RESPONSE_TIMER_SLOTS];
+} RESPONSE_TIMER, *LPRESPONSE_TIMER;
+
+/**
+ * Allocates a timer without estimates and with the default bounds.
+ * @return Timer or NULL if out of memory
+ */
+LPRESPONSE_TIMER
+ResponseTimer_Create(void);
+
+/**
+ * Frees a timer.
+ * @param lpTimer Timer to free, may be NULL
+ */
+void
+ResponseTimer_Free(
+  LPRESPONSE_TIMER lpTimer
+  );
+
+/**
+ * Gets the timeout for the first answer to a request. Until the
+ * command has been timed, the caller's fixed timeout is used.
+ * @param lpTimer Timer of the reader
+ * @param key Command and mode flags of the request
+ * @param units Size of the request, e.g. blocks; estimates are per unit
+ * @param timeout Fixed timeout of the caller
+ * @return Timeout in milliseconds
+ */
+unsigned int
+ResponseTimer_Timeout(
+  LPRESPONSE_TIMER  lpTimer,
+  UINT32            key,
+  unsigned int      units,
+  unsigned int      timeout
+  );
+
+/**
+ * Records the round trip of an answered request.
+ * @param lpTimer Timer of the reader
+ * @param key Command and mode flags of the request
+ * @param units Size of the request
+ * @param rtt Milliseconds from the end of the request to its answer
+ */
+void
+ResponseTimer_Sample(
+  LPRESPONSE_TIMER  lpTimer,
+  UINT32            key,
+  unsigned int      units,
+  UINT32            rtt
+  );
+
+/**
+ * Doubles the next timeout of a command whose answer never came.
+ * @param lpTimer Timer of the reader
+ * @param key Command and mode flags of the request
+ */
+void
+ResponseTimer_Backoff(
+  LPRESPONSE_TIMER  lpTimer,
+  UINT32            key
+  );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -19,7 +19,9 @@
 #include "../Tag/TagFactory.h"
 #include "Protocol.h"
 #include "CRC.h"
+#include "DuplicateFilter.h"
 #include "STPv2.h"
+#include "utils.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -250,7 +252,7 @@ SKYETEK_STATUS STPV2_ReadResponseImpl(
   if( pd == NULL )
     return SKYETEK_INVALID_PARAMETER;
 
-	SkyeTek_Debug("timeout is: %d ms\r\n", (timeout+pd->timeout));
+	SkyeTek_Debug("timeout is: %d ms\r\n", (timeout+DEVICE_TIMEOUT(device)));
 
   if( req->isASCII )
 	{
@@ -1212,7 +1214,8 @@ STPV2_SelectTags(
 	STPV2_REQUEST req;
 	STPV2_RESPONSE resp;
 	SKYETEK_STATUS status;
-  LPSKYETEK_DATA lpd;
+  SKYETEK_DATA data;
+  uint32 lastCall;
   LPREADER_IMPL lpri;
 	int ix = 0, iy = 0;
 
@@ -1239,6 +1242,7 @@ STPV2_SelectTags(
 	if( status != SKYETEK_SUCCESS )
 		return status;
 	SKYETEK_Sleep(100);
+  lastCall = st_get_ticks();
 
 readResponse:
 	/* Read response */
@@ -1246,6 +1250,7 @@ readResponse:
 	status = STPV2_ReadResponse(lpReader->lpDevice, &req, &resp, timeout);
   if( status == SKYETEK_TIMEOUT )
   {
+    lastCall = st_get_ticks();
     if(!callback(tagType, NULL, user))
     {
       STPV2_StopSelectLoop(lpReader,timeout);
@@ -1270,17 +1275,40 @@ readResponse:
     else
       tagType = (SKYETEK_TAGTYPE)req.tagType;
 
-    lpd = SkyeTek_AllocateData(resp.dataLength);
-    SkyeTek_CopyBuffer(lpd,resp.data,resp.dataLength);
+    /* Drop filtered reads and repeats before anything is allocated. A
+       dropped tag that stays in the field keeps the read from timing
+       out, so the callback is still given an empty read every timeout
+       to let the caller stop the loop */
+    if( (lpReader->tagFilter != NULL &&
+         !lpReader->tagFilter(tagType, resp.data, resp.dataLength, lpReader->tagFilterUser)) ||
+        !DuplicateFilter_Check((LPDUPLICATE_FILTER)lpReader->lpDuplicateFilter,
+          tagType, resp.data, resp.dataLength) )
+    {
+      if(!flags.isInventory && !flags.isLoop)
+        return SKYETEK_SUCCESS;
+      if( st_get_ticks() - lastCall >= timeout )
+      {
+        lastCall = st_get_ticks();
+        if(!callback(tagType, NULL, user))
+        {
+          STPV2_StopSelectLoop(lpReader,timeout);
+          return SKYETEK_SUCCESS;
+        }
+      }
+      goto readResponse;
+    }
+
+    /* Callbacks copy what they keep, so the read is lent to them */
+    data.data = resp.data;
+    data.size = resp.dataLength;
   
 		/* Call the callback */
-		if(!callback(tagType, lpd, user))
+    lastCall = st_get_ticks();
+		if(!callback(tagType, &data, user))
 		{
-      SkyeTek_FreeData(lpd);
 			STPV2_StopSelectLoop(lpReader,timeout);
       return SKYETEK_SUCCESS;
 		}
-    SkyeTek_FreeData(lpd);
 
 		/* Check for bail */
 		if(!flags.isInventory && !flags.isLoop)
@@ -1346,15 +1374,15 @@ readResponse:
 		/* Allocate memory */
 		if( !(num % step) )
     {
-			*tagTypes = (LPTAGTYPE_ARRAY*)realloc(*tagTypes, (num + step) * sizeof(LPTAGTYPE_ARRAY));
-			*lpData = (LPSKYETEK_DATA*)realloc(*lpData, (num + step) * sizeof(LPSKYETEK_DATA));
+			*tagTypes = (LPTAGTYPE_ARRAY*)SkyeTek_Realloc(*tagTypes, (num + step) * sizeof(LPTAGTYPE_ARRAY));
+			*lpData = (LPSKYETEK_DATA*)SkyeTek_Realloc(*lpData, (num + step) * sizeof(LPSKYETEK_DATA));
     }
 		if( *tagTypes == NULL || lpData == NULL )
 		{
 			status = SKYETEK_OUT_OF_MEMORY;
 			goto failure;
 		}
-    (*tagTypes)[num] = (LPTAGTYPE_ARRAY)malloc(sizeof(TAGTYPE_ARRAY));
+    (*tagTypes)[num] = (LPTAGTYPE_ARRAY)SkyeTek_Malloc(sizeof(TAGTYPE_ARRAY));
     if( resp.tagType != 0 )
       (*tagTypes)[num]->type = (SKYETEK_TAGTYPE)resp.tagType;
     else
@@ -1374,12 +1402,12 @@ readResponse:
  
 failure:
   if( *tagTypes != NULL )
-    free(*tagTypes);
+    SkyeTek_Free(*tagTypes);
   if( *lpData != NULL )
   {
     for( ix = 0; ix < num; ix++ )
       SkyeTek_FreeData((*lpData)[ix]);
-    free(*lpData);
+    SkyeTek_Free(*lpData);
   }
 	*count = 0;
 	return status;
@@ -1390,6 +1418,69 @@ success:
 }
 
 
+SKYETEK_STATUS 
+STPV2_GetTagsInto(
+  LPSKYETEK_READER       lpReader, 
+  SKYETEK_TAGTYPE        tagType, 
+  LPSKYETEK_TAG_BUFFER   lpBuffer,
+  unsigned int           timeout
+  )
+{
+	STPV2_REQUEST req;
+	STPV2_RESPONSE resp;
+	SKYETEK_STATUS status;
+  LPREADER_IMPL lpri;
+  SKYETEK_TAGTYPE type;
+
+  if(lpReader == NULL || lpBuffer == NULL )
+    return SKYETEK_INVALID_PARAMETER;
+  if( lpReader->lpDevice == NULL || lpReader->internal == NULL)
+    return SKYETEK_INVALID_PARAMETER;
+
+  lpBuffer->count = 0;
+  lpBuffer->idBytes = 0;
+  lpBuffer->dropped = 0;
+
+	/* Build request */
+	memset(&req,0,sizeof(STPV2_REQUEST));
+	req.cmd = STPV2_CMD_SELECT_TAG;
+	req.flags = STPV2_CRC | STPV2_INV;
+	req.tagType = tagType;
+  lpri = (LPREADER_IMPL)lpReader->internal;
+  if( lpReader->sendRID || !lpri->DoesRIDMatch(lpReader,genericV2ID) )
+  {
+    lpri->CopyRIDToBuffer(lpReader,&req.rid);
+    req.flags |= STPV2_RID;
+  }
+
+	/* Send request */
+	status = STPV2_WriteRequest(lpReader->lpDevice, &req, timeout);
+	if( status != SKYETEK_SUCCESS )
+		return status;
+	SKYETEK_Sleep(100);
+  
+readResponse:
+	/* Read response */
+	memset(&resp,0,sizeof(STPV2_RESPONSE));
+	status = STPV2_ReadResponse(lpReader->lpDevice, &req, &resp, timeout);
+	if( status != SKYETEK_SUCCESS )
+		return SKYETEK_SUCCESS; /* done reading */
+
+	if( resp.code == STPV2_RESP_SELECT_TAG_PASS )
+	{
+    if( resp.tagType != 0 )
+      type = (SKYETEK_TAGTYPE)resp.tagType;
+    else
+      type = (SKYETEK_TAGTYPE)req.tagType;
+    SkyeTek_AppendTagBuffer(lpBuffer,type,resp.data,resp.dataLength);
+
+		/* Keep reading */
+		goto readResponse;
+	}
+  return SKYETEK_SUCCESS;
+}
+
+
 SKYETEK_STATUS 
 STPV2_GetTagsWithMask(
   LPSKYETEK_READER   lpReader, 
@@ -2344,6 +2435,7 @@ PROTOCOLIMPL STPV2Impl = {
   2,
   STPV2_SelectTags,
   STPV2_GetTags,
+  STPV2_GetTagsInto,
   STPV2_GetTagsWithMask,
   STPV2_StoreKey,
   STPV2_LoadKey,
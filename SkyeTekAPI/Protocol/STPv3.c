@@ -9,10 +9,16 @@
 #include "../SkyeTekProtocol.h"
 #include "../Device/Device.h"
 #include "../Reader/Reader.h"
+#include "../Reader/Bus.h"
 #include "../Tag/TagFactory.h"
 #include "Protocol.h"
 #include "CRC.h"
+#include "DuplicateFilter.h"
+#include "ResponseTimer.h"
+#include "utils.h"
 #include "STPv3.h"
+#include "Lookup.h"
+#include "STPV3Lookups.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -26,13 +32,19 @@
 unsigned char genericID[] = { 0xFF, 0xFF, 0xFF, 0xFF };
 
 void SkyeTek_Debug( TCHAR * sz, ... );
+unsigned char SkyeTek_IsDebugging( void );
 
 void STP_DebugMsg(TCHAR *prefix, unsigned char *data, unsigned int len, unsigned char isASCII)
 {
 	unsigned int i, j;
 	unsigned int size = len * 2 + 1;
-	TCHAR *msg = (TCHAR *)malloc(size*sizeof(TCHAR));
-	TCHAR *ptr = msg;
+	TCHAR *msg, *ptr;
+
+	/* Formatting every message costs more than sending it */
+	if( !SkyeTek_IsDebugging() )
+		return;
+	msg = (TCHAR *)SkyeTek_Malloc(size*sizeof(TCHAR));
+	ptr = msg;
 	memset(msg,0,size*sizeof(TCHAR));
 
 	for( i = 0, j = 0; i < len && j < size; i++, j++ )
@@ -49,7 +61,7 @@ void STP_DebugMsg(TCHAR *prefix, unsigned char *data, unsigned int len, unsigned
 	}
 	msg[j] = _T('\0');
 	SkyeTek_Debug(_T("%s: %s\r\n"), prefix, msg);
-	free(msg);
+	SkyeTek_Free(msg);
 }
 
 SKYETEK_API SKYETEK_STATUS STPV3_BuildRequest( LPSTPV3_REQUEST req)
@@ -62,6 +74,8 @@ SKYETEK_API SKYETEK_STATUS STPV3_BuildRequest( LPSTPV3_REQUEST req)
     return SKYETEK_INVALID_PARAMETER;
 
   memset(req->msg,0,STPV3_MAX_ASCII_REQUEST_SIZE);
+  memset(&req->prepared,0,sizeof(STPV3_PREPARED));
+  req->prepared.dataLength = req->dataLength;
 
   /* Write ASCII message */
   if( req->isASCII )
@@ -115,9 +129,11 @@ SKYETEK_API SKYETEK_STATUS STPV3_BuildRequest( LPSTPV3_REQUEST req)
 			req->msg[ix++] = crcGetASCIIFromHex(req->session,1);
 			req->msg[ix++] = crcGetASCIIFromHex(req->session,0);
 		}
+		req->prepared.fixedLength = ix;
 		state = STPV3_IsAddressOrDataCommand(req->cmd);
 		if( state & STPV3_FORMAT_ADDRESS )
 		{
+			req->prepared.addressAt = ix;
 			req->msg[ix++] = crcGetASCIIFromHex(req->address[0],1);
 			req->msg[ix++] = crcGetASCIIFromHex(req->address[0],0);
 			req->msg[ix++] = crcGetASCIIFromHex(req->address[1],1);
@@ -125,6 +141,7 @@ SKYETEK_API SKYETEK_STATUS STPV3_BuildRequest( LPSTPV3_REQUEST req)
 		}
 		if( state & STPV3_FORMAT_BLOCKS )
 		{
+			req->prepared.blocksAt = ix;
 			req->msg[ix++] = crcGetASCIIFromHex(req->numBlocks,3);
 			req->msg[ix++] = crcGetASCIIFromHex(req->numBlocks,2);
 			req->msg[ix++] = crcGetASCIIFromHex(req->numBlocks,1);
@@ -132,6 +149,7 @@ SKYETEK_API SKYETEK_STATUS STPV3_BuildRequest( LPSTPV3_REQUEST req)
 		}
 		if( req->flags & STPV3_DATA )
 		{
+			req->prepared.dataAt = ix;
 			req->msg[ix++] = crcGetASCIIFromHex(req->dataLength,3);
 			req->msg[ix++] = crcGetASCIIFromHex(req->dataLength,2);
 			req->msg[ix++] = crcGetASCIIFromHex(req->dataLength,1);
@@ -236,21 +254,25 @@ SKYETEK_API SKYETEK_STATUS STPV3_BuildRequest( LPSTPV3_REQUEST req)
 			req->msg[ix++] = (unsigned char)req->session;
       SkyeTek_Debug(_T("SESS:\t%02X\r\n"),req->msg[ix-1]);
     }
+		req->prepared.fixedLength = ix;
 		state = STPV3_IsAddressOrDataCommand(req->cmd);
 		if( state & STPV3_FORMAT_ADDRESS )
 		{
+			req->prepared.addressAt = ix;
 			req->msg[ix++] = req->address[0];
 			req->msg[ix++] = req->address[1];
       SkyeTek_Debug(_T("ADDR:\t%02X%02X\r\n"),req->msg[ix-2],req->msg[ix-1]);
 		}
 		if( state & STPV3_FORMAT_BLOCKS )
 		{
+			req->prepared.blocksAt = ix;
 			req->msg[ix++] = req->numBlocks >> 8;
 			req->msg[ix++] = req->numBlocks & 0x00FF;
       SkyeTek_Debug(_T("BLKS:\t%02X%02X\r\n"),req->msg[ix-2],req->msg[ix-1]);
 		} 
 		if( req->flags & STPV3_DATA )
 		{
+			req->prepared.dataAt = ix;
 			req->msg[ix++] = req->dataLength >> 8;
 			req->msg[ix++] = req->dataLength & 0x00FF;
       SkyeTek_Debug(_T("DLEN:\t%02X%02X\r\n"),req->msg[ix-2],req->msg[ix-1]);
@@ -281,28 +303,116 @@ SKYETEK_API SKYETEK_STATUS STPV3_BuildRequest( LPSTPV3_REQUEST req)
   return SKYETEK_SUCCESS;
 }
 
-SKYETEK_API SKYETEK_STATUS STPV3_WriteRequest( 
+SKYETEK_API SKYETEK_STATUS STPV3_PrepareRequest( LPSTPV3_REQUEST req)
+{
+  SKYETEK_STATUS status;
+  unsigned int ix;
+
+  if( req == NULL )
+    return SKYETEK_INVALID_PARAMETER;
+  if( (status = STPV3_BuildRequest(req)) != SKYETEK_SUCCESS )
+    return status;
+
+  /* CRC of everything up to the first field a send may change */
+  if( req->isASCII )
+  {
+    req->prepared.crc = 0x0000;
+    for( ix = 1; ix < req->prepared.fixedLength; ix += 2 )
+      req->prepared.crc = crc16OneByte(req->prepared.crc, (unsigned char)crcGetHexFromASCII(&req->msg[ix],2));
+  }
+  else
+  {
+    req->prepared.crc = crc16(0x0000, req->msg+1, (unsigned short)(req->prepared.fixedLength-1));
+  }
+  req->prepared.valid = 1;
+  return SKYETEK_SUCCESS;
+}
+
+SKYETEK_API SKYETEK_STATUS STPV3_PatchRequest( LPSTPV3_REQUEST req)
+{
+  unsigned short crc_check;
+  unsigned int ix, iy, end;
+
+  if( req == NULL )
+    return SKYETEK_INVALID_PARAMETER;
+  if( !req->prepared.valid )
+    return STPV3_BuildRequest(req);
+  /* The binary length leads the message, so new data sizes start over */
+  if( req->dataLength != req->prepared.dataLength )
+    return STPV3_PrepareRequest(req);
+
+  if( req->isASCII )
+  {
+    if( (ix = req->prepared.addressAt) != 0 )
+    {
+      req->msg[ix++] = crcGetASCIIFromHex(req->address[0],1);
+      req->msg[ix++] = crcGetASCIIFromHex(req->address[0],0);
+      req->msg[ix++] = crcGetASCIIFromHex(req->address[1],1);
+      req->msg[ix++] = crcGetASCIIFromHex(req->address[1],0);
+    }
+    if( (ix = req->prepared.blocksAt) != 0 )
+    {
+      req->msg[ix++] = crcGetASCIIFromHex(req->numBlocks,3);
+      req->msg[ix++] = crcGetASCIIFromHex(req->numBlocks,2);
+      req->msg[ix++] = crcGetASCIIFromHex(req->numBlocks,1);
+      req->msg[ix++] = crcGetASCIIFromHex(req->numBlocks,0);
+    }
+    if( (ix = req->prepared.dataAt) != 0 )
+    {
+      for( ix += 4, iy = 0; iy < req->dataLength; iy++ )
+      {
+        req->msg[ix++] = crcGetASCIIFromHex(req->data[iy],1);
+        req->msg[ix++] = crcGetASCIIFromHex(req->data[iy],0);
+      }
+    }
+    if( req->flags & STPV3_CRC )
+    {
+      end = req->msgLength - 5;
+      crc_check = req->prepared.crc;
+      for( ix = req->prepared.fixedLength; ix < end; ix += 2 )
+        crc_check = crc16OneByte(crc_check, (unsigned char)crcGetHexFromASCII(&req->msg[ix],2));
+      req->msg[end++] = crcGetASCIIFromHex((crc_check >> 8),1);
+      req->msg[end++] = crcGetASCIIFromHex((crc_check >> 8),0);
+      req->msg[end++] = crcGetASCIIFromHex((crc_check & 0x00FF),1);
+      req->msg[end++] = crcGetASCIIFromHex((crc_check & 0x00FF),0);
+    }
+  }
+  else
+  {
+    if( (ix = req->prepared.addressAt) != 0 )
+    {
+      req->msg[ix++] = req->address[0];
+      req->msg[ix++] = req->address[1];
+    }
+    if( (ix = req->prepared.blocksAt) != 0 )
+    {
+      req->msg[ix++] = req->numBlocks >> 8;
+      req->msg[ix++] = req->numBlocks & 0x00FF;
+    }
+    if( (ix = req->prepared.dataAt) != 0 )
+      memcpy(req->msg+ix+2, req->data, req->dataLength < 2048 ? req->dataLength : 2048);
+    end = req->msgLength - 2;
+    crc_check = crc16(req->prepared.crc, req->msg+req->prepared.fixedLength, (unsigned short)(end-req->prepared.fixedLength));
+    req->msg[end++] = crc_check >> 8;
+    req->msg[end++] = crc_check & 0x00FF;
+  }
+  return SKYETEK_SUCCESS;
+}
+
+/* Writes the message already encoded in req */
+static SKYETEK_STATUS STPV3_SendRequest( 
   LPSKYETEK_DEVICE        lpDevice, 
   LPSTPV3_REQUEST         req,
   unsigned int            timeout
   )
 {
 	unsigned int written = 0, totalWritten = 0;
-	int i = 0;
-	char c = 0;
-	SKYETEK_STATUS status;
   LPDEVICEIMPL pd;
 
-  if( lpDevice == NULL || req == NULL )
-    return SKYETEK_INVALID_PARAMETER;
-
   pd = (LPDEVICEIMPL)lpDevice->internal;
   if( pd == NULL )
     return SKYETEK_INVALID_PARAMETER;
 
-  if( (status = STPV3_BuildRequest(req)) != SKYETEK_SUCCESS )
-		return status;
-
 	STP_DebugMsg(_T("request"), req->msg, req->msgLength, req->isASCII);
 	SkyeTek_Debug(_T("code: %s\r\n"), STPV3_LookupCommand(req->cmd));
 
@@ -314,9 +424,42 @@ SKYETEK_API SKYETEK_STATUS STPV3_WriteRequest(
 	}
 	if( written < 0 )
 		return SKYETEK_READER_IO_ERROR;
+  req->sentAt = st_get_ticks();
+  if( req->sentAt == 0 )
+    req->sentAt = 1;
   return SKYETEK_SUCCESS;
 }
 
+SKYETEK_API SKYETEK_STATUS STPV3_WriteRequest( 
+  LPSKYETEK_DEVICE        lpDevice, 
+  LPSTPV3_REQUEST         req,
+  unsigned int            timeout
+  )
+{
+	SKYETEK_STATUS status;
+
+  if( lpDevice == NULL || req == NULL )
+    return SKYETEK_INVALID_PARAMETER;
+  if( (status = STPV3_BuildRequest(req)) != SKYETEK_SUCCESS )
+		return status;
+  return STPV3_SendRequest(lpDevice, req, timeout);
+}
+
+SKYETEK_API SKYETEK_STATUS STPV3_WritePreparedRequest( 
+  LPSKYETEK_DEVICE        lpDevice, 
+  LPSTPV3_REQUEST         req,
+  unsigned int            timeout
+  )
+{
+	SKYETEK_STATUS status;
+
+  if( lpDevice == NULL || req == NULL )
+    return SKYETEK_INVALID_PARAMETER;
+  if( (status = STPV3_PatchRequest(req)) != SKYETEK_SUCCESS )
+		return status;
+  return STPV3_SendRequest(lpDevice, req, timeout);
+}
+
 SKYETEK_STATUS STPV3_ReadResponseImpl(
   LPSKYETEK_DEVICE      lpDevice, 
   LPSTPV3_REQUEST       req, 
@@ -337,7 +480,7 @@ SKYETEK_STATUS STPV3_ReadResponseImpl(
   if( pd == NULL )
     return SKYETEK_INVALID_PARAMETER;
 
-	SkyeTek_Debug(_T("timeout is: %d ms\r\n"), (timeout+pd->timeout));
+	SkyeTek_Debug(_T("timeout is: %d ms\r\n"), (timeout+DEVICE_TIMEOUT(lpDevice)));
   
 	if( req->isASCII )
 	{
@@ -583,6 +726,38 @@ read:
   }
 }
 
+/* Reads a response to a request of lpReader. The first answer after
+   the request is timed, and waited for as long as the reader's
+   estimate for the command allows once there is one. */
+static SKYETEK_STATUS STPV3_ReadReaderResponse(
+  LPSKYETEK_READER      lpReader, 
+  LPSTPV3_REQUEST       req, 
+  LPSTPV3_RESPONSE      resp,
+  unsigned int          timeout
+  )
+{
+  LPRESPONSE_TIMER lpTimer = (LPRESPONSE_TIMER)lpReader->lpResponseTimer;
+  SKYETEK_STATUS st;
+  unsigned int units = 1;
+  UINT32 key;
+
+  if( lpTimer == NULL || req->sentAt == 0 )
+    return STPV3_ReadResponse(lpReader->lpDevice, req, resp, timeout);
+
+  /* The mode bits land on SKYETEK_RESPONSE_INVENTORY and SKYETEK_RESPONSE_LOOP */
+  key = req->cmd | ((req->flags & (STPV3_INV | STPV3_LOOP)) << 16);
+  if( (req->cmd == STPV3_CMD_READ_TAG || req->cmd == STPV3_CMD_WRITE_TAG) && req->numBlocks > 1 )
+    units = req->numBlocks;
+  st = STPV3_ReadResponse(lpReader->lpDevice, req, resp,
+    ResponseTimer_Timeout(lpTimer, key, units, timeout));
+  if( st == SKYETEK_SUCCESS )
+    ResponseTimer_Sample(lpTimer, key, units, st_get_ticks() - req->sentAt);
+  else if( st == SKYETEK_TIMEOUT )
+    ResponseTimer_Backoff(lpTimer, key);
+  req->sentAt = 0;
+  return st;
+}
+
 SKYETEK_API unsigned char STPV3_IsAddressOrDataCommand( unsigned int cmd )
 {
   /*
@@ -664,13 +839,10 @@ SKYETEK_API unsigned char STPV3_IsAddressOrDataCommand( unsigned int cmd )
 
 SKYETEK_STATUS STPV3_GetStatus(unsigned int code)
 {
-	int ix;
-	for( ix = 0; ix < STPV3_STATUS_LOOKUPS_COUNT; ix++ )
-	{
-		if( stpv3Statuses[ix].cmd == code )
-			return stpv3Statuses[ix].status;
-	}
-	return SKYETEK_FAILURE;
+	unsigned int slot = LOOKUP_CODE(stpv3StatusPages, stpv3StatusSlots, code);
+	if( slot == 0 )
+		return SKYETEK_FAILURE;
+	return stpv3Statuses[slot - 1].status;
 }
 
 
@@ -846,7 +1018,7 @@ writeCommand:
 		return status;
 
 	memset(&resp,0,sizeof(STPV3_RESPONSE));
-	status = STPV3_ReadResponse(lpReader->lpDevice, &req, &resp, timeout);
+	status = STPV3_ReadReaderResponse(lpReader, &req, &resp, timeout);
 	if( status != SKYETEK_SUCCESS )
 		return status;
 	
@@ -896,7 +1068,7 @@ writeCommand:
 		return status;
 
 	memset(&resp,0,sizeof(STPV3_RESPONSE));
-	status = STPV3_ReadResponse(lpReader->lpDevice, &req, &resp, timeout);
+	status = STPV3_ReadReaderResponse(lpReader, &req, &resp, timeout);
 	if( status != SKYETEK_SUCCESS )
 		return status;
 	
@@ -955,7 +1127,7 @@ writeCommand:
 
 
 	memset(&resp,0,sizeof(STPV3_RESPONSE));
-	status = STPV3_ReadResponse(lpReader->lpDevice, &req, &resp, timeout);
+	status = STPV3_ReadReaderResponse(lpReader, &req, &resp, timeout);
 	if( status != SKYETEK_SUCCESS )
 		return status;
 	
@@ -1009,7 +1181,7 @@ writeCommand:
 		return status;
 
 	memset(&resp,0,sizeof(STPV3_RESPONSE));
-	status = STPV3_ReadResponse(lpReader->lpDevice, &req, &resp, timeout);
+	status = STPV3_ReadReaderResponse(lpReader, &req, &resp, timeout);
 	if( status != SKYETEK_SUCCESS )
 		return status;
 	
@@ -1072,7 +1244,7 @@ writeCommand:
 		return status;
 
 	memset(&resp,0,sizeof(STPV3_RESPONSE));
-	status = STPV3_ReadResponse(lpReader->lpDevice, &req, &resp, timeout);
+	status = STPV3_ReadReaderResponse(lpReader, &req, &resp, timeout);
 	if( status != SKYETEK_SUCCESS )
 		return status;
 	
@@ -1135,7 +1307,7 @@ writeCommand:
 
 	/* Read response */
 	memset(&resp,0,sizeof(STPV3_RESPONSE));
-	status = STPV3_ReadResponse(lpReader->lpDevice, &req, &resp, timeout);
+	status = STPV3_ReadReaderResponse(lpReader, &req, &resp, timeout);
 	if( status != SKYETEK_SUCCESS )
 		return status;
   
@@ -1197,7 +1369,7 @@ writeCommand:
 		return status;
 
 	memset(&resp,0,sizeof(STPV3_RESPONSE));
-	status = STPV3_ReadResponse(lpReader->lpDevice, &req, &resp, timeout);
+	status = STPV3_ReadReaderResponse(lpReader, &req, &resp, timeout);
 	if( status != SKYETEK_SUCCESS )
 		return status;
 	
@@ -1269,7 +1441,7 @@ writeCommand:
 		return status;
 
   memset(&resp,0,sizeof(STPV3_RESPONSE));
-	status = STPV3_ReadResponse(lpReader->lpDevice, &req, &resp, timeout);
+	status = STPV3_ReadReaderResponse(lpReader, &req, &resp, timeout);
 	if( status != SKYETEK_SUCCESS )
 		return status;
 	
@@ -1339,7 +1511,7 @@ writeCommand:
 		return status;
 
 	memset(&resp,0,sizeof(STPV3_RESPONSE));
-	status = STPV3_ReadResponse(lpReader->lpDevice, &req, &resp, timeout);
+	status = STPV3_ReadReaderResponse(lpReader, &req, &resp, timeout);
 	if( status != SKYETEK_SUCCESS )
 		return status;
 	
@@ -1408,7 +1580,7 @@ writeCommand:
 		return status;
 
 	memset(&resp,0,sizeof(STPV3_RESPONSE));
-	status = STPV3_ReadResponse(lpReader->lpDevice, &req, &resp, timeout);
+	status = STPV3_ReadReaderResponse(lpReader, &req, &resp, timeout);
 	if( status != SKYETEK_SUCCESS )
 		return status;
 	
@@ -1484,7 +1656,7 @@ writeCommand:
 		return status;  
 
 	memset(&resp,0,sizeof(STPV3_RESPONSE));
-	status = STPV3_ReadResponse(lpReader->lpDevice, &req, &resp, timeout);
+	status = STPV3_ReadReaderResponse(lpReader, &req, &resp, timeout);
 	if( status != SKYETEK_SUCCESS )
 		return status;
   
@@ -1562,7 +1734,7 @@ writeCommand:
 		return status;
 
 	memset(&resp,0,sizeof(STPV3_RESPONSE));
-	status = STPV3_ReadResponse(lpReader->lpDevice, &req, &resp, timeout);
+	status = STPV3_ReadReaderResponse(lpReader, &req, &resp, timeout);
 	if( status != SKYETEK_SUCCESS )
 		return status;
 	
@@ -1614,7 +1786,7 @@ STPV3_StopSelectLoop(
 	/* Read response */
 readResponse:
 	memset(&resp,0,sizeof(STPV3_RESPONSE));
-	status = STPV3_ReadResponse(lpReader->lpDevice, &req, &resp, timeout);
+	status = STPV3_ReadReaderResponse(lpReader, &req, &resp, timeout);
   if( status != SKYETEK_SUCCESS )
     return status;
   if( resp.code != STPV3_RESP_SELECT_TAG_LOOP_OFF )
@@ -1622,6 +1794,47 @@ readResponse:
   return status;
 }
 
+/* A reader's select request is encoded once and sent as is while its
+   tag type, flags and RID stay the same */
+static LPSTPV3_REQUEST
+STPV3_GetSelectRequest(
+  LPSKYETEK_READER    lpReader,
+  unsigned int        tagType,
+  unsigned int        flags
+  )
+{
+  LPSTPV3_REQUEST req = (LPSTPV3_REQUEST)lpReader->lpSelectRequest;
+  LPREADER_IMPL lpri = (LPREADER_IMPL)lpReader->internal;
+  unsigned char rid[4];
+
+  flags |= STPV3_CRC;
+  memset(rid,0,4);
+  if( lpReader->sendRID || !lpri->DoesRIDMatch(lpReader,genericID) )
+  {
+    lpri->CopyRIDToBuffer(lpReader,rid);
+    flags |= STPV3_RID;
+  }
+  if( req != NULL && req->prepared.valid && req->flags == flags &&
+      req->tagType == tagType && memcmp(req->rid,rid,4) == 0 )
+    return req;
+
+  if( req == NULL )
+  {
+    req = (LPSTPV3_REQUEST)SkyeTek_Malloc(sizeof(STPV3_REQUEST));
+    if( req == NULL )
+      return NULL;
+    lpReader->lpSelectRequest = req;
+  }
+  memset(req,0,sizeof(STPV3_REQUEST));
+  req->cmd = STPV3_CMD_SELECT_TAG;
+  req->flags = flags;
+  req->tagType = tagType;
+  memcpy(req->rid,rid,4);
+  if( STPV3_PrepareRequest(req) != SKYETEK_SUCCESS )
+    return NULL;
+  return req;
+}
+
 SKYETEK_STATUS 
 STPV3_SelectTags(
   LPSKYETEK_READER             lpReader, 
@@ -1632,11 +1845,13 @@ STPV3_SelectTags(
   unsigned int                 timeout
   )
 {
-	STPV3_REQUEST req;
+	LPSTPV3_REQUEST req;
 	STPV3_RESPONSE resp;
 	SKYETEK_STATUS status;
-  LPSKYETEK_DATA lpd;
-  LPREADER_IMPL lpri;
+  SKYETEK_DATA data;
+  uint32 lastCall;
+  LPSKYETEK_READER lpOwner;
+  unsigned char cont;
 	int ix = 0, iy = 0;
 
   if((lpReader == NULL) || (callback == 0))
@@ -1644,29 +1859,24 @@ STPV3_SelectTags(
   if( lpReader->lpDevice == NULL || lpReader->internal == NULL)
     return SKYETEK_INVALID_PARAMETER;
 
-	/* Build request */
-	memset(&req,0,sizeof(STPV3_REQUEST));
-	req.cmd = STPV3_CMD_SELECT_TAG;
-	req.flags = STPV3_CRC | ((flags.isInventory == 1) ? STPV3_INV : 0);
-  req.flags = req.flags | ((flags.isLoop == 1) ? STPV3_LOOP : 0);
-	req.tagType = tagType;
-  lpri = (LPREADER_IMPL)lpReader->internal;
-  if( lpReader->sendRID || !lpri->DoesRIDMatch(lpReader,genericID) )
-  {
-    lpri->CopyRIDToBuffer(lpReader,req.rid);
-    req.flags |= STPV3_RID;
-  }
+	/* Build request, or reuse the one encoded for the last call */
+	req = STPV3_GetSelectRequest(lpReader, tagType,
+    ((flags.isInventory == 1) ? STPV3_INV : 0) | ((flags.isLoop == 1) ? STPV3_LOOP : 0));
+  if( req == NULL )
+    return SKYETEK_OUT_OF_MEMORY;
 
 	/* Send request */
-	status = STPV3_WriteRequest(lpReader->lpDevice, &req, timeout);
+	status = STPV3_WritePreparedRequest(lpReader->lpDevice, req, timeout);
 	if( status != SKYETEK_SUCCESS )
 		return status;
+  lastCall = st_get_ticks();
 
 readResponse:
 	memset(&resp,0,sizeof(STPV3_RESPONSE));
-	status = STPV3_ReadResponse(lpReader->lpDevice, &req, &resp, timeout);
+	status = STPV3_ReadReaderResponse(lpReader, req, &resp, timeout);
   if( status == SKYETEK_TIMEOUT )
   {
+    lastCall = st_get_ticks();
     if(!callback(tagType, NULL, user))
     {
       STPV3_StopSelectLoop(lpReader, timeout);
@@ -1677,6 +1887,19 @@ readResponse:
 	if( status != SKYETEK_SUCCESS )
 		return status;
 
+  /* On a multi-drop bus a late answer can belong to another reader.
+     Error responses carry no RID and always answer this request */
+  lpOwner = lpReader;
+  if( lpReader->lpBus != NULL && (req->flags & STPV3_RID) && !STPV3_IsErrorResponse(resp.code) &&
+      memcmp(resp.rid, req->rid, 4) != 0 )
+  {
+    lpOwner = Bus_FindReader((LPSKYETEK_BUS)lpReader->lpBus, resp.rid);
+    if( lpOwner == NULL )
+      ((LPSKYETEK_BUS)lpReader->lpBus)->unrouted++;
+    if( lpOwner == NULL || resp.code != STPV3_RESP_SELECT_TAG_PASS )
+      goto readResponse;
+  }
+
 	if( resp.code == STPV3_RESP_SELECT_TAG_LOOP_ON )
 		goto readResponse;
 
@@ -1689,22 +1912,49 @@ readResponse:
     if( resp.tagType != 0 )
       tagType = (SKYETEK_TAGTYPE)resp.tagType;
     else
-      tagType = (SKYETEK_TAGTYPE)req.tagType;
+      tagType = (SKYETEK_TAGTYPE)req->tagType;
+
+    /* Drop filtered reads and repeats before anything is allocated. A
+       dropped tag that stays in the field keeps the read from timing
+       out, so the callback is still given an empty read every timeout
+       to let the caller stop the loop */
+    if( (lpOwner->tagFilter != NULL &&
+         !lpOwner->tagFilter(tagType, resp.data, resp.dataLength, lpOwner->tagFilterUser)) ||
+        !DuplicateFilter_Check((LPDUPLICATE_FILTER)lpOwner->lpDuplicateFilter,
+          tagType, resp.data, resp.dataLength) )
+    {
+      if(!flags.isInventory && !flags.isLoop && lpOwner == lpReader)
+        return SKYETEK_SUCCESS;
+      if( st_get_ticks() - lastCall >= timeout )
+      {
+        lastCall = st_get_ticks();
+        if(!callback(tagType, NULL, user))
+        {
+          STPV3_StopSelectLoop(lpReader,timeout);
+          return SKYETEK_SUCCESS;
+        }
+      }
+      goto readResponse;
+    }
 
-    lpd = SkyeTek_AllocateData(resp.dataLength);
-    SkyeTek_CopyBuffer(lpd,resp.data,resp.dataLength);
+    /* Callbacks copy what they keep, so the read is lent to them */
+    data.data = resp.data;
+    data.size = resp.dataLength;
   
 		/* Call the callback */
-		if(!callback(tagType, lpd, user))
+    lastCall = st_get_ticks();
+    if( lpOwner != lpReader )
+      cont = Bus_Deliver((LPSKYETEK_BUS)lpReader->lpBus, lpOwner, tagType, &data);
+    else
+      cont = callback(tagType, &data, user);
+		if(!cont)
 		{
-      SkyeTek_FreeData(lpd);
 			STPV3_StopSelectLoop(lpReader,timeout);
       return SKYETEK_SUCCESS;
 		}
-    SkyeTek_FreeData(lpd);
 
 		/* Check for bail */
-		if(!flags.isInventory && !flags.isLoop)
+		if(!flags.isInventory && !flags.isLoop && lpOwner == lpReader)
       return SKYETEK_SUCCESS;
 		
 		/* Keep reading */
@@ -1754,7 +2004,7 @@ STPV3_GetTags(
 readResponse:
 	/* Read response */
 	memset(&resp,0,sizeof(STPV3_RESPONSE));
-	status = STPV3_ReadResponse(lpReader->lpDevice, &req, &resp, timeout);
+	status = STPV3_ReadReaderResponse(lpReader, &req, &resp, timeout);
 	if( status != SKYETEK_SUCCESS )
     goto failure; /* timeout or error */
 
@@ -1766,15 +2016,15 @@ readResponse:
 		/* Allocate memory */
 		if( !(num % step) )
     {
-			*tagTypes = (LPTAGTYPE_ARRAY*)realloc(*tagTypes, (num + step) * sizeof(LPTAGTYPE_ARRAY));
-			*lpData = (LPSKYETEK_DATA*)realloc(*lpData, (num + step) * sizeof(LPSKYETEK_DATA));
+			*tagTypes = (LPTAGTYPE_ARRAY*)SkyeTek_Realloc(*tagTypes, (num + step) * sizeof(LPTAGTYPE_ARRAY));
+			*lpData = (LPSKYETEK_DATA*)SkyeTek_Realloc(*lpData, (num + step) * sizeof(LPSKYETEK_DATA));
     }
 		if( *tagTypes == NULL || lpData == NULL )
 		{
 			status = SKYETEK_OUT_OF_MEMORY;
 			goto failure;
 		}
-    (*tagTypes)[num] = (LPTAGTYPE_ARRAY)malloc(sizeof(TAGTYPE_ARRAY));
+    (*tagTypes)[num] = (LPTAGTYPE_ARRAY)SkyeTek_Malloc(sizeof(TAGTYPE_ARRAY));
     if( resp.tagType != 0 )
       (*tagTypes)[num]->type = (SKYETEK_TAGTYPE)resp.tagType;
     else
@@ -1799,14 +2049,14 @@ readResponse:
 failure:
   if( *tagTypes != NULL )
   {
-    free(*tagTypes);
+    SkyeTek_Free(*tagTypes);
     *tagTypes = NULL;
   }
   if( *lpData != NULL )
   {
     for( ix = 0; ix < num; ix++ )
       SkyeTek_FreeData((*lpData)[ix]);
-    free(*lpData);
+    SkyeTek_Free(*lpData);
     *lpData = NULL;
   }
 	*count = 0;
@@ -1817,6 +2067,79 @@ success:
   return SKYETEK_SUCCESS;
 }
 
+SKYETEK_STATUS 
+STPV3_GetTagsInto(
+  LPSKYETEK_READER       lpReader, 
+  SKYETEK_TAGTYPE        tagType, 
+  LPSKYETEK_TAG_BUFFER   lpBuffer,
+  unsigned int           timeout
+  )
+{
+	STPV3_REQUEST req;
+	STPV3_RESPONSE resp;
+	SKYETEK_STATUS status;
+  LPREADER_IMPL lpri;
+  SKYETEK_TAGTYPE type;
+
+  if(lpReader == NULL || lpBuffer == NULL )
+    return SKYETEK_INVALID_PARAMETER;
+  if( lpReader->lpDevice == NULL || lpReader->internal == NULL)
+    return SKYETEK_INVALID_PARAMETER;
+
+  lpBuffer->count = 0;
+  lpBuffer->idBytes = 0;
+  lpBuffer->dropped = 0;
+
+	/* Build request */
+	memset(&req,0,sizeof(STPV3_REQUEST));
+	req.cmd = STPV3_CMD_SELECT_TAG;
+	req.flags = STPV3_CRC | STPV3_INV;
+	req.tagType = tagType;
+  lpri = (LPREADER_IMPL)lpReader->internal;
+  if( lpReader->sendRID || !lpri->DoesRIDMatch(lpReader,genericID) )
+  {
+    lpri->CopyRIDToBuffer(lpReader,req.rid);
+    req.flags |= STPV3_RID;
+  }
+
+	/* Send request */
+	status = STPV3_WriteRequest(lpReader->lpDevice, &req, timeout);
+	if( status != SKYETEK_SUCCESS )
+		goto failure;
+  
+readResponse:
+	/* Read response */
+	memset(&resp,0,sizeof(STPV3_RESPONSE));
+	status = STPV3_ReadReaderResponse(lpReader, &req, &resp, timeout);
+	if( status != SKYETEK_SUCCESS )
+    goto failure; /* timeout or error */
+
+	if( resp.code == STPV3_RESP_SELECT_TAG_FAIL || resp.code == STPV3_RESP_SELECT_TAG_INVENTORY_DONE )
+		return SKYETEK_SUCCESS;
+
+	if( resp.code == STPV3_RESP_SELECT_TAG_PASS )
+	{
+    if( resp.tagType != 0 )
+      type = (SKYETEK_TAGTYPE)resp.tagType;
+    else
+      type = (SKYETEK_TAGTYPE)req.tagType;
+    /* A full buffer only counts the tag; keep draining the inventory */
+    SkyeTek_AppendTagBuffer(lpBuffer,type,resp.data,resp.dataLength);
+
+		/* Keep reading */
+		goto readResponse;
+	}
+
+  /* Unknown code? */
+  SkyeTek_Debug(_T("Unknown response code: 0x%X\r\n"), resp.code);
+  return SKYETEK_SUCCESS;
+ 
+failure:
+  lpBuffer->count = 0;
+  lpBuffer->idBytes = 0;
+	return status;
+}
+
 SKYETEK_STATUS 
 STPV3_GetTagsWithMask(
   LPSKYETEK_READER   lpReader, 
@@ -1867,7 +2190,7 @@ STPV3_GetTagsWithMask(
 readResponse:
 	/* Read response */
 	memset(&resp,0,sizeof(STPV3_RESPONSE));
-	status = STPV3_ReadResponse(lpReader->lpDevice, &req, &resp, timeout);
+	status = STPV3_ReadReaderResponse(lpReader, &req, &resp, timeout);
 	if( status != SKYETEK_SUCCESS )
     goto success; /* done reading */
 
@@ -1879,15 +2202,15 @@ readResponse:
 		/* Allocate memory */
 		if( !(num % step) )
     {
-			*tagTypes = (LPTAGTYPE_ARRAY*)realloc(*tagTypes, (num + step) * sizeof(LPTAGTYPE_ARRAY));
-			*lpData = (LPSKYETEK_DATA*)realloc(*lpData, (num + step) * sizeof(LPSKYETEK_DATA));
+			*tagTypes = (LPTAGTYPE_ARRAY*)SkyeTek_Realloc(*tagTypes, (num + step) * sizeof(LPTAGTYPE_ARRAY));
+			*lpData = (LPSKYETEK_DATA*)SkyeTek_Realloc(*lpData, (num + step) * sizeof(LPSKYETEK_DATA));
     }
 		if( *tagTypes == NULL || lpData == NULL )
 		{
 			status = SKYETEK_OUT_OF_MEMORY;
 			goto failure;
 		}
-    (*tagTypes)[num] = (LPTAGTYPE_ARRAY)malloc(sizeof(TAGTYPE_ARRAY));
+    (*tagTypes)[num] = (LPTAGTYPE_ARRAY)SkyeTek_Malloc(sizeof(TAGTYPE_ARRAY));
     if( resp.tagType != 0 )
       (*tagTypes)[num]->type = (SKYETEK_TAGTYPE)resp.tagType;
     else
@@ -1912,14 +2235,14 @@ readResponse:
 failure:
   if( *tagTypes != NULL )
   {
-    free(*tagTypes);
+    SkyeTek_Free(*tagTypes);
     *tagTypes = NULL;
   }
   if( *lpData != NULL )
   {
     for( ix = 0; ix < num; ix++ )
       SkyeTek_FreeData((*lpData)[ix]);
-    free(*lpData);
+    SkyeTek_Free(*lpData);
     *lpData = NULL;
   }
 	*count = 0;
@@ -1976,7 +2299,7 @@ writeCommand:
 		return status;
 
 	memset(&resp,0,sizeof(STPV3_RESPONSE));
-	status = STPV3_ReadResponse(lpReader->lpDevice, &req, &resp, timeout);
+	status = STPV3_ReadReaderResponse(lpReader, &req, &resp, timeout);
 	if( status != SKYETEK_SUCCESS )
 		return status;
 	
@@ -2026,7 +2349,7 @@ writeCommand:
 		return status;
 
 	memset(&resp,0,sizeof(STPV3_RESPONSE));
-	status = STPV3_ReadResponse(lpReader->lpDevice, &req, &resp, timeout);
+	status = STPV3_ReadReaderResponse(lpReader, &req, &resp, timeout);
 	if( status != SKYETEK_SUCCESS )
 		return status;
 	
@@ -2569,7 +2892,7 @@ STPV3_ScanPayments(
 
   /* Get response */
 	memset(&resp,0,sizeof(STPV3_RESPONSE));
-	status = STPV3_ReadResponse(lpReader->lpDevice, &req, &resp, timeout);
+	status = STPV3_ReadReaderResponse(lpReader, &req, &resp, timeout);
 	if( status != SKYETEK_SUCCESS )
 		return status;
 
@@ -2673,7 +2996,7 @@ writeCommand:
 
 	/* Read response */
 	memset(&resp,0,sizeof(STPV3_RESPONSE));
-	status = STPV3_ReadResponse(lpReader->lpDevice, &req, &resp, timeout);
+	status = STPV3_ReadReaderResponse(lpReader, &req, &resp, timeout);
 	if( status != SKYETEK_SUCCESS )
 		return status;
 	
@@ -3526,13 +3849,10 @@ unsigned char STPV3_IsErrorResponse(unsigned int code)
 
 TCHAR *STPV3_LookupCommand( unsigned int cmd )
 {
-	int ix;
-	for( ix = 0; ix < STPV3_CMD_LOOKUPS_COUNT; ix++ )
-	{
-		if( stpv3Commands[ix].cmd == cmd )
-			return stpv3Commands[ix].name;
-	}
-	return _T("Unknown");
+	unsigned int slot = LOOKUP_CODE(stpv3CommandPages, stpv3CommandSlots, cmd);
+	if( slot == 0 )
+		return _T("Unknown");
+	return stpv3Commands[slot - 1].name;
 }
 
 unsigned int STPV3_LookupCommandCode( TCHAR *cmdName )
@@ -3540,12 +3860,8 @@ unsigned int STPV3_LookupCommandCode( TCHAR *cmdName )
 	int ix;
   if( cmdName == NULL )
     return 0;
-	for( ix = 0; ix < STPV3_CMD_LOOKUPS_COUNT; ix++ )
-	{
-		if( _tcscmp(stpv3Commands[ix].name, cmdName) == 0 )
-			return stpv3Commands[ix].cmd;
-	}
-	return 0;
+	ix = LOOKUP_NAME(stpv3Commands, STPV3_CODE_LOOKUP, name, stpv3CommandByName, cmdName);
+	return ix < 0 ? 0 : stpv3Commands[ix].cmd;
 }
 
 int STPV3_GetCommandCount()
@@ -3562,13 +3878,10 @@ TCHAR *STPV3_GetCommandNameAt( int ix )
 
 TCHAR *STPV3_LookupResponse( unsigned int resp )
 {
-	int ix;
-	for( ix = 0; ix < STPV3_RESP_LOOKUPS_COUNT; ix++ )
-	{
-		if( stpv3Responses[ix].cmd == resp )
-			return stpv3Responses[ix].name;
-	}
-	return _T("Unknown");
+	unsigned int slot = LOOKUP_CODE(stpv3ResponsePages, stpv3ResponseSlots, resp);
+	if( slot == 0 )
+		return _T("Unknown");
+	return stpv3Responses[slot - 1].name;
 }
 
 unsigned int STPV3_LookupResponseCode( TCHAR *respName )
@@ -3576,13 +3889,8 @@ unsigned int STPV3_LookupResponseCode( TCHAR *respName )
 	int ix;
   if( respName == NULL )
     return 0;
-
-	for( ix = 0; ix < STPV3_RESP_LOOKUPS_COUNT; ix++ )
-	{
-		if( _tcscmp(stpv3Responses[ix].name, respName) == 0 )
-			return stpv3Responses[ix].cmd;
-	}
-	return 0;
+	ix = LOOKUP_NAME(stpv3Responses, STPV3_CODE_LOOKUP, name, stpv3ResponseByName, respName);
+	return ix < 0 ? 0 : stpv3Responses[ix].cmd;
 }
 
 int STPV3_GetResponsesCount()
@@ -3602,6 +3910,7 @@ PROTOCOLIMPL STPV3Impl = {
   3,
   STPV3_SelectTags,
   STPV3_GetTags,
+  STPV3_GetTagsInto,
   STPV3_GetTagsWithMask,
   STPV3_StoreKey,
   STPV3_LoadKey,
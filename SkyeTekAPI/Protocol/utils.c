@@ -1,4 +1,5 @@
 #include "utils.h"
+#include "../SkyeTekAPI.h"
 #include <string.h>
 #include <stdlib.h>
 
@@ -12,6 +13,10 @@
 
 static const TCHAR* s_no_error_message = _T("Unable to obtain error message");
 
+#else
+
+#include <time.h>
+
 #endif
 
 void st_ints2bytes(uint32* src, int count, unsigned char* bytes) {
@@ -135,7 +140,7 @@ int st_memcmp(const void *s1, const void* s2, int n) {
 
 void* st_alloc(int size) {
 #ifndef __ARM_ARCH_4T__
-  return malloc(size);
+  return SkyeTek_Malloc(size);
 #else
   return 0;
 #endif
@@ -143,12 +148,22 @@ void* st_alloc(int size) {
 
 void st_free(void* ptr) {
 #ifndef __ARM_ARCH_4T__
-  free(ptr);
+  SkyeTek_Free(ptr);
 #else
   return;
 #endif
 }
 
+uint32 st_get_ticks(void) {
+#ifdef WIN32
+  return (uint32)GetTickCount();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+#endif
+}
+
 #ifdef WIN32
 
 TCHAR*
@@ -55,6 +55,9 @@ void* st_alloc(int size);
 
 void st_free(void* ptr);
 
+/* Milliseconds from a monotonic clock; wraps, so only compare differences */
+uint32 st_get_ticks(void);
+
 #ifdef WIN32
 TCHAR* st_alloc_error_message(int err);
 
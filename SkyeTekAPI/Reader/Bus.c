@@ -0,0 +1,264 @@
+/**
+ * Bus.c
+ * Copyright \xa9 2006 - 2008 Skyetek, Inc. All Rights Reserved.
+ *
+ * Schedules inventory across the readers of a multi-drop line.
+ */
+#include "../SkyeTekAPI.h"
+#include "../Protocol/Protocol.h"
+#include "../Protocol/utils.h"
+#include "../Tag/TagFactory.h"
+#include "Bus.h"
+#include <string.h>
+
+/* Dwell when the settings leave it 0 */
+#define BUS_DEFAULT_DWELL     200
+/* Longest wait for the next answer of an inventory round */
+#define BUS_ROUND_TIMEOUT     1000
+
+typedef struct BUS_TURN
+{
+  LPSKYETEK_BUS     lpBus;
+  LPBUS_MEMBER      lpMember;
+  unsigned char     timedOut;
+} BUS_TURN, *LPBUS_TURN;
+
+LPSKYETEK_BUS
+Bus_Create(
+  LPSKYETEK_DEVICE lpDevice
+  )
+{
+  LPSKYETEK_BUS lpBus;
+
+  lpBus = (LPSKYETEK_BUS)SkyeTek_Malloc(sizeof(SKYETEK_BUS));
+  if( lpBus == NULL )
+    return NULL;
+  memset(lpBus, 0, sizeof(SKYETEK_BUS));
+  lpBus->lpDevice = lpDevice;
+  return lpBus;
+}
+
+SKYETEK_STATUS
+Bus_Add(
+  LPSKYETEK_BUS     lpBus,
+  LPSKYETEK_READER  lpReader
+  )
+{
+  if( lpBus == NULL || lpReader == NULL )
+    return SKYETEK_INVALID_PARAMETER;
+  if( lpBus->count >= BUS_MAX_READERS )
+    return SKYETEK_OUT_OF_MEMORY;
+  memset(&lpBus->members[lpBus->count], 0, sizeof(BUS_MEMBER));
+  lpBus->members[lpBus->count].lpReader = lpReader;
+  lpBus->members[lpBus->count].weight = 1;
+  lpBus->count++;
+  lpReader->lpBus = lpBus;
+  return SKYETEK_SUCCESS;
+}
+
+void
+Bus_Remove(
+  LPSKYETEK_READER  lpReader
+  )
+{
+  LPSKYETEK_BUS lpBus;
+  unsigned int ix;
+
+  if( lpReader == NULL || lpReader->lpBus == NULL )
+    return;
+  lpBus = (LPSKYETEK_BUS)lpReader->lpBus;
+  lpReader->lpBus = NULL;
+  for( ix = 0; ix < lpBus->count; ix++ )
+  {
+    if( lpBus->members[ix].lpReader == lpReader )
+    {
+      lpBus->count--;
+      memmove(&lpBus->members[ix], &lpBus->members[ix + 1],
+        (lpBus->count - ix) * sizeof(BUS_MEMBER));
+      break;
+    }
+  }
+  if( lpBus->count == 0 )
+    SkyeTek_Free(lpBus);
+}
+
+static LPBUS_MEMBER
+Bus_FindMember(
+  LPSKYETEK_BUS     lpBus,
+  LPSKYETEK_READER  lpReader
+  )
+{
+  unsigned int ix;
+  for( ix = 0; ix < lpBus->count; ix++ )
+  {
+    if( lpBus->members[ix].lpReader == lpReader )
+      return &lpBus->members[ix];
+  }
+  return NULL;
+}
+
+LPSKYETEK_READER
+Bus_FindReader(
+  LPSKYETEK_BUS         lpBus,
+  const unsigned char   *rid
+  )
+{
+  LPSKYETEK_READER lpReader;
+  unsigned int ix;
+
+  if( lpBus == NULL || rid == NULL )
+    return NULL;
+  for( ix = 0; ix < lpBus->count; ix++ )
+  {
+    lpReader = lpBus->members[ix].lpReader;
+    if( lpReader->id != NULL && memcmp(lpReader->id->id, rid, lpReader->id->length) == 0 )
+      return lpReader;
+  }
+  return NULL;
+}
+
+/* Gives a read to the bus callback; clears the run on a stop */
+static unsigned char
+Bus_Report(
+  LPSKYETEK_BUS       lpBus,
+  LPBUS_MEMBER        lpMember,
+  SKYETEK_TAGTYPE     type,
+  LPSKYETEK_DATA      lpData
+  )
+{
+  LPSKYETEK_TAG lpTag = NULL;
+
+  if( CreateTagImpl(type, (LPSKYETEK_ID)lpData, &lpTag) != SKYETEK_SUCCESS )
+    return 1;
+  lpMember->lastTags++;
+  if( !lpBus->callback(lpMember->lpReader, lpTag, lpBus->user) )
+  {
+    lpBus->stop = 1;
+    return 0;
+  }
+  return 1;
+}
+
+unsigned char
+Bus_Deliver(
+  LPSKYETEK_BUS       lpBus,
+  LPSKYETEK_READER    lpReader,
+  SKYETEK_TAGTYPE     type,
+  LPSKYETEK_DATA      lpData
+  )
+{
+  LPBUS_MEMBER lpMember;
+
+  if( lpBus == NULL || lpBus->callback == NULL || lpData == NULL )
+    return 1;
+  lpMember = Bus_FindMember(lpBus, lpReader);
+  if( lpMember == NULL )
+  {
+    lpBus->unrouted++;
+    return 1;
+  }
+  lpBus->routed++;
+  return Bus_Report(lpBus, lpMember, type, lpData);
+}
+
+static unsigned char
+Bus_TurnCallback(
+  SKYETEK_TAGTYPE type,
+  LPSKYETEK_DATA lpData,
+  void  *user
+  )
+{
+  LPBUS_TURN lpTurn = (LPBUS_TURN)user;
+  LPSKYETEK_BUS lpBus = lpTurn->lpBus;
+
+  /* A silent reader ends its round, the next one gets the line */
+  if( lpData == NULL || lpData->data == NULL || lpData->size == 0 )
+  {
+    lpTurn->timedOut = 1;
+    if( !lpBus->callback(lpTurn->lpMember->lpReader, NULL, lpBus->user) )
+      lpBus->stop = 1;
+    return 0;
+  }
+  return Bus_Report(lpBus, lpTurn->lpMember, type, lpData);
+}
+
+SKYETEK_STATUS
+Bus_SelectTags(
+  LPSKYETEK_READER            *lpReaders,
+  unsigned int                count,
+  SKYETEK_TAGTYPE             tagType,
+  LPSKYETEK_BUS_SETTINGS      lpSettings,
+  SKYETEK_BUS_TAG_CALLBACK    callback,
+  void                        *user
+  )
+{
+  LPSKYETEK_BUS lpBus;
+  LPBUS_MEMBER lpMember;
+  LPPROTOCOLIMPL lppi;
+  PROTOCOL_FLAGS flags = {1,0,0,0,0};
+  BUS_TURN turn;
+  SKYETEK_STATUS status;
+  unsigned int dwell, idleDwell, ix;
+  uint32 start;
+
+  if( lpReaders == NULL || count == 0 || callback == NULL )
+    return SKYETEK_INVALID_PARAMETER;
+  lpBus = (LPSKYETEK_BUS)lpReaders[0]->lpBus;
+  if( lpBus == NULL )
+    return SKYETEK_INVALID_PARAMETER;
+  for( ix = 0; ix < count; ix++ )
+  {
+    if( lpReaders[ix]->lpBus != lpBus || lpReaders[ix]->lpProtocol == NULL )
+      return SKYETEK_INVALID_PARAMETER;
+    lpMember = Bus_FindMember(lpBus, lpReaders[ix]);
+    lpMember->credit = 0;
+    lpMember->lastTags = 1;
+  }
+
+  dwell = BUS_DEFAULT_DWELL;
+  idleDwell = 0;
+  if( lpSettings != NULL && lpSettings->dwell > 0 )
+    dwell = lpSettings->dwell;
+  if( lpSettings != NULL )
+    idleDwell = lpSettings->idleDwell;
+  if( idleDwell == 0 )
+    idleDwell = dwell;
+
+  lpBus->callback = callback;
+  lpBus->user = user;
+  lpBus->stop = 0;
+  turn.lpBus = lpBus;
+
+  /* Deficit round robin: each turn adds a quantum of credit and rounds
+     run while it lasts, so an overrun is paid back on the next turn */
+  while( !lpBus->stop )
+  {
+    for( ix = 0; ix < count && !lpBus->stop; ix++ )
+    {
+      lpMember = Bus_FindMember(lpBus, lpReaders[ix]);
+      lpMember->credit += (int)((lpMember->lastTags > 0 ? dwell : idleDwell) * lpMember->weight);
+      lpMember->lastTags = 0;
+      lppi = (LPPROTOCOLIMPL)lpReaders[ix]->lpProtocol->internal;
+      while( lpMember->credit > 0 && !lpBus->stop )
+      {
+        turn.lpMember = lpMember;
+        turn.timedOut = 0;
+        start = st_get_ticks();
+        status = lppi->SelectTags(lpReaders[ix], tagType, Bus_TurnCallback, flags,
+          (void *)&turn, BUS_ROUND_TIMEOUT);
+        lpMember->credit -= (int)(st_get_ticks() - start);
+        /* A failed reader keeps its debt but banks no credit */
+        if( status != SKYETEK_SUCCESS || turn.timedOut )
+        {
+          if( lpMember->credit > 0 )
+            lpMember->credit = 0;
+          break;
+        }
+      }
+    }
+  }
+
+  lpBus->callback = NULL;
+  lpBus->user = NULL;
+  return SKYETEK_SUCCESS;
+}
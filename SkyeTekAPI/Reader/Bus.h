@@ -0,0 +1,125 @@
+/**
+ * Bus.h
+ * Copyright  2006 - 2008 Skyetek, Inc. All Rights Reserved.
+ *
+ * Readers sharing one multi-drop (RS-485) line, told apart by RID.
+ */
+#ifndef STAPI_BUS_H
+#define STAPI_BUS_H
+
+#include "../SkyeTekAPI.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Most readers one line is scheduled across */
+#define BUS_MAX_READERS       32
+
+typedef struct BUS_MEMBER
+{
+  LPSKYETEK_READER  lpReader;
+  unsigned int      weight;
+  int               credit;       /* ms of inventory left, negative after an overrun */
+  unsigned int      lastTags;     /* tags found in the member's last turn */
+} BUS_MEMBER, *LPBUS_MEMBER;
+
+typedef struct SKYETEK_BUS
+{
+  LPSKYETEK_DEVICE            lpDevice;
+  BUS_MEMBER                  members[BUS_MAX_READERS];
+  unsigned int                count;
+  SKYETEK_BUS_TAG_CALLBACK    callback;   /* set while SkyeTek_SelectTagsOnBus() runs */
+  void                        *user;
+  unsigned char               stop;
+  unsigned long               routed;     /* reads answered under another reader's turn */
+  unsigned long               unrouted;   /* reads from a RID not on the bus */
+} SKYETEK_BUS, *LPSKYETEK_BUS;
+
+/**
+ * Allocates an empty bus.
+ * @param lpDevice Device the readers share
+ * @return Bus or NULL if out of memory
+ */
+LPSKYETEK_BUS
+Bus_Create(
+  LPSKYETEK_DEVICE lpDevice
+  );
+
+/**
+ * Adds a reader to the bus and points its lpBus at it.
+ * @param lpBus Bus to join
+ * @param lpReader Reader, addressed by its own RID
+ * @return SKYETEK_SUCCESS, or SKYETEK_OUT_OF_MEMORY if the bus is full
+ */
+SKYETEK_STATUS
+Bus_Add(
+  LPSKYETEK_BUS     lpBus,
+  LPSKYETEK_READER  lpReader
+  );
+
+/**
+ * Removes a reader from its bus. The bus is freed with its last reader.
+ * @param lpReader Reader to remove, may be on no bus
+ */
+void
+Bus_Remove(
+  LPSKYETEK_READER  lpReader
+  );
+
+/**
+ * Finds the member a response RID belongs to.
+ * @param lpBus Bus to search
+ * @param rid RID bytes of the response
+ * @return Reader or NULL if no member has that RID
+ */
+LPSKYETEK_READER
+Bus_FindReader(
+  LPSKYETEK_BUS         lpBus,
+  const unsigned char   *rid
+  );
+
+/**
+ * Hands a read that arrived under another reader's request to the
+ * bus callback on behalf of the reader that made it. Reads outside
+ * SkyeTek_SelectTagsOnBus() are dropped.
+ * @param lpBus Bus the read arrived on
+ * @param lpReader Reader that made the read
+ * @param type Tag type of the read
+ * @param lpData ID of the read; not kept
+ * @return 0 if the callback asked to stop, 1 otherwise
+ */
+unsigned char
+Bus_Deliver(
+  LPSKYETEK_BUS       lpBus,
+  LPSKYETEK_READER    lpReader,
+  SKYETEK_TAGTYPE     type,
+  LPSKYETEK_DATA      lpData
+  );
+
+/**
+ * Runs timed inventory turns on the readers of a bus until the
+ * callback asks to stop.
+ * @param lpReaders Readers to schedule; all on the same bus
+ * @param count Number of readers
+ * @param tagType Tag type to select
+ * @param lpSettings Dwell settings
+ * @param callback Called with every read and the reader that made it
+ * @param user User data passed to the callback
+ * @return Status
+ */
+SKYETEK_STATUS
+Bus_SelectTags(
+  LPSKYETEK_READER            *lpReaders,
+  unsigned int                count,
+  SKYETEK_TAGTYPE             tagType,
+  LPSKYETEK_BUS_SETTINGS      lpSettings,
+  SKYETEK_BUS_TAG_CALLBACK    callback,
+  void                        *user
+  );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
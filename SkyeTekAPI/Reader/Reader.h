@@ -25,6 +25,16 @@ typedef struct READER_IMPL
       void                        *user
       );
 
+  SKYETEK_STATUS 
+  (*SelectTagIds)(
+      LPSKYETEK_READER            lpReader, 
+      SKYETEK_TAGTYPE             tagType, 
+      SKYETEK_TAG_ID_CALLBACK     callback, 
+      unsigned char               inv, 
+      unsigned char               loop, 
+      void                        *user
+      );
+
   SKYETEK_STATUS 
   (*GetTags)(
       LPSKYETEK_READER   lpReader, 
@@ -33,6 +43,13 @@ typedef struct READER_IMPL
       unsigned short     *count
       );
 
+  SKYETEK_STATUS 
+  (*GetTagsInto)(
+      LPSKYETEK_READER       lpReader, 
+      SKYETEK_TAGTYPE        tagType, 
+      LPSKYETEK_TAG_BUFFER   lpBuffer
+      );
+
   SKYETEK_STATUS 
   (*GetTagsWithMask)(
       LPSKYETEK_READER   lpReader, 
@@ -76,9 +76,9 @@ DiscoverReadersImpl(
   
     if(localCount > 0) 
     {
-      *readers = (LPSKYETEK_READER*)realloc(*readers, (readerCount + localCount) * sizeof(LPSKYETEK_READER));
+      *readers = (LPSKYETEK_READER*)SkyeTek_Realloc(*readers, (readerCount + localCount) * sizeof(LPSKYETEK_READER));
       memcpy(((*readers) + readerCount), localReaders, localCount*sizeof(LPSKYETEK_READER));
-      free(localReaders);
+      SkyeTek_Free(localReaders);
       readerCount += localCount;
     }
   }
@@ -59,6 +59,22 @@ typedef struct READER_FACTORY {
 extern READER_FACTORY SkyetekReaderFactory;
 extern READER_FACTORY DemoReaderFactory;
 
+/**
+ * Discovers the STPv3 readers sharing a multi-drop device by RID.
+ * @param device Device the readers share
+ * @param firstRid First RID to try
+ * @param lastRid Last RID to try
+ * @param readers Pointer to array to popluate.  This function will allocate memory.
+ * @return Number of readers found (size of readers array) 
+ */
+unsigned int 
+SkyetekReaderFactory_DiscoverBusReaders(
+  LPSKYETEK_DEVICE    device, 
+  unsigned int        firstRid, 
+  unsigned int        lastRid, 
+  LPSKYETEK_READER    **readers
+  );
+
 /**
  * Returns the number of registered reader factories
  */
@@ -76,6 +76,56 @@ SkyeTekReader_SelectTags(
   return lppi->SelectTags(lpReader,tagType,SkyeTekReader_SelectTagsCallback,flags,(void *)&cd,2000);
 }
 
+typedef struct ST_ID_CALLBACK_DATA
+{
+  SKYETEK_TAG_ID_CALLBACK       callback;
+  void                          *user;
+} ST_ID_CALLBACK_DATA, *LPST_ID_CALLBACK_DATA;
+
+unsigned char 
+SkyeTekReader_SelectTagIdsCallback(
+    SKYETEK_TAGTYPE type,
+    LPSKYETEK_DATA lpData,
+    void  *user
+    )
+{
+  LPST_ID_CALLBACK_DATA lpCd;
+  
+  if( user == NULL )
+    return 0;
+
+  lpCd = (LPST_ID_CALLBACK_DATA)user;
+  if( lpData == NULL || lpData->data == NULL || lpData->size == 0 )
+    return lpCd->callback(type,NULL,0,lpCd->user);
+  return lpCd->callback(type,lpData->data,lpData->size,lpCd->user);
+}
+
+SKYETEK_STATUS 
+SkyeTekReader_SelectTagIds(
+    LPSKYETEK_READER            lpReader, 
+    SKYETEK_TAGTYPE             tagType, 
+    SKYETEK_TAG_ID_CALLBACK     callback, 
+    unsigned char               inv, 
+    unsigned char               loop, 
+    void                        *user
+    )
+{
+  LPPROTOCOLIMPL lppi;
+  PROTOCOL_FLAGS flags;
+  ST_ID_CALLBACK_DATA cd;
+
+  if( lpReader == NULL || lpReader->lpProtocol == NULL || lpReader->lpDevice == NULL || callback == NULL )
+    return SKYETEK_INVALID_PARAMETER;
+  
+  flags.isInventory = inv;
+  flags.isLoop = loop;
+  cd.callback = callback;
+  cd.user = user;
+
+  lppi = (LPPROTOCOLIMPL)lpReader->lpProtocol->internal;
+  return lppi->SelectTags(lpReader,tagType,SkyeTekReader_SelectTagIdsCallback,flags,(void *)&cd,2000);
+}
+
 SKYETEK_STATUS 
 SkyeTekReader_GetTags(
     LPSKYETEK_READER   lpReader, 
@@ -102,7 +152,7 @@ SkyeTekReader_GetTags(
 
   if( num > 0 )
   {
-    *lpTags = (LPSKYETEK_TAG *)malloc(num * sizeof(LPSKYETEK_TAG));
+    *lpTags = (LPSKYETEK_TAG *)SkyeTek_Malloc(num * sizeof(LPSKYETEK_TAG));
     if( *lpTags == NULL )
     {
       status = SKYETEK_OUT_OF_MEMORY;
@@ -133,13 +183,29 @@ cleanup:
     {
       SkyeTek_FreeData(lpData[ix]);
     }
-    free(lpData);
+    SkyeTek_Free(lpData);
   }
   if( tagTypes != NULL )
-    free(tagTypes);
+    SkyeTek_Free(tagTypes);
   return status;
 }
 
+SKYETEK_STATUS 
+SkyeTekReader_GetTagsInto(
+    LPSKYETEK_READER       lpReader, 
+    SKYETEK_TAGTYPE        tagType, 
+    LPSKYETEK_TAG_BUFFER   lpBuffer
+    )
+{
+  LPPROTOCOLIMPL lppi;
+
+  if( lpReader == NULL || lpReader->lpProtocol == NULL || lpReader->lpDevice == NULL )
+    return SKYETEK_INVALID_PARAMETER;
+
+  lppi = (LPPROTOCOLIMPL)lpReader->lpProtocol->internal;
+  return lppi->GetTagsInto(lpReader,tagType,lpBuffer,5000);
+}
+
 SKYETEK_STATUS 
 SkyeTekReader_GetTagsWithMask(
     LPSKYETEK_READER   lpReader, 
@@ -167,7 +233,7 @@ SkyeTekReader_GetTagsWithMask(
 
   if( num > 0 )
   {
-    *lpTags = (LPSKYETEK_TAG *)malloc(num * sizeof(LPSKYETEK_TAG));
+    *lpTags = (LPSKYETEK_TAG *)SkyeTek_Malloc(num * sizeof(LPSKYETEK_TAG));
     if( *lpTags == NULL )
     {
       status = SKYETEK_OUT_OF_MEMORY;
@@ -198,10 +264,10 @@ cleanup:
     {
       SkyeTek_FreeData(lpData[ix]);
     }
-    free(lpData);
+    SkyeTek_Free(lpData);
   }
   if( tagTypes != NULL )
-    free(tagTypes);
+    SkyeTek_Free(tagTypes);
   return status;
 }
 
@@ -219,7 +285,7 @@ SkyeTekReader_FreeTags(
   for( ix = 0; ix < count; ix++ )
     FreeTagImpl(lpTags[ix]);
 
-  free(lpTags);
+  SkyeTek_Free(lpTags);
   return SKYETEK_SUCCESS;
 }
 
@@ -627,7 +693,9 @@ SkyeTekReader_ScanPayments(
 
 READER_IMPL SkyetekReaderImpl = {
   SkyeTekReader_SelectTags,
+  SkyeTekReader_SelectTagIds,
   SkyeTekReader_GetTags,
+  SkyeTekReader_GetTagsInto,
   SkyeTekReader_GetTagsWithMask,
   SkyeTekReader_FreeTags,
   SkyeTekReader_StoreKey,
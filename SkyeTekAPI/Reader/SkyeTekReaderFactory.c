@@ -11,7 +11,10 @@
 #include "../Protocol/Protocol.h"
 #include "../Protocol/STPv2.h"
 #include "../Protocol/STPv3.h"
+#include "../Protocol/DuplicateFilter.h"
+#include "../Protocol/ResponseTimer.h"
 #include "../Device/SerialDevice.h"
+#include "Bus.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -30,6 +33,11 @@ SkyeTek_Debug(
   ...
   );
 
+int 
+SkyetekReaderFactory_FreeReader(
+  LPSKYETEK_READER lpReader
+  );
+
 
 int 
 GetReaderVersion(
@@ -168,11 +176,13 @@ GetReaderVersion(
   return 0;
 }
 
+/* Queries the reader answering to lpRid, or to any RID if lpRid is NULL */
 LPSKYETEK_READER 
-GetReader(
+GetReaderAt(
   LPSKYETEK_DEVICE    lpDevice, 
   LPPROTOCOLIMPL      lpPI,
-  unsigned int        ver
+  unsigned int        ver,
+  LPSKYETEK_ID        lpRid
   )
 {
   LPSKYETEK_READER lpReader = NULL;
@@ -188,12 +198,19 @@ GetReader(
     return NULL;
 
   /* Fill temp reader for system calls */
+  memset(&tmpReader, 0, sizeof(SKYETEK_READER));
   if( ver == 2 )
   {
     tmpReader.id = SkyeTek_AllocateID(1);
     if( tmpReader.id != NULL )
       tmpReader.id->id[0] = 0xFF;
   }
+  else if( lpRid != NULL )
+  {
+    tmpReader.id = SkyeTek_AllocateID(lpRid->length);
+    if( tmpReader.id != NULL )
+      memcpy(tmpReader.id->id, lpRid->id, lpRid->length);
+  }
   else
   {
     tmpReader.id = SkyeTek_AllocateID(4);
@@ -212,7 +229,7 @@ GetReader(
   if( status != SKYETEK_SUCCESS || lpData == NULL )
     goto failure;
 
-  lpReader = (LPSKYETEK_READER)malloc(sizeof(SKYETEK_READER));
+  lpReader = (LPSKYETEK_READER)SkyeTek_Malloc(sizeof(SKYETEK_READER));
   if( lpReader == NULL )
   {
     SkyeTek_FreeData(lpData);
@@ -298,7 +315,7 @@ GetReader(
   status = lpPI->GetSystemParameter(&tmpReader, &addr, &lpData,100);
   if( status != SKYETEK_SUCCESS )
   {
-    free(lpReader);
+    SkyeTek_Free(lpReader);
     goto failure;
   }
   if( lpData != NULL && lpData->size > 0 && lpData->data != NULL )
@@ -329,7 +346,7 @@ GetReader(
   status = lpPI->GetSystemParameter(&tmpReader, &addr, &lpData,100);
   if( status != SKYETEK_SUCCESS )
   {
-    free(lpReader);
+    SkyeTek_Free(lpReader);
     goto failure;
   }
   str = SkyeTek_GetStringFromData(lpData);
@@ -347,16 +364,16 @@ GetReader(
   status = lpPI->GetSystemParameter(&tmpReader, &addr, &lpData,100);
   if( status != SKYETEK_SUCCESS )
 	{
-	  free(lpReader);
+	  SkyeTek_Free(lpReader);
 	  goto failure;
 	}
 	lpReader->id = (LPSKYETEK_ID)lpData;
   lpReader->internal = &SkyetekReaderImpl;
   lpReader->lpDevice = lpDevice;
-  lpReader->lpProtocol = (LPSKYETEK_PROTOCOL)malloc(sizeof(SKYETEK_PROTOCOL));
+  lpReader->lpProtocol = (LPSKYETEK_PROTOCOL)SkyeTek_Malloc(sizeof(SKYETEK_PROTOCOL));
   if( lpReader->lpProtocol == NULL )
   {
-    free(lpReader);
+    SkyeTek_Free(lpReader);
     goto failure;
   }
   lpReader->lpProtocol->version = ver;
@@ -365,7 +382,7 @@ GetReader(
   str = SkyeTek_GetStringFromID(lpReader->id);
   if( str == NULL )
   {
-    free(lpReader);
+    SkyeTek_Free(lpReader);
     goto failure;
   }
   _tcscpy(lpReader->rid,str);
@@ -374,13 +391,27 @@ GetReader(
   _stprintf(lpReader->friendly, _T("%s-%s-%s"), lpReader->manufacturer, lpReader->model, str);
   SkyeTek_FreeString(str);
 
+  /* Response timeouts follow the reader once it has answered */
+  if( ver == 3 )
+    lpReader->lpResponseTimer = ResponseTimer_Create();
+
   return lpReader;
 failure:
   SkyeTek_FreeID(tmpReader.id);
   return NULL;
 }
 
-static int g_bootloads = 1;
+LPSKYETEK_READER 
+GetReader(
+  LPSKYETEK_DEVICE    lpDevice, 
+  LPPROTOCOLIMPL      lpPI,
+  unsigned int        ver
+  )
+{
+  return GetReaderAt(lpDevice, lpPI, ver, NULL);
+}
+
+static volatile long g_bootloads = 1;
 
 LPSKYETEK_READER 
 GetBootloadReader(
@@ -394,7 +425,7 @@ GetBootloadReader(
   if( lpDevice == NULL )
     return NULL;
 
-  lpReader = (LPSKYETEK_READER)malloc(sizeof(SKYETEK_READER));
+  lpReader = (LPSKYETEK_READER)SkyeTek_Malloc(sizeof(SKYETEK_READER));
   if( lpReader == NULL )
   {
     return NULL;
@@ -407,10 +438,10 @@ GetBootloadReader(
 	lpReader->id = SkyeTek_AllocateID(4);
   lpReader->internal = &SkyetekReaderImpl;
   lpReader->lpDevice = lpDevice;
-  lpReader->lpProtocol = (LPSKYETEK_PROTOCOL)malloc(sizeof(SKYETEK_PROTOCOL));
+  lpReader->lpProtocol = (LPSKYETEK_PROTOCOL)SkyeTek_Malloc(sizeof(SKYETEK_PROTOCOL));
   if( lpReader->lpProtocol == NULL )
   {
-    free(lpReader);
+    SkyeTek_Free(lpReader);
     return NULL;
   }
   lpReader->lpProtocol->version = ver;
@@ -418,7 +449,7 @@ GetBootloadReader(
   _tcscpy(lpReader->manufacturer, _T("SkyeTek"));
   _tcscpy(lpReader->rid, _T("00000000"));
   lpReader->isBootload = 0x01;
-  _stprintf(lpReader->friendly, _T("Bootload-%d"), g_bootloads++);
+  _stprintf(lpReader->friendly, _T("Bootload-%ld"), ATOMIC_ADD(&g_bootloads, 1));
 
   return lpReader;
 }
@@ -481,7 +512,8 @@ SkyetekReaderFactory_DiscoverReaders(
   LPSKYETEK_READER    **readers
   )
 {
-  unsigned int readerCount, ix, iy;
+  unsigned int readerCount, ix, iy, cached;
+  SKYETEK_SERIAL_SETTINGS settings;
   LPSKYETEK_READER lpReader;
   LPDEVICEIMPL lpDI;
   unsigned char found = 0;
@@ -504,13 +536,28 @@ SkyetekReaderFactory_DiscoverReaders(
 		{
       if( _tcscmp(devices[ix]->type,SKYETEK_SERIAL_DEVICE_TYPE) == 0 )
       {
-        for( iy = 0; iy < NUM_SERIAL_DISCOVERY_SETTINGS; iy++ )
+        /* A rate negotiated on an earlier start is tried first */
+        cached = SerialDevice_GetCachedBaud(devices[ix]->address);
+        for( iy = 0; iy <= NUM_SERIAL_DISCOVERY_SETTINGS; iy++ )
         {
-          SkyeTek_Debug(_T("Attempting at baud %d\n"), SerialDiscoverySettings[iy].baudRate);
-          SerialDevice_SetOptions(devices[ix],&SerialDiscoverySettings[iy]);
+          if( iy == 0 )
+          {
+            if( cached == 0 )
+              continue;
+            settings = SerialDiscoverySettings[0];
+            settings.baudRate = cached;
+          }
+          else
+          {
+            settings = SerialDiscoverySettings[iy - 1];
+            if( settings.baudRate == (int)cached )
+              continue;
+          }
+          SkyeTek_Debug(_T("Attempting at baud %d\n"), settings.baudRate);
+          SerialDevice_SetOptions(devices[ix],&settings);
 			    if(SkyetekReaderFactory_CreateReader(devices[ix], &lpReader) == SKYETEK_SUCCESS)
 			    {
-					    *readers = (LPSKYETEK_READER*)realloc(*readers, (readerCount + 1)*sizeof(LPSKYETEK_READER));
+					    *readers = (LPSKYETEK_READER*)SkyeTek_Realloc(*readers, (readerCount + 1)*sizeof(LPSKYETEK_READER));
 					    (*readers)[readerCount] = lpReader;
 					    readerCount++;
               found = 1;
@@ -522,7 +569,7 @@ SkyetekReaderFactory_DiscoverReaders(
       {
 			  if(SkyetekReaderFactory_CreateReader(devices[ix], &lpReader) == SKYETEK_SUCCESS)
 			  {
-					  *readers = (LPSKYETEK_READER*)realloc(*readers, (readerCount + 1)*sizeof(LPSKYETEK_READER));
+					  *readers = (LPSKYETEK_READER*)SkyeTek_Realloc(*readers, (readerCount + 1)*sizeof(LPSKYETEK_READER));
 					  (*readers)[readerCount] = lpReader;
 					  readerCount++;
             found = 1;
@@ -538,6 +585,95 @@ SkyetekReaderFactory_DiscoverReaders(
   return readerCount;
 }
 
+unsigned int 
+SkyetekReaderFactory_DiscoverBusReaders(
+  LPSKYETEK_DEVICE    device, 
+  unsigned int        firstRid, 
+  unsigned int        lastRid, 
+  LPSKYETEK_READER    **readers
+  )
+{
+  unsigned int readerCount = 0, rid, iy, cached = 0, settingCount = 0;
+  SKYETEK_SERIAL_SETTINGS settings;
+  LPSKYETEK_READER lpReader;
+  LPSKYETEK_BUS lpBus;
+  LPSKYETEK_ID lpRid;
+  LPDEVICEIMPL lpDI;
+
+  if( device == NULL || device->internal == NULL || readers == NULL || *readers != NULL )
+    return 0;
+  if( lastRid < firstRid )
+    return 0;
+
+  lpDI = (LPDEVICEIMPL)device->internal;
+  if( lpDI->Open(device) != SKYETEK_SUCCESS )
+    return 0;
+  lpBus = Bus_Create(device);
+  lpRid = SkyeTek_AllocateID(4);
+  if( lpBus == NULL || lpRid == NULL )
+    goto done;
+
+  if( _tcscmp(device->type,SKYETEK_SERIAL_DEVICE_TYPE) == 0 )
+  {
+    cached = SerialDevice_GetCachedBaud(device->address);
+    settingCount = NUM_SERIAL_DISCOVERY_SETTINGS;
+  }
+
+  /* The whole line runs at one rate, so stop at the first rate that finds a reader */
+  for( iy = 0; iy <= settingCount && readerCount == 0; iy++ )
+  {
+    if( settingCount > 0 )
+    {
+      if( iy == 0 )
+      {
+        if( cached == 0 )
+          continue;
+        settings = SerialDiscoverySettings[0];
+        settings.baudRate = cached;
+      }
+      else
+      {
+        settings = SerialDiscoverySettings[iy - 1];
+        if( settings.baudRate == (int)cached )
+          continue;
+      }
+      SkyeTek_Debug(_T("Scanning bus at baud %d\n"), settings.baudRate);
+      SerialDevice_SetOptions(device,&settings);
+    }
+    for( rid = firstRid; ; rid++ )
+    {
+      lpRid->id[0] = (unsigned char)(rid >> 24);
+      lpRid->id[1] = (unsigned char)(rid >> 16);
+      lpRid->id[2] = (unsigned char)(rid >> 8);
+      lpRid->id[3] = (unsigned char)rid;
+      lpReader = GetReaderAt(device, &STPV3Impl, 3, lpRid);
+      if( lpReader != NULL )
+      {
+        lpReader->sendRID = 1;
+        if( Bus_Add(lpBus, lpReader) != SKYETEK_SUCCESS )
+        {
+          SkyetekReaderFactory_FreeReader(lpReader);
+          break;
+        }
+        *readers = (LPSKYETEK_READER*)SkyeTek_Realloc(*readers, (readerCount + 1)*sizeof(LPSKYETEK_READER));
+        (*readers)[readerCount] = lpReader;
+        readerCount++;
+      }
+      if( rid == lastRid )
+        break;
+    }
+  }
+
+done:
+  SkyeTek_FreeID(lpRid);
+  if( readerCount == 0 )
+  {
+    SkyeTek_Free(lpBus);
+    lpDI->Close(device);
+  }
+  return readerCount;
+}
+
 int 
 SkyetekReaderFactory_FreeReader(
   LPSKYETEK_READER lpReader
@@ -547,7 +683,12 @@ SkyetekReaderFactory_FreeReader(
     return 0;
   if( lpReader->internal == &SkyetekReaderImpl )
   {
-    free(lpReader);
+    DuplicateFilter_Free((LPDUPLICATE_FILTER)lpReader->lpDuplicateFilter);
+    Bus_Remove(lpReader);
+    ResponseTimer_Free((LPRESPONSE_TIMER)lpReader->lpResponseTimer);
+    if( lpReader->lpSelectRequest != NULL )
+      SkyeTek_Free(lpReader->lpSelectRequest);
+    SkyeTek_Free(lpReader);
     return 1;
   }
   return 0;
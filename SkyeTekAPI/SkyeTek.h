@@ -0,0 +1,351 @@
+/**
+ * SkyeTek.h
+ *
+ * Header-only C++ facade over the SkyeTek C API. Devices, readers and
+ * tags are move-only owners that free themselves; IDs and data are
+ * passed as non-owning views.
+ *
+ * The select loop takes any callable and calls it with a Read, a value
+ * holding the tag type and an inline copy of the ID. It runs on
+ * SkyeTek_SelectTagIds(), so a read costs no allocation; make a Tag
+ * from a Read only when the tag is to be addressed.
+ *
+ * A reader uses the device it was discovered on; keep the devices
+ * alive as long as their readers.
+ */
+#ifndef SKYETEK_H
+#define SKYETEK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <utility>
+#include <vector>
+#include "SkyeTekAPI.h"
+#include "SkyeTekProtocol.h"
+
+namespace skyetek {
+
+/** Non-owning view of bytes, in the manner of std::span<const uint8_t>. */
+class ByteView {
+public:
+    ByteView() : data_(NULL), size_(0) {}
+    ByteView(const uint8_t *data, size_t size) : data_(data), size_(size) {}
+    template <size_t N> ByteView(const uint8_t (&data)[N]) : data_(data), size_(N) {}
+    ByteView(const std::vector<uint8_t> &data) : data_(data.empty() ? NULL : &data[0]), size_(data.size()) {}
+
+    const uint8_t *data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const uint8_t *begin() const { return data_; }
+    const uint8_t *end() const { return data_ + size_; }
+    uint8_t operator[](size_t ix) const { return data_[ix]; }
+
+    /** Bytes from offset on, at most count of them. */
+    ByteView subview(size_t offset, size_t count = (size_t) -1) const {
+        if (offset > size_)
+            offset = size_;
+        if (count > size_ - offset)
+            count = size_ - offset;
+        return ByteView(data_ + offset, count);
+    }
+
+    bool operator==(const ByteView &other) const {
+        return size_ == other.size_ && (size_ == 0 || memcmp(data_, other.data_, size_) == 0);
+    }
+    bool operator!=(const ByteView &other) const { return !(*this == other); }
+
+private:
+    const uint8_t *data_;
+    size_t size_;
+};
+
+/** Non-owning view of characters, in the manner of std::string_view. */
+class StringView {
+public:
+    StringView() : data_(""), size_(0) {}
+    StringView(const TCHAR *str) : data_(str), size_(_tcslen(str)) {}
+    StringView(const TCHAR *data, size_t size) : data_(data), size_(size) {}
+    StringView(const std::basic_string<TCHAR> &str) : data_(str.data()), size_(str.size()) {}
+
+    const TCHAR *data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const TCHAR *begin() const { return data_; }
+    const TCHAR *end() const { return data_ + size_; }
+    std::basic_string<TCHAR> str() const { return std::basic_string<TCHAR>(data_, size_); }
+
+    bool operator==(const StringView &other) const {
+        return size_ == other.size_ && memcmp(data_, other.data_, size_ * sizeof(TCHAR)) == 0;
+    }
+    bool operator!=(const StringView &other) const { return !(*this == other); }
+
+private:
+    const TCHAR *data_;
+    size_t size_;
+};
+
+/**
+ * One read by value: the tag type and its ID, stored inline. IDs the
+ * SDK would not make a tag of (SKYETEK_MAX_TAG_LENGTH bytes or more)
+ * are kept empty. An empty read stands for a loop timeout.
+ */
+class Read {
+public:
+    static const size_t MaxId = SKYETEK_MAX_TAG_LENGTH - 1;
+
+    Read() : type_(AUTO_DETECT), length_(0) {}
+    Read(SKYETEK_TAGTYPE type, ByteView id) : type_(type), length_(0) {
+        if (id.size() <= MaxId && id.data() != NULL) {
+            length_ = (uint8_t) id.size();
+            memcpy(id_, id.data(), id.size());
+        }
+    }
+
+    SKYETEK_TAGTYPE type() const { return type_; }
+    ByteView id() const { return ByteView(id_, length_); }
+    bool empty() const { return length_ == 0; }
+
+    /** Name of the tag type, formatted into buf; see SkyeTek_FormatTagTypeName(). */
+    const TCHAR *typeName(TCHAR *buf, unsigned int size) const {
+        return SkyeTek_FormatTagTypeName(type_, buf, size);
+    }
+
+    /**
+     * Writes the ID as upper-case hex, the form of SKYETEK_TAG::friendly.
+     * @return characters written, or 0 if buf is too small
+     */
+    size_t friendly(TCHAR *buf, size_t size) const {
+        static const char digits[] = "0123456789ABCDEF";
+        if (size < 2 * (size_t) length_ + 1)
+            return 0;
+        for (size_t ix = 0; ix < length_; ix++) {
+            buf[2 * ix] = (TCHAR) digits[id_[ix] >> 4];
+            buf[2 * ix + 1] = (TCHAR) digits[id_[ix] & 0x0F];
+        }
+        buf[2 * length_] = 0;
+        return 2 * (size_t) length_;
+    }
+
+private:
+    SKYETEK_TAGTYPE type_;
+    uint8_t length_;
+    uint8_t id_[MaxId];
+};
+
+namespace detail {
+
+/** Move-only owner of an SDK object freed by Free. */
+template <class T, void (*Free)(T *)>
+class Handle {
+public:
+    T *get() const { return p_; }
+    T *operator->() const { return p_; }
+    explicit operator bool() const { return p_ != NULL; }
+
+    /** Gives up ownership; the caller frees the object. */
+    T *release() {
+        T *p = p_;
+        p_ = NULL;
+        return p;
+    }
+
+    void reset(T *p = NULL) {
+        if (p_ != NULL && p_ != p)
+            Free(p_);
+        p_ = p;
+    }
+
+protected:
+    Handle() : p_(NULL) {}
+    explicit Handle(T *p) : p_(p) {}
+    Handle(Handle &&other) : p_(other.release()) {}
+    ~Handle() { reset(); }
+
+    Handle &operator=(Handle &&other) {
+        if (this != &other)
+            reset(other.release());
+        return *this;
+    }
+
+private:
+    Handle(const Handle &) = delete;
+    Handle &operator=(const Handle &) = delete;
+
+    T *p_;
+};
+
+template <class F>
+unsigned char SelectIdCallback(SKYETEK_TAGTYPE type, const unsigned char *id, unsigned int length, void *user) {
+    return (*(F *) user)(Read(type, ByteView(id, length))) ? 1 : 0;
+}
+
+}
+
+/**
+ * Runs the select loop of a reader the caller owns, calling fn with
+ * each Read and with an empty Read when the loop times out. The loop
+ * ends when fn returns false. fn is called directly, without type
+ * erasure; it must not throw, the C API cannot unwind.
+ * @param inventory Run in inventory/anti-collision mode
+ * @param loop Keep scanning until fn returns false
+ */
+template <class F>
+SKYETEK_STATUS SelectTags(LPSKYETEK_READER reader, F fn, SKYETEK_TAGTYPE type = AUTO_DETECT,
+                          bool inventory = false, bool loop = true) {
+    return SkyeTek_SelectTagIds(reader, type, detail::SelectIdCallback<F>,
+                                inventory ? 1 : 0, loop ? 1 : 0, &fn);
+}
+
+class Device : public detail::Handle<SKYETEK_DEVICE, SkyeTek_FreeDevice> {
+public:
+    Device() {}
+    explicit Device(LPSKYETEK_DEVICE device) : Handle(device) {}
+    Device(Device &&other) : Handle(std::move(other)) {}
+    Device &operator=(Device &&other) {
+        Handle::operator=(std::move(other));
+        return *this;
+    }
+
+    /** Devices attached to the host that might have readers on them. */
+    static std::vector<Device> discover() {
+        LPSKYETEK_DEVICE *found = NULL;
+        unsigned int count = SkyeTek_DiscoverDevices(&found);
+        std::vector<Device> devices;
+        devices.reserve(count);
+        for (unsigned int ix = 0; ix < count; ix++)
+            devices.push_back(Device(found[ix]));
+        SkyeTek_Free(found);
+        return devices;
+    }
+
+    /** Creates the device on an address, such as a serial port path. */
+    static SKYETEK_STATUS create(const TCHAR *address, Device &device) {
+        LPSKYETEK_DEVICE created = NULL;
+        SKYETEK_STATUS st = SkyeTek_CreateDevice((TCHAR *) address, &created);
+        if (st == SKYETEK_SUCCESS)
+            device.reset(created);
+        return st;
+    }
+
+    StringView friendly() const { return StringView(get()->friendly); }
+    StringView type() const { return StringView(get()->type); }
+    StringView address() const { return StringView(get()->address); }
+};
+
+class Reader : public detail::Handle<SKYETEK_READER, SkyeTek_FreeReader> {
+public:
+    Reader() {}
+    explicit Reader(LPSKYETEK_READER reader) : Handle(reader) {}
+    Reader(Reader &&other) : Handle(std::move(other)) {}
+    Reader &operator=(Reader &&other) {
+        Handle::operator=(std::move(other));
+        return *this;
+    }
+
+    /** Readers found on the devices; the devices must outlive them. */
+    static std::vector<Reader> discover(std::vector<Device> &devices) {
+        std::vector<LPSKYETEK_DEVICE> lpDevices;
+        std::vector<Reader> readers;
+        LPSKYETEK_READER *found = NULL;
+        unsigned int count;
+
+        for (size_t ix = 0; ix < devices.size(); ix++)
+            lpDevices.push_back(devices[ix].get());
+        if (lpDevices.empty())
+            return readers;
+        count = SkyeTek_DiscoverReaders(&lpDevices[0], (unsigned int) lpDevices.size(), &found);
+        readers.reserve(count);
+        for (unsigned int ix = 0; ix < count; ix++)
+            readers.push_back(Reader(found[ix]));
+        SkyeTek_Free(found);
+        return readers;
+    }
+
+    /** Creates the reader of a device, which must outlive it. */
+    static SKYETEK_STATUS create(Device &device, Reader &reader) {
+        LPSKYETEK_READER created = NULL;
+        SKYETEK_STATUS st = SkyeTek_CreateReader(device.get(), &created);
+        if (st == SKYETEK_SUCCESS)
+            reader.reset(created);
+        return st;
+    }
+
+    StringView rid() const { return StringView(get()->rid); }
+    StringView model() const { return StringView(get()->model); }
+    StringView friendly() const { return StringView(get()->friendly); }
+
+    /** See skyetek::SelectTags(). */
+    template <class F>
+    SKYETEK_STATUS select(F fn, SKYETEK_TAGTYPE type = AUTO_DETECT,
+                          bool inventory = false, bool loop = true) {
+        return SelectTags(get(), fn, type, inventory, loop);
+    }
+
+    SKYETEK_STATUS setDuplicateSuppression(unsigned int holdOff) {
+        return SkyeTek_SetDuplicateSuppression(get(), holdOff);
+    }
+
+    SKYETEK_STATUS setResponseTimeoutBounds(unsigned int floor, unsigned int ceiling) {
+        return SkyeTek_SetResponseTimeoutBounds(get(), floor, ceiling);
+    }
+};
+
+class Tag : public detail::Handle<SKYETEK_TAG, SkyeTek_FreeTag> {
+public:
+    Tag() {}
+    explicit Tag(LPSKYETEK_TAG tag) : Handle(tag) {}
+    Tag(Tag &&other) : Handle(std::move(other)) {}
+    Tag &operator=(Tag &&other) {
+        Handle::operator=(std::move(other));
+        return *this;
+    }
+
+    /** Creates the tag of a read, to address it in later commands. */
+    static SKYETEK_STATUS create(const Read &read, Tag &tag) {
+        SKYETEK_ID id = { (unsigned char *) read.id().data(), (unsigned int) read.id().size() };
+        LPSKYETEK_TAG created = NULL;
+        SKYETEK_STATUS st = SkyeTek_CreateTag(read.type(), read.empty() ? NULL : &id, &created);
+        if (st == SKYETEK_SUCCESS)
+            tag.reset(created);
+        return st;
+    }
+
+    SKYETEK_TAGTYPE type() const { return get()->type; }
+    StringView friendly() const { return StringView(get()->friendly); }
+
+    ByteView id() const {
+        if (get()->id == NULL)
+            return ByteView();
+        return ByteView(get()->id->id, get()->id->length);
+    }
+
+    /** Selects the tag in the field of the reader; see SkyeTek_SelectTag(). */
+    SKYETEK_STATUS select(Reader &reader) {
+        return SkyeTek_SelectTag(reader.get(), get());
+    }
+
+    /** Reads blocks of a selected tag and appends them to data. */
+    SKYETEK_STATUS readData(Reader &reader, SKYETEK_ADDRESS address, std::vector<uint8_t> &data,
+                            bool encrypt = false, bool hmac = false) {
+        LPSKYETEK_DATA lpData = NULL;
+        SKYETEK_STATUS st = SkyeTek_ReadTagData(reader.get(), get(), &address,
+                                                encrypt ? 1 : 0, hmac ? 1 : 0, &lpData);
+        if (st == SKYETEK_SUCCESS && lpData != NULL && lpData->data != NULL)
+            data.insert(data.end(), lpData->data, lpData->data + lpData->size);
+        SkyeTek_FreeData(lpData);
+        return st;
+    }
+
+    /** Writes data to blocks of a selected tag. */
+    SKYETEK_STATUS writeData(Reader &reader, SKYETEK_ADDRESS address, ByteView data,
+                             bool encrypt = false, bool hmac = false) {
+        SKYETEK_DATA d = { (unsigned char *) data.data(), (unsigned int) data.size() };
+        return SkyeTek_WriteTagData(reader.get(), get(), &address, encrypt ? 1 : 0, hmac ? 1 : 0, &d);
+    }
+};
+
+}
+
+#endif
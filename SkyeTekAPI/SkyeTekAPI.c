@@ -10,9 +10,12 @@
 #include "Device/SerialDevice.h"
 #include "Reader/ReaderFactory.h"
 #include "Reader/Reader.h"
+#include "Reader/Bus.h"
 #include "Tag/TagFactory.h"
 #include "Tag/Tag.h"
 #include "Protocol/Protocol.h"
+#include "Protocol/DuplicateFilter.h"
+#include "Protocol/ResponseTimer.h"
 #include "Protocol/utils.h"
 #include <stdio.h>
 #include <stdarg.h>
@@ -172,18 +175,209 @@ SkyeTek_FreeTag(
   FreeTagImpl(tag);
 }
 
+static void *
+DefaultMalloc(size_t size, void *user)
+{
+  return malloc(size);
+}
+
+static void *
+DefaultRealloc(void *ptr, size_t size, void *user)
+{
+  return realloc(ptr, size);
+}
+
+static void
+DefaultFree(void *ptr, void *user)
+{
+  free(ptr);
+}
+
+static SKYETEK_ALLOCATOR gAllocator = { DefaultMalloc, DefaultRealloc, DefaultFree, NULL };
+
+static volatile long gAllocations = 0;
+static volatile long gReallocations = 0;
+static volatile long gFrees = 0;
+static volatile long gAllocFailures = 0;
+static volatile long gBytesRequested = 0;
+
+SKYETEK_API SKYETEK_STATUS
+SkyeTek_SetAllocator(
+    LPSKYETEK_ALLOCATOR    lpAllocator
+    )
+{
+  if( lpAllocator == NULL )
+  {
+    gAllocator.Malloc = DefaultMalloc;
+    gAllocator.Realloc = DefaultRealloc;
+    gAllocator.Free = DefaultFree;
+    gAllocator.user = NULL;
+    return SKYETEK_SUCCESS;
+  }
+  if( lpAllocator->Malloc == NULL || lpAllocator->Realloc == NULL || lpAllocator->Free == NULL )
+    return SKYETEK_INVALID_PARAMETER;
+  gAllocator = *lpAllocator;
+  return SKYETEK_SUCCESS;
+}
+
+SKYETEK_API void *
+SkyeTek_Malloc(
+    size_t    size
+    )
+{
+  void *ptr = gAllocator.Malloc(size, gAllocator.user);
+  if( ptr == NULL )
+  {
+    ATOMIC_ADD(&gAllocFailures, 1);
+    return NULL;
+  }
+  ATOMIC_ADD(&gAllocations, 1);
+  ATOMIC_ADD(&gBytesRequested, (long)size);
+  return ptr;
+}
+
+SKYETEK_API void *
+SkyeTek_Realloc(
+    void      *ptr,
+    size_t    size
+    )
+{
+  void *tmp;
+  if( ptr == NULL )
+    return SkyeTek_Malloc(size);
+  if( size == 0 )
+  {
+    SkyeTek_Free(ptr);
+    return NULL;
+  }
+  tmp = gAllocator.Realloc(ptr, size, gAllocator.user);
+  if( tmp == NULL )
+  {
+    ATOMIC_ADD(&gAllocFailures, 1);
+    return NULL;
+  }
+  ATOMIC_ADD(&gReallocations, 1);
+  ATOMIC_ADD(&gBytesRequested, (long)size);
+  return tmp;
+}
+
+SKYETEK_API void
+SkyeTek_Free(
+    void      *ptr
+    )
+{
+  if( ptr == NULL )
+    return;
+  ATOMIC_ADD(&gFrees, 1);
+  gAllocator.Free(ptr, gAllocator.user);
+}
+
+SKYETEK_API size_t
+SkyeTek_GetTagBufferSize(
+    unsigned int    maxTags,
+    unsigned int    idBytes
+    )
+{
+  return maxTags * (sizeof(SKYETEK_TAGTYPE) + sizeof(unsigned int) + sizeof(unsigned char)) + idBytes;
+}
+
+SKYETEK_API SKYETEK_STATUS
+SkyeTek_InitTagBuffer(
+    LPSKYETEK_TAG_BUFFER    lpBuffer,
+    void                    *mem,
+    size_t                  size,
+    unsigned int            maxTags
+    )
+{
+  unsigned char *ptr = (unsigned char *)mem;
+  size_t fixed = SkyeTek_GetTagBufferSize(maxTags, 0);
+
+  if( lpBuffer == NULL || mem == NULL || size < fixed )
+    return SKYETEK_INVALID_PARAMETER;
+
+  /* Widest arrays first so every array stays aligned */
+  lpBuffer->types = (SKYETEK_TAGTYPE *)ptr;
+  ptr += maxTags * sizeof(SKYETEK_TAGTYPE);
+  lpBuffer->idOffsets = (unsigned int *)ptr;
+  ptr += maxTags * sizeof(unsigned int);
+  lpBuffer->idLengths = ptr;
+  ptr += maxTags * sizeof(unsigned char);
+  lpBuffer->ids = ptr;
+  lpBuffer->maxTags = maxTags;
+  lpBuffer->idCapacity = (unsigned int)(size - fixed);
+  lpBuffer->count = 0;
+  lpBuffer->idBytes = 0;
+  lpBuffer->dropped = 0;
+  return SKYETEK_SUCCESS;
+}
+
+SKYETEK_API SKYETEK_STATUS
+SkyeTek_AppendTagBuffer(
+    LPSKYETEK_TAG_BUFFER    lpBuffer,
+    SKYETEK_TAGTYPE         type,
+    unsigned char           *id,
+    unsigned int            length
+    )
+{
+  unsigned int ix;
+  if( lpBuffer == NULL || (id == NULL && length > 0) || length > 0xFF )
+    return SKYETEK_INVALID_PARAMETER;
+  if( lpBuffer->count >= lpBuffer->maxTags ||
+      lpBuffer->idCapacity - lpBuffer->idBytes < length )
+  {
+    lpBuffer->dropped++;
+    return SKYETEK_OUT_OF_MEMORY;
+  }
+  ix = lpBuffer->count++;
+  lpBuffer->types[ix] = type;
+  lpBuffer->idOffsets[ix] = lpBuffer->idBytes;
+  lpBuffer->idLengths[ix] = (unsigned char)length;
+  if( length > 0 )
+    memcpy(lpBuffer->ids + lpBuffer->idBytes, id, length);
+  lpBuffer->idBytes += length;
+  return SKYETEK_SUCCESS;
+}
+
+SKYETEK_API SKYETEK_STATUS
+SkyeTek_GetAllocationStats(
+    LPSKYETEK_ALLOCATION_STATS    lpStats
+    )
+{
+  if( lpStats == NULL )
+    return SKYETEK_INVALID_PARAMETER;
+  lpStats->allocations = (unsigned long)gAllocations;
+  lpStats->reallocations = (unsigned long)gReallocations;
+  lpStats->frees = (unsigned long)gFrees;
+  lpStats->failures = (unsigned long)gAllocFailures;
+  lpStats->outstanding = lpStats->allocations - lpStats->frees;
+  lpStats->bytesRequested = (unsigned long)gBytesRequested;
+  return SKYETEK_SUCCESS;
+}
+
+SKYETEK_API void
+SkyeTek_ResetAllocationStats(
+    void
+    )
+{
+  gAllocations = 0;
+  gReallocations = 0;
+  gFrees = 0;
+  gAllocFailures = 0;
+  gBytesRequested = 0;
+}
+
 SKYETEK_API LPSKYETEK_DATA 
 SkyeTek_AllocateData(
     int size
     )
 {
-  LPSKYETEK_DATA data = (LPSKYETEK_DATA)malloc(sizeof(SKYETEK_DATA));
+  LPSKYETEK_DATA data = (LPSKYETEK_DATA)SkyeTek_Malloc(sizeof(SKYETEK_DATA));
   if( data == NULL )
     return NULL;
   data->size = size;
   data->data = NULL;
   if( size > 0 )
-    data->data = (unsigned char *)malloc(data->size * sizeof(unsigned char));
+    data->data = (unsigned char *)SkyeTek_Malloc(data->size * sizeof(unsigned char));
   if( data->data != NULL )
       memset(data->data,0,data->size*sizeof(unsigned char));
   return data;
@@ -197,10 +391,10 @@ SkyeTek_FreeData(
     if( data == NULL )
         return;
     if( data->data != NULL )
-        free(data->data);
+        SkyeTek_Free(data->data);
     data->data = NULL;
     data->size = 0;
-    free(data);
+    SkyeTek_Free(data);
 }
 
 SKYETEK_API LPSKYETEK_ID 
@@ -208,13 +402,13 @@ SkyeTek_AllocateID(
     int length
     )
 {
-  LPSKYETEK_ID id = (LPSKYETEK_ID)malloc(sizeof(SKYETEK_ID));
+  LPSKYETEK_ID id = (LPSKYETEK_ID)SkyeTek_Malloc(sizeof(SKYETEK_ID));
   if( id == NULL )
     return NULL;
   id->length = length;
   id->id = NULL;
   if( length > 0 )
-    id->id = (unsigned char *)malloc(id->length * sizeof(unsigned char));
+    id->id = (unsigned char *)SkyeTek_Malloc(id->length * sizeof(unsigned char));
   if( id->id != NULL )
       memset(id->id,0,id->length*sizeof(unsigned char));
   return id;
@@ -228,10 +422,10 @@ SkyeTek_FreeID(
     if( id == NULL )
         return;
     if( id->id != NULL )
-        free(id->id);
+        SkyeTek_Free(id->id);
     id->id = NULL;
     id->length = 0;
-    free(id);
+    SkyeTek_Free(id);
 }
 
 SKYETEK_API LPSKYETEK_STRING 
@@ -244,7 +438,7 @@ SkyeTek_AllocateString(
 	if(size == 0)
 		return NULL;
     
-	str = (TCHAR *)malloc(size * sizeof(TCHAR));
+	str = (TCHAR *)SkyeTek_Malloc(size * sizeof(TCHAR));
     
 	if(str != NULL)
         memset(str, 0, size*sizeof(TCHAR));
@@ -260,7 +454,7 @@ SkyeTek_FreeString(
     if(str == NULL)
         return;
 
-    free(str);
+    SkyeTek_Free(str);
 }
 
 SKYETEK_API LPSKYETEK_STRING 
@@ -388,6 +582,175 @@ SkyeTek_SelectTags(
   return lpri->SelectTags(lpReader,tagType,callback,inv,loop,user);
 }
 
+SKYETEK_API SKYETEK_STATUS 
+SkyeTek_SelectTagIds(
+    LPSKYETEK_READER            lpReader, 
+    SKYETEK_TAGTYPE             tagType, 
+    SKYETEK_TAG_ID_CALLBACK     callback, 
+    unsigned char               inv, 
+    unsigned char               loop, 
+    void                        *user
+    )
+{
+  LPREADER_IMPL lpri;
+  if( lpReader == NULL || lpReader->internal == NULL )
+    return SKYETEK_INVALID_PARAMETER;
+  lpri = (LPREADER_IMPL)lpReader->internal;
+  return lpri->SelectTagIds(lpReader,tagType,callback,inv,loop,user);
+}
+
+SKYETEK_API SKYETEK_STATUS 
+SkyeTek_SetDuplicateSuppression(
+    LPSKYETEK_READER   lpReader, 
+    unsigned int       holdOff
+    )
+{
+  LPDUPLICATE_FILTER lpFilter;
+  if( lpReader == NULL )
+    return SKYETEK_INVALID_PARAMETER;
+
+  lpFilter = (LPDUPLICATE_FILTER)lpReader->lpDuplicateFilter;
+  if( holdOff == 0 )
+  {
+    DuplicateFilter_Free(lpFilter);
+    lpReader->lpDuplicateFilter = NULL;
+    return SKYETEK_SUCCESS;
+  }
+  if( lpFilter == NULL )
+  {
+    lpFilter = DuplicateFilter_Create(holdOff);
+    if( lpFilter == NULL )
+      return SKYETEK_OUT_OF_MEMORY;
+    lpReader->lpDuplicateFilter = lpFilter;
+  }
+  lpFilter->holdOff = holdOff;
+  return SKYETEK_SUCCESS;
+}
+
+SKYETEK_API SKYETEK_STATUS 
+SkyeTek_SetTagFilter(
+    LPSKYETEK_READER              lpReader, 
+    SKYETEK_TAG_FILTER_CALLBACK   callback, 
+    void                          *user
+    )
+{
+  if( lpReader == NULL )
+    return SKYETEK_INVALID_PARAMETER;
+  lpReader->tagFilter = callback;
+  lpReader->tagFilterUser = user;
+  return SKYETEK_SUCCESS;
+}
+
+SKYETEK_API SKYETEK_STATUS 
+SkyeTek_SetResponseTimeoutBounds(
+    LPSKYETEK_READER   lpReader, 
+    unsigned int       floor, 
+    unsigned int       ceiling
+    )
+{
+  LPRESPONSE_TIMER lpTimer;
+  if( lpReader == NULL || lpReader->lpResponseTimer == NULL )
+    return SKYETEK_INVALID_PARAMETER;
+  if( ceiling != 0 && ceiling < floor )
+    return SKYETEK_INVALID_PARAMETER;
+  lpTimer = (LPRESPONSE_TIMER)lpReader->lpResponseTimer;
+  lpTimer->floor = floor;
+  lpTimer->ceiling = ceiling;
+  return SKYETEK_SUCCESS;
+}
+
+SKYETEK_API SKYETEK_STATUS 
+SkyeTek_GetResponseTimes(
+    LPSKYETEK_READER          lpReader, 
+    LPSKYETEK_RESPONSE_TIME   lpTimes, 
+    unsigned int              max, 
+    unsigned int              *count
+    )
+{
+  LPRESPONSE_TIMER lpTimer;
+  LPRESPONSE_TIME lpTime;
+  unsigned int ix;
+  if( lpReader == NULL || lpTimes == NULL || count == NULL )
+    return SKYETEK_INVALID_PARAMETER;
+  *count = 0;
+  lpTimer = (LPRESPONSE_TIMER)lpReader->lpResponseTimer;
+  if( lpTimer == NULL )
+    return SKYETEK_SUCCESS;
+  for( ix = 0; ix < RESPONSE_TIMER_SLOTS && *count < max; ix++ )
+  {
+    lpTime = &lpTimer->entries[ix];
+    if( !lpTime->used || lpTime->samples == 0 )
+      continue;
+    lpTimes[*count].command = lpTime->key;
+    lpTimes[*count].samples = lpTime->samples;
+    lpTimes[*count].srtt = lpTime->srtt >> 3;
+    lpTimes[*count].rttvar = lpTime->rttvar >> 2;
+    lpTimes[*count].timeout = ResponseTimer_Timeout(lpTimer, lpTime->key, 1, 0);
+    (*count)++;
+  }
+  return SKYETEK_SUCCESS;
+}
+
+SKYETEK_API unsigned int 
+SkyeTek_DiscoverBusReaders(
+    LPSKYETEK_DEVICE     lpDevice, 
+    unsigned int         firstRid, 
+    unsigned int         lastRid, 
+    LPSKYETEK_READER     **lpReaders
+    )
+{
+  if( lpDevice == NULL || lpReaders == NULL )
+    return 0;
+  return SkyetekReaderFactory_DiscoverBusReaders(lpDevice,firstRid,lastRid,lpReaders);
+}
+
+SKYETEK_API SKYETEK_STATUS 
+SkyeTek_SetBusWeight(
+    LPSKYETEK_READER   lpReader, 
+    unsigned int       weight
+    )
+{
+  LPSKYETEK_BUS lpBus;
+  unsigned int ix;
+  if( lpReader == NULL || lpReader->lpBus == NULL || weight == 0 )
+    return SKYETEK_INVALID_PARAMETER;
+  lpBus = (LPSKYETEK_BUS)lpReader->lpBus;
+  for( ix = 0; ix < lpBus->count; ix++ )
+  {
+    if( lpBus->members[ix].lpReader == lpReader )
+      lpBus->members[ix].weight = weight;
+  }
+  return SKYETEK_SUCCESS;
+}
+
+SKYETEK_API SKYETEK_STATUS 
+SkyeTek_SelectTagsOnBus(
+    LPSKYETEK_READER            *lpReaders, 
+    unsigned int                count, 
+    SKYETEK_TAGTYPE             tagType, 
+    LPSKYETEK_BUS_SETTINGS      lpSettings, 
+    SKYETEK_BUS_TAG_CALLBACK    callback, 
+    void                        *user
+    )
+{
+  return Bus_SelectTags(lpReaders,count,tagType,lpSettings,callback,user);
+}
+
+SKYETEK_API SKYETEK_STATUS 
+SkyeTek_GetSuppressedCount(
+    LPSKYETEK_READER   lpReader, 
+    unsigned long      *suppressed
+    )
+{
+  if( lpReader == NULL || suppressed == NULL )
+    return SKYETEK_INVALID_PARAMETER;
+  if( lpReader->lpDuplicateFilter == NULL )
+    *suppressed = 0;
+  else
+    *suppressed = ((LPDUPLICATE_FILTER)lpReader->lpDuplicateFilter)->suppressed;
+  return SKYETEK_SUCCESS;
+}
+
 SKYETEK_API SKYETEK_STATUS 
 SkyeTek_GetTags(
     LPSKYETEK_READER   lpReader, 
@@ -420,6 +783,20 @@ SkyeTek_GetTagsWithMask(
   return lpri->GetTagsWithMask(lpReader,tagType,lpTagIdMask,lpTags,count);
 }
 
+SKYETEK_API SKYETEK_STATUS 
+SkyeTek_GetTagsInto(
+    LPSKYETEK_READER       lpReader, 
+    SKYETEK_TAGTYPE        tagType, 
+    LPSKYETEK_TAG_BUFFER   lpBuffer
+    )
+{
+  LPREADER_IMPL lpri;
+  if( lpReader == NULL || lpReader->internal == NULL || lpBuffer == NULL )
+    return SKYETEK_INVALID_PARAMETER;
+  lpri = (LPREADER_IMPL)lpReader->internal;
+  return lpri->GetTagsInto(lpReader,tagType,lpBuffer);
+}
+
 SKYETEK_API SKYETEK_STATUS 
 SkyeTek_FreeTags(
     LPSKYETEK_READER  lpReader,
@@ -1782,6 +2159,7 @@ SkyeTek_GetStatusMessage(
 }
 
 SKYETEK_DEBUG_CALLBACK gDebugger = NULL;
+static THREAD_LOCAL SKYETEK_DEBUG_CALLBACK gThreadDebugger = NULL;
 SKYETEK_API void 
 SkyeTek_SetDebugger(
   SKYETEK_DEBUG_CALLBACK callback
@@ -1793,6 +2171,20 @@ SkyeTek_SetDebugger(
 		gDebugger = callback;
 }
 
+SKYETEK_API void 
+SkyeTek_SetThreadDebugger(
+  SKYETEK_DEBUG_CALLBACK callback
+  )
+{
+	gThreadDebugger = callback;
+}
+
+unsigned char 
+SkyeTek_IsDebugging(void)
+{
+	return gThreadDebugger != NULL || gDebugger != NULL;
+}
+
 void 
 SkyeTek_Debug(
   TCHAR * sz, 
@@ -1801,8 +2193,10 @@ SkyeTek_Debug(
 {
 	TCHAR gDbgMsg[2048];
 	va_list args; 
+	SKYETEK_DEBUG_CALLBACK debugger;
 
-	if( gDebugger == NULL ) 
+	debugger = gThreadDebugger != NULL ? gThreadDebugger : gDebugger;
+	if( debugger == NULL ) 
 		return;
 	if( sz == NULL ) 
 		return;
@@ -1810,7 +2204,7 @@ SkyeTek_Debug(
 	va_start( args, sz );
 	_vsntprintf(gDbgMsg, 2047, sz, args); 
 	va_end( args );
-	gDebugger(gDbgMsg);
+	debugger(gDbgMsg);
 }
 
 /********************************************************************************
@@ -1913,6 +2307,153 @@ SkyeTek_GetSerialOptions(
   return SerialDevice_GetOptions(device,lpSettings);
 }
 
+/* Time the reader takes to switch after answering SYS_BAUD */
+#define SERIAL_SWITCH_DELAY 50
+
+/* True if the reader answers with its own RID */
+static unsigned char 
+SerialLinkWorks(
+  LPSKYETEK_READER            lpReader
+  )
+{
+  LPSKYETEK_DATA lpData = NULL;
+  unsigned char works;
+
+  if( SkyeTek_GetSystemParameter(lpReader, SYS_RID, &lpData) != SKYETEK_SUCCESS || lpData == NULL )
+    return 0;
+  works = lpReader->id == NULL ||
+    (lpData->size == lpReader->id->length && memcmp(lpData->data, lpReader->id->id, lpData->size) == 0);
+  SkyeTek_FreeData(lpData);
+  return works;
+}
+
+typedef struct SERIAL_BAUD_CODE
+{
+  unsigned int    baudRate;
+  unsigned char   code;       /* SYS_BAUD value */
+} SERIAL_BAUD_CODE;
+
+/* Rates a reader can be switched to with SYS_BAUD, slowest first */
+static const SERIAL_BAUD_CODE SerialBaudCodes [] = {
+  {9600, 0x00},
+  {19200, 0x01},
+  {38400, 0x02},
+  {57600, 0x03},
+  {115200, 0x04}
+};
+
+#define NUM_SERIAL_BAUD_CODES (sizeof(SerialBaudCodes)/sizeof(SERIAL_BAUD_CODE))
+
+/* Sets the reader to baudRate at whatever rate it answers now */
+static SKYETEK_STATUS 
+SetReaderBaud(
+  LPSKYETEK_READER            lpReader, 
+  unsigned int                baudRate
+  )
+{
+  LPSKYETEK_DATA lpData;
+  SKYETEK_STATUS st;
+  unsigned int ix;
+
+  for( ix = 0; ix < NUM_SERIAL_BAUD_CODES; ix++ )
+  {
+    if( SerialBaudCodes[ix].baudRate == baudRate )
+      break;
+  }
+  if( ix == NUM_SERIAL_BAUD_CODES )
+    return SKYETEK_INVALID_PARAMETER;
+  if( (lpData = SkyeTek_AllocateData(1)) == NULL )
+    return SKYETEK_OUT_OF_MEMORY;
+  lpData->data[0] = SerialBaudCodes[ix].code;
+  /* The reader answers at the old rate, then switches */
+  st = SkyeTek_SetSystemParameter(lpReader, SYS_BAUD, lpData);
+  SkyeTek_FreeData(lpData);
+  if( st == SKYETEK_SUCCESS )
+    SKYETEK_Sleep(SERIAL_SWITCH_DELAY);
+  return st;
+}
+
+SKYETEK_API SKYETEK_STATUS 
+SkyeTek_UpshiftSerialBaud(
+  LPSKYETEK_READER            lpReader, 
+  unsigned int                maxBaud,
+  unsigned int                *lpBaud
+  )
+{
+  SKYETEK_SERIAL_SETTINGS original, settings;
+  LPSKYETEK_DEVICE lpDevice;
+  SKYETEK_STATUS st;
+  int ix;
+  unsigned int iy;
+
+  if( lpReader == NULL || lpReader->lpDevice == NULL || lpReader->isBootload )
+    return SKYETEK_INVALID_PARAMETER;
+  lpDevice = lpReader->lpDevice;
+  if( _tcscmp(lpDevice->type, SKYETEK_SERIAL_DEVICE_TYPE) != 0 )
+    return SKYETEK_INVALID_PARAMETER;
+  if( (st = SerialDevice_GetOptions(lpDevice, &original)) != SKYETEK_SUCCESS )
+    return st;
+  if( lpBaud != NULL )
+    *lpBaud = original.baudRate;
+
+  for( ix = NUM_SERIAL_BAUD_CODES - 1; ix >= 0; ix-- )
+  {
+    settings = original;
+    settings.baudRate = SerialBaudCodes[ix].baudRate;
+    if( settings.baudRate <= original.baudRate )
+      break;
+    if( maxBaud != 0 && (unsigned int)settings.baudRate > maxBaud )
+      continue;
+    /* Refused: the reader does not do this rate and stays where it is */
+    if( SetReaderBaud(lpReader, settings.baudRate) != SKYETEK_SUCCESS )
+      continue;
+    if( SerialDevice_SetOptions(lpDevice, &settings) == SKYETEK_SUCCESS && SerialLinkWorks(lpReader) )
+    {
+      SkyeTek_Debug(_T("Serial link moved to baud %d\n"), settings.baudRate);
+      SerialDevice_SetCachedBaud(lpDevice->address, settings.baudRate);
+      if( lpBaud != NULL )
+        *lpBaud = settings.baudRate;
+      return SKYETEK_SUCCESS;
+    }
+    SkyeTek_Debug(_T("Serial link does not work at baud %d, falling back\n"), settings.baudRate);
+
+    /* Perhaps the reader never switched */
+    SerialDevice_SetOptions(lpDevice, &original);
+    if( SerialLinkWorks(lpReader) )
+      continue;
+    /* It did, but the link is unusable: find the reader and move it back */
+    for( iy = 0; iy < NUM_SERIAL_DISCOVERY_SETTINGS; iy++ )
+    {
+      settings = original;
+      settings.baudRate = SerialDiscoverySettings[iy].baudRate;
+      if( SerialDevice_SetOptions(lpDevice, &settings) != SKYETEK_SUCCESS || !SerialLinkWorks(lpReader) )
+        continue;
+      /* If it refuses, stay at the rate that was found */
+      if( SetReaderBaud(lpReader, original.baudRate) == SKYETEK_SUCCESS )
+      {
+        settings = original;
+        SerialDevice_SetOptions(lpDevice, &settings);
+        if( !SerialLinkWorks(lpReader) )
+          return SKYETEK_READER_IO_ERROR;
+      }
+      SerialDevice_SetCachedBaud(lpDevice->address, settings.baudRate);
+      if( lpBaud != NULL )
+        *lpBaud = settings.baudRate;
+      return SKYETEK_SUCCESS;
+    }
+    return SKYETEK_READER_IO_ERROR;
+  }
+  return SKYETEK_SUCCESS;
+}
+
+SKYETEK_API void 
+SkyeTek_SetSerialBaudCache(
+  const TCHAR                 *path
+  )
+{
+  SerialDevice_SetBaudCache(path);
+}
+
 
 /********************************************************************************
  * System Parameter Information for both STPV2 and STPV3
@@ -458,6 +458,7 @@ typedef struct SKYETEK_DEVICE
   unsigned int          major;
   SKYETEK_DEVICE_FILE   readFD;
   SKYETEK_DEVICE_FILE   writeFD;
+  void                  *transport;   /* per-device state of the implementation */
   void                  *user;
   void                  *internal;
 } SKYETEK_DEVICE, *LPSKYETEK_DEVICE;
@@ -470,6 +471,25 @@ typedef struct SERIAL_SETTINGS
   SKYETEK_STOPBITS  stopBits;
 } SKYETEK_SERIAL_SETTINGS, *LPSKYETEK_SERIAL_SETTINGS;
 
+typedef struct BUS_SETTINGS
+{
+  unsigned int      dwell;        /* ms of inventory per turn, times the reader's weight */
+  unsigned int      idleDwell;    /* ms per turn after a turn without tags, 0 for dwell */
+} SKYETEK_BUS_SETTINGS, *LPSKYETEK_BUS_SETTINGS;
+
+typedef struct RESPONSE_TIME_INFO
+{
+  unsigned int      command;      /* command code, mode flags in the upper 16 bits */
+  unsigned int      samples;      /* answers timed */
+  unsigned int      srtt;         /* smoothed round trip in ms, per block for tag data */
+  unsigned int      rttvar;       /* mean deviation in ms */
+  unsigned int      timeout;      /* timeout of the next request of one block */
+} SKYETEK_RESPONSE_TIME, *LPSKYETEK_RESPONSE_TIME;
+
+/* Mode flags of SKYETEK_RESPONSE_TIME.command */
+#define SKYETEK_RESPONSE_LOOP         0x00010000
+#define SKYETEK_RESPONSE_INVENTORY    0x00020000
+
 typedef struct SKYETEK_READER
 {
   LPSKYETEK_ID              id;
@@ -484,6 +504,12 @@ typedef struct SKYETEK_READER
   unsigned char             sendRID;
   LPSKYETEK_PROTOCOL        lpProtocol;
   LPSKYETEK_DEVICE          lpDevice;
+  void                      *lpDuplicateFilter;
+  void                      *lpBus;
+  void                      *lpResponseTimer;
+  void                      *lpSelectRequest;
+  unsigned char             (*tagFilter)(SKYETEK_TAGTYPE, const unsigned char *, unsigned int, void *);
+  void                      *tagFilterUser;
   void                      *user;
   void                      *internal;
 } SKYETEK_READER, *LPSKYETEK_READER;
@@ -624,6 +650,34 @@ typedef struct SKYETEK_TRACK1
 	char                   serviceCode[3+1];
 } SKYETEK_TRACK1, *LPSKYETEK_TRACK1;
 
+typedef struct SKYETEK_ALLOCATION_STATS
+{
+  unsigned long          allocations;
+  unsigned long          reallocations;
+  unsigned long          frees;
+  unsigned long          failures;
+  unsigned long          outstanding;
+  unsigned long          bytesRequested;
+} SKYETEK_ALLOCATION_STATS, *LPSKYETEK_ALLOCATION_STATS;
+
+/**
+ * Inventory results stored as parallel arrays carved out of one
+ * caller-owned block by SkyeTek_InitTagBuffer(). The ID of tag ix
+ * is ids[idOffsets[ix]] through ids[idOffsets[ix]+idLengths[ix]-1].
+ */
+typedef struct SKYETEK_TAG_BUFFER
+{
+  SKYETEK_TAGTYPE        *types;
+  unsigned int           *idOffsets;
+  unsigned char          *idLengths;
+  unsigned char          *ids;
+  unsigned int           maxTags;
+  unsigned int           idCapacity;
+  unsigned int           count;
+  unsigned int           idBytes;
+  unsigned int           dropped;
+} SKYETEK_TAG_BUFFER, *LPSKYETEK_TAG_BUFFER;
+
 
 /****************************************************
  * CALLBACKS 
@@ -641,6 +695,55 @@ typedef unsigned char
     void            *user
     );
 
+/**
+ * Tag filter callback used by inventory and loop modes. Called with
+ * the raw ID of every read before anything is allocated for it.
+ * @param type Tag type reported by the reader
+ * @param id ID bytes
+ * @param length Number of ID bytes
+ * @param user User data passed to SkyeTek_SetTagFilter()
+ * @return 1 to deliver the read, 0 to drop it
+ */
+typedef unsigned char 
+(*SKYETEK_TAG_FILTER_CALLBACK)(
+    SKYETEK_TAGTYPE        type, 
+    const unsigned char    *id, 
+    unsigned int           length, 
+    void                   *user
+    );
+
+/**
+ * Tag read callback used by SkyeTek_SelectTagIds(). Gets the raw ID
+ * of every read; nothing is allocated for it, so the ID is only valid
+ * during the call.
+ * @param type Tag type reported by the reader
+ * @param id ID bytes, NULL when a loop timed out without a read
+ * @param length Number of ID bytes
+ * @param user User data
+ * @return 0 to stop inventory/loop, 1 to continue
+ */
+typedef unsigned char 
+(*SKYETEK_TAG_ID_CALLBACK)(
+    SKYETEK_TAGTYPE        type, 
+    const unsigned char    *id, 
+    unsigned int           length, 
+    void                   *user
+    );
+
+/**
+ * Tag select callback used on a multi-drop bus
+ * @param lpReader Reader that made the read
+ * @param lpTag Tag selected, NULL when a turn timed out
+ * @param user User data
+ * @return 0 to stop the bus, 1 to continue
+ */ 
+typedef unsigned char 
+(*SKYETEK_BUS_TAG_CALLBACK)(
+    LPSKYETEK_READER lpReader, 
+    LPSKYETEK_TAG    lpTag, 
+    void            *user
+    );
+
 /**
  * Firmware upload callback. Called everytime a block is successfully written.
  * @param percentComplete Percent of upload completed
@@ -678,6 +781,51 @@ typedef void
     TCHAR *msg
     );
 
+/**
+ * Allocation callback. Called by API for every heap allocation.
+ * @param size Number of bytes to allocate
+ * @param user User data from SKYETEK_ALLOCATOR
+ * @return Allocated block or NULL on failure
+ */
+typedef void *
+(*SKYETEK_MALLOC_CALLBACK)(
+    size_t   size,
+    void     *user
+    );
+
+/**
+ * Reallocation callback. Called by API to grow or shrink a block.
+ * @param ptr Block previously returned by the allocator, never NULL
+ * @param size New size in bytes, never 0
+ * @param user User data from SKYETEK_ALLOCATOR
+ * @return Resized block or NULL on failure, in which case ptr is untouched
+ */
+typedef void *
+(*SKYETEK_REALLOC_CALLBACK)(
+    void     *ptr,
+    size_t   size,
+    void     *user
+    );
+
+/**
+ * Free callback. Called by API to release a block.
+ * @param ptr Block previously returned by the allocator, never NULL
+ * @param user User data from SKYETEK_ALLOCATOR
+ */
+typedef void
+(*SKYETEK_FREE_CALLBACK)(
+    void     *ptr,
+    void     *user
+    );
+
+typedef struct SKYETEK_ALLOCATOR
+{
+  SKYETEK_MALLOC_CALLBACK     Malloc;
+  SKYETEK_REALLOC_CALLBACK    Realloc;
+  SKYETEK_FREE_CALLBACK       Free;
+  void                        *user;
+} SKYETEK_ALLOCATOR, *LPSKYETEK_ALLOCATOR;
+
 
 /****************************************************
  * DEVICE FUNCTIONS
@@ -730,7 +878,8 @@ SkyeTek_FreeDevice(
  * This sets an additional timeout to be added to all
  * API calls made on this device. Some devices are slower
  * than others. If the API calls report SKYETEK_TIMEOUT
- * this may be called to increase the timeout.
+ * this may be called to increase the timeout. Other
+ * devices keep their own timeout.
  * @param lpDevice Device to set additional timeout on
  * @param timeout Timeout in milliseconds to add
  * @return Status
@@ -779,6 +928,35 @@ SkyeTek_GetSerialOptions(
   LPSKYETEK_SERIAL_SETTINGS   lpSettings
   );
 
+/** 
+ * Moves the link to a serial reader to the fastest baud rate the
+ * reader accepts for SYS_BAUD, up to maxBaud. Each rate is checked by
+ * reading the reader's RID back; a rate that fails is undone and the
+ * next slower one tried. The rate is only set until the reader is
+ * power cycled. Only call this while no select loop is running on
+ * the reader.
+ * @param lpReader Reader on a serial device
+ * @param maxBaud Highest rate to try, 0 for no limit
+ * @param lpBaud Receives the rate the link runs at afterwards; may be NULL
+ * @return SKYETEK_SUCCESS if the reader answers at *lpBaud
+ */
+SKYETEK_API SKYETEK_STATUS 
+SkyeTek_UpshiftSerialBaud(
+  LPSKYETEK_READER            lpReader, 
+  unsigned int                maxBaud,
+  unsigned int                *lpBaud
+  );
+
+/** 
+ * Sets a file in which SkyeTek_UpshiftSerialBaud() remembers the rate
+ * of each port, so that discovery tries it first on the next start.
+ * @param path File path, or NULL to stop remembering
+ */
+SKYETEK_API void 
+SkyeTek_SetSerialBaudCache(
+  const TCHAR                 *path
+  );
+
 
 /****************************************************
  * READER FUNCTIONS
@@ -852,6 +1030,160 @@ SkyeTek_SelectTags(
     void                        *user
     );
 
+/** 
+ * Exercises the reader in select mode like SkyeTek_SelectTags(), but
+ * hands the callback the raw ID of each read instead of a tag, so that
+ * a read costs no allocation. Tag filter and duplicate suppression
+ * apply as they do to SkyeTek_SelectTags().
+ * @param lpReader Reader to execute this command on.
+ * @param tagType Select only a specific tag type. 
+ * @param callback Function to call with every read; its return decides
+ * when this call completes in loop mode (0 to stop, 1 to continue)
+ * @param inv true(1) indicates the reader should run in inventory/anti-collision mode
+ * @param loop Run reader in loop mode
+ * @param user User data to pass to callback along with the ID
+ */
+SKYETEK_API SKYETEK_STATUS 
+SkyeTek_SelectTagIds(
+    LPSKYETEK_READER            lpReader, 
+    SKYETEK_TAGTYPE             tagType, 
+    SKYETEK_TAG_ID_CALLBACK     callback, 
+    unsigned char               inv, 
+    unsigned char               loop, 
+    void                        *user
+    );
+
+/** 
+ * Enables suppression of repeated reads in select and loop modes.
+ * A tag that was reported is not reported again, and costs no
+ * allocation or callback, until holdOff milliseconds have passed.
+ * Only call this while no select loop is running on the reader.
+ * @param lpReader Reader to configure
+ * @param holdOff Hold-off time in milliseconds; 0 disables suppression
+ */
+SKYETEK_API SKYETEK_STATUS 
+SkyeTek_SetDuplicateSuppression(
+    LPSKYETEK_READER   lpReader, 
+    unsigned int       holdOff
+    );
+
+/** 
+ * Installs a filter that decides which reads select and loop modes
+ * deliver. Reads it rejects cost no allocation, duplicate suppression
+ * or select callback. Only call this while no select loop is running
+ * on the reader.
+ * @param lpReader Reader to configure
+ * @param callback Filter to call, or NULL to deliver every read
+ * @param user User data passed to the filter
+ */
+SKYETEK_API SKYETEK_STATUS 
+SkyeTek_SetTagFilter(
+    LPSKYETEK_READER              lpReader, 
+    SKYETEK_TAG_FILTER_CALLBACK   callback, 
+    void                          *user
+    );
+
+/**
+ * Discovers the readers sharing a multi-drop (RS-485) device by
+ * addressing every RID in a range. Each RID that does not answer costs
+ * one request timeout, so keep the range short. The readers found
+ * share one bus and are scheduled with SkyeTek_SelectTagsOnBus().
+ * @param lpDevice Device the readers share
+ * @param firstRid First RID to try
+ * @param lastRid Last RID to try
+ * @param lpReaders Pointer to array to popluate.  This function will allocate memory.
+ * @return Number of readers found (size of readers array) 
+ */
+SKYETEK_API unsigned int 
+SkyeTek_DiscoverBusReaders(
+    LPSKYETEK_DEVICE     lpDevice, 
+    unsigned int         firstRid, 
+    unsigned int         lastRid, 
+    LPSKYETEK_READER     **lpReaders
+    );
+
+/** 
+ * Sets the share of inventory time a reader gets on its bus.
+ * Only call this while no bus is running.
+ * @param lpReader Reader on a bus
+ * @param weight Relative share, 1 by default
+ */
+SKYETEK_API SKYETEK_STATUS 
+SkyeTek_SetBusWeight(
+    LPSKYETEK_READER   lpReader, 
+    unsigned int       weight
+    );
+
+/** 
+ * Time-slices inventory across the readers of one bus. Each turn gives
+ * a reader dwell times its weight milliseconds of inventory rounds;
+ * time a round overruns is taken from the reader's next turn, so over
+ * many turns every reader gets its share. A reader that found nothing
+ * in its last turn gets idleDwell instead. Reads are routed by the RID
+ * they carry, so a late answer still reaches the right reader. Does
+ * not return until the callback returns 0.
+ * @param lpReaders Readers to schedule; all from one SkyeTek_DiscoverBusReaders()
+ * @param count Number of readers
+ * @param tagType Select only a specific tag type
+ * @param lpSettings Dwell settings
+ * @param callback Function to call with every read
+ * @param user User data to pass to callback along with tag
+ */
+SKYETEK_API SKYETEK_STATUS 
+SkyeTek_SelectTagsOnBus(
+    LPSKYETEK_READER            *lpReaders, 
+    unsigned int                count, 
+    SKYETEK_TAGTYPE             tagType, 
+    LPSKYETEK_BUS_SETTINGS      lpSettings, 
+    SKYETEK_BUS_TAG_CALLBACK    callback, 
+    void                        *user
+    );
+
+/** 
+ * Sets the bounds of the response timeouts of an STPv3 reader. The
+ * reader times the first answer to every command and then waits for
+ * it as long as the smoothed round trip plus four mean deviations,
+ * doubled after each timeout, but at least floor and at most ceiling
+ * milliseconds. Until a command has been answered once, the fixed
+ * timeout of the call is used. Only call this while no select loop is
+ * running on the reader.
+ * @param lpReader Reader to configure
+ * @param floor Shortest timeout in milliseconds (default 100)
+ * @param ceiling Longest timeout in milliseconds (default 10000); 0 for fixed timeouts only
+ */
+SKYETEK_API SKYETEK_STATUS 
+SkyeTek_SetResponseTimeoutBounds(
+    LPSKYETEK_READER   lpReader, 
+    unsigned int       floor, 
+    unsigned int       ceiling
+    );
+
+/** 
+ * Gets the response time estimates of a reader, one per command and mode.
+ * @param lpReader Reader to query
+ * @param lpTimes Array to fill
+ * @param max Size of the array
+ * @param count Receives the number of entries filled
+ */
+SKYETEK_API SKYETEK_STATUS 
+SkyeTek_GetResponseTimes(
+    LPSKYETEK_READER          lpReader, 
+    LPSKYETEK_RESPONSE_TIME   lpTimes, 
+    unsigned int              max, 
+    unsigned int              *count
+    );
+
+/** 
+ * Gets the number of reads dropped by duplicate suppression.
+ * @param lpReader Reader to query
+ * @param suppressed Receives the number of reads dropped
+ */
+SKYETEK_API SKYETEK_STATUS 
+SkyeTek_GetSuppressedCount(
+    LPSKYETEK_READER   lpReader, 
+    unsigned long      *suppressed
+    );
+
 /** 
  * Gets the list of tags that the reader has detected. 
  * @param lpReader Reader to execute this command on.
@@ -888,6 +1220,23 @@ SkyeTek_GetTagsWithMask(
     unsigned short     *count
     );
 
+/** 
+ * Gets the list of tags that the reader has detected without
+ * allocating any memory. Types, ID lengths and ID bytes are written
+ * into the buffer prepared by SkyeTek_InitTagBuffer(); previous
+ * contents are discarded. Tags that do not fit are counted in
+ * lpBuffer->dropped.
+ * @param lpReader Reader to execute this command on.
+ * @param tagType Select only a specific tag type. 
+ * @param lpBuffer Buffer to fill with the tags
+ */
+SKYETEK_API SKYETEK_STATUS 
+SkyeTek_GetTagsInto(
+    LPSKYETEK_READER       lpReader, 
+    SKYETEK_TAGTYPE        tagType, 
+    LPSKYETEK_TAG_BUFFER   lpBuffer
+    );
+
 /**
  * Frees the tags returned from SkyeTek_GetTags().
  * @param lpReader Reader on which tags discovered
@@ -2067,6 +2416,118 @@ SkyeTek_ParsePaymentTrack1(
  * MEMORY FUNCTIONS
  ********************************************************************************/
 
+/**
+ * Sets the allocator used for every allocation made by the API.
+ * Install it before any other API call; objects must be freed
+ * through the same allocator that created them.
+ * If lpAllocator is NULL, malloc/realloc/free are restored.
+ * @param lpAllocator Allocator to copy; all three callbacks are required
+ * @return SKYETEK_SUCCESS or SKYETEK_INVALID_PARAMETER
+ */
+SKYETEK_API SKYETEK_STATUS
+SkyeTek_SetAllocator(
+    LPSKYETEK_ALLOCATOR    lpAllocator
+    );
+
+/**
+ * Allocates a block through the current allocator.
+ * @param size Number of bytes to allocate
+ * @return Block or NULL on failure
+ */
+SKYETEK_API void *
+SkyeTek_Malloc(
+    size_t    size
+    );
+
+/**
+ * Resizes a block through the current allocator. A NULL ptr
+ * allocates and a zero size frees, like realloc().
+ * @param ptr Block to resize
+ * @param size New size in bytes
+ * @return Resized block or NULL on failure
+ */
+SKYETEK_API void *
+SkyeTek_Realloc(
+    void      *ptr,
+    size_t    size
+    );
+
+/**
+ * Frees a block through the current allocator.
+ * @param ptr Block to free, may be NULL
+ */
+SKYETEK_API void
+SkyeTek_Free(
+    void      *ptr
+    );
+
+/**
+ * Gets the number of bytes needed for a tag buffer holding
+ * maxTags tags with idBytes bytes of IDs in total.
+ * @param maxTags Maximum number of tags
+ * @param idBytes Total number of ID bytes
+ * @return Size in bytes to pass to SkyeTek_InitTagBuffer()
+ */
+SKYETEK_API size_t
+SkyeTek_GetTagBufferSize(
+    unsigned int    maxTags,
+    unsigned int    idBytes
+    );
+
+/**
+ * Lays out a tag buffer over a caller-owned block. The block must
+ * be suitably aligned for an unsigned int and outlive the buffer;
+ * whatever follows the per-tag arrays is used for ID bytes.
+ * @param lpBuffer Buffer to initialize
+ * @param mem Block to carve the arrays from
+ * @param size Size of the block in bytes
+ * @param maxTags Maximum number of tags
+ * @return SKYETEK_SUCCESS or SKYETEK_INVALID_PARAMETER if too small
+ */
+SKYETEK_API SKYETEK_STATUS
+SkyeTek_InitTagBuffer(
+    LPSKYETEK_TAG_BUFFER    lpBuffer,
+    void                    *mem,
+    size_t                  size,
+    unsigned int            maxTags
+    );
+
+/**
+ * Appends a tag to a tag buffer. If the buffer is full the tag
+ * is counted in lpBuffer->dropped.
+ * @param lpBuffer Buffer to append to
+ * @param type Tag type
+ * @param id ID bytes
+ * @param length Number of ID bytes
+ * @return SKYETEK_SUCCESS, or SKYETEK_OUT_OF_MEMORY if the tag was dropped
+ */
+SKYETEK_API SKYETEK_STATUS
+SkyeTek_AppendTagBuffer(
+    LPSKYETEK_TAG_BUFFER    lpBuffer,
+    SKYETEK_TAGTYPE         type,
+    unsigned char           *id,
+    unsigned int            length
+    );
+
+/**
+ * Gets the allocation counters accumulated since startup
+ * or the last SkyeTek_ResetAllocationStats().
+ * @param lpStats Receives the counters
+ * @return SKYETEK_SUCCESS or SKYETEK_INVALID_PARAMETER
+ */
+SKYETEK_API SKYETEK_STATUS
+SkyeTek_GetAllocationStats(
+    LPSKYETEK_ALLOCATION_STATS    lpStats
+    );
+
+/**
+ * Resets the allocation counters to zero.
+ */
+SKYETEK_API void
+SkyeTek_ResetAllocationStats(
+    void
+    );
+
 /**
  * Allocates a data buffer.
  * @param size Size of buffer to allocate.
@@ -2227,6 +2688,18 @@ SkyeTek_SetDebugger(
     SKYETEK_DEBUG_CALLBACK  callback
     );
 
+/**
+ * Sets the debugger for the calling thread only. While set, it receives
+ * the messages of calls made on this thread instead of the debugger given
+ * to SkyeTek_SetDebugger, so each reader thread can log on its own. If
+ * callback is NULL, the thread goes back to the shared debugger.
+ * @param callback Callback to call to report debugging messages
+ */
+SKYETEK_API void 
+SkyeTek_SetThreadDebugger(
+    SKYETEK_DEBUG_CALLBACK  callback
+    );
+
 
 /**
  * Backward compatibility.
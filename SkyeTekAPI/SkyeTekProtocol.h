@@ -106,7 +106,8 @@ SkyeTek_GetTagTypeFromName(
     );
 
 /**
- * Gets the tag type name for the given type.
+ * Gets the tag type name for the given type. Unknown types are formatted
+ * into a per-thread buffer that the next call on the same thread reuses.
  * @param name Tag type
  * @return Tag type name
  */
@@ -115,6 +116,20 @@ SkyeTek_GetTagTypeNameFromType(
     SKYETEK_TAGTYPE     type
     );
 
+/**
+ * Copies the tag type name for the given type into a caller buffer.
+ * @param type Tag type
+ * @param name Buffer to receive the name
+ * @param len Size of the buffer in characters, 32 is always enough
+ * @return name, or NULL if the buffer is missing
+ */
+SKYETEK_API TCHAR *
+SkyeTek_FormatTagTypeName(
+    SKYETEK_TAGTYPE     type,
+    TCHAR               *name,
+    unsigned int        len
+    );
+
 /********************************************************************************
  * Raw Device 
  ********************************************************************************/
@@ -162,6 +177,18 @@ SkyeTek_CloseDevice(
 #define STPV3_MAX_RESPONSE_SIZE 8192
 #define STPV3_MAX_ASCII_RESPONSE_SIZE (2*STPV3_MAX_RESPONSE_SIZE + 24)
 
+/* Where STPV3_BuildRequest put the fields a prepared request may change */
+typedef struct STPV3_PREPARED
+{
+    unsigned short  addressAt;      /* msg offset of the address, 0 if none */
+    unsigned short  blocksAt;       /* msg offset of the block count, 0 if none */
+    unsigned short  dataAt;         /* msg offset of the data length, 0 if none */
+    unsigned short  fixedLength;    /* msg bytes ahead of the first of them */
+    unsigned short  crc;            /* CRC of the fixed bytes after STX or CR */
+    unsigned int    dataLength;     /* data length the message was encoded with */
+    unsigned char   valid;          /* set by STPV3_PrepareRequest */
+} STPV3_PREPARED;
+
 /* Request */
 typedef struct STPV3_REQUEST
 {
@@ -181,6 +208,8 @@ typedef struct STPV3_REQUEST
     unsigned int    msgLength;
     unsigned char   isASCII;
     unsigned char   anyResponse;
+    unsigned int    sentAt;         /* ms tick the request went out, 0 once answered */
+    STPV3_PREPARED  prepared;
 } STPV3_REQUEST, *LPSTPV3_REQUEST;
 
 /* Response */
@@ -211,6 +240,32 @@ STPV3_BuildRequest(
     LPSTPV3_REQUEST  req
     );
 
+/**
+ * Encodes a request once so it can be sent many times. The header, RID,
+ * tag type, TID, AFI and session are encoded here and the CRC over them
+ * is kept; each later STPV3_WritePreparedRequest only re-encodes the address,
+ * block count and data from the request fields and finishes the CRC.
+ * Change only those fields between sends, or prepare the request again
+ * after changing any other.
+ * @param req Pointer to the request structure
+ * @return Results of the build
+ */
+SKYETEK_API SKYETEK_STATUS 
+STPV3_PrepareRequest( 
+    LPSTPV3_REQUEST  req
+    );
+
+/**
+ * Re-encodes the address, block count and data of a prepared request
+ * into its message. A request that is not prepared is built in full.
+ * @param req Pointer to the request structure
+ * @return Results of the build
+ */
+SKYETEK_API SKYETEK_STATUS 
+STPV3_PatchRequest( 
+    LPSTPV3_REQUEST  req
+    );
+
 /**
  * This writes the request to the given device. 
  * This calls STPV3_buildRequest to build it.
@@ -227,6 +282,21 @@ STPV3_WriteRequest(
     unsigned int         timeout
     );
 
+/**
+ * Writes a request made with STPV3_PrepareRequest to the given device,
+ * calling STPV3_PatchRequest instead of building it in full.
+ * @param device The device to write the request to
+ * @param req Pointer to the prepared request
+ * @param timeout Timeout in milliseconds for the write operation
+ * @return Results of patching or writing the request 
+ */
+SKYETEK_API SKYETEK_STATUS 
+STPV3_WritePreparedRequest( 
+    LPSKYETEK_DEVICE     device, 
+    LPSTPV3_REQUEST      req,
+    unsigned int         timeout
+    );
+
 /**
  * Reads the response from the device.
  * @param device The device to read from
@@ -113,7 +113,7 @@ DesfireTag_GetApplicationIDs(
   SkyeTek_FreeData(lpData);
 
   /* Allocate ID memory */
-  *ids = (LPSKYETEK_ID *)malloc(num * sizeof(LPSKYETEK_ID));
+  *ids = (LPSKYETEK_ID *)SkyeTek_Malloc(num * sizeof(LPSKYETEK_ID));
   memset(*ids,0,(num*sizeof(LPSKYETEK_ID)));
 
   /* Then copy out IDs */
@@ -136,7 +136,7 @@ DesfireTag_GetApplicationIDs(
 cleanup:
   for( num = 0; num < ix; num++ )
     SkyeTek_FreeID((*ids)[num]);
-  free(*ids);
+  SkyeTek_Free(*ids);
   *ids = NULL;
   *count = 0;
   return SKYETEK_OUT_OF_MEMORY;
@@ -328,7 +328,7 @@ DesfireTag_GetFileIDs(
   st_asn1_finish_sequence(context);
 
   /* Allocate ID memory */
-  *lpFiles = (LPSKYETEK_ID *)malloc(num * sizeof(LPSKYETEK_ID));
+  *lpFiles = (LPSKYETEK_ID *)SkyeTek_Malloc(num * sizeof(LPSKYETEK_ID));
   memset(*lpFiles,0,(num*sizeof(LPSKYETEK_ID)));
 
   /* Then copy out IDs */
@@ -352,7 +352,7 @@ DesfireTag_GetFileIDs(
 cleanup:
   for( num = 0; num < ix; num++ )
     SkyeTek_FreeID((*lpFiles)[num]);
-  free(*lpFiles);
+  SkyeTek_Free(*lpFiles);
   *lpFiles = NULL;
   *count = 0;
   return SKYETEK_OUT_OF_MEMORY;
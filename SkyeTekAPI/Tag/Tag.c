@@ -7,16 +7,19 @@
 #include "../SkyeTekAPI.h"
 #include <stdlib.h>
 #include "Tag.h"
+#include "../Protocol/Lookup.h"
+#include "TagLookups.h"
+
+static LPTAGTYPEDESC FindTagTypeDescription(SKYETEK_TAGTYPE type)
+{
+  unsigned int slot = LOOKUP_CODE(tagTypePages, tagTypeSlots, (unsigned int)type);
+  return slot == 0 ? NULL : &TagTypeDescriptions[slot - 1];
+}
 
 unsigned char TagBlockToByte(SKYETEK_TAGTYPE type)
 {
-  unsigned ix;
-  
-  for(ix = 0; ix < NUM_TAGTYPEDESCS; ix++)
-    if(TagTypeDescriptions[ix].type == type)
-      return TagTypeDescriptions[ix].bytesToBlock;
-  
-  return 1;
+  LPTAGTYPEDESC desc = FindTagTypeDescription(type);
+  return desc == NULL ? 1 : desc->bytesToBlock;
 }
 
 unsigned int GetTagTypeDescriptionCount(void)
@@ -56,30 +59,38 @@ SKYETEK_API SKYETEK_TAGTYPE SkyeTek_GetTagType(unsigned int index)
 
 SKYETEK_API SKYETEK_TAGTYPE SkyeTek_GetTagTypeFromName(TCHAR *name)
 {
-  unsigned ix;
+  int ix;
 
   if( name == NULL )
     return AUTO_DETECT;
-  
-  for(ix = 0; ix < NUM_TAGTYPEDESCS; ix++)
-	{
-    if(_tcscmp(TagTypeDescriptions[ix].name,name) == 0)
-      return TagTypeDescriptions[ix].type;
-	}
-  return AUTO_DETECT;
+  ix = LOOKUP_NAME(TagTypeDescriptions, TAGTYPEDESC, name, tagTypeByName, name);
+  return ix < 0 ? AUTO_DETECT : TagTypeDescriptions[ix].type;
+}
+
+SKYETEK_API TCHAR *SkyeTek_FormatTagTypeName(SKYETEK_TAGTYPE type, TCHAR *name, unsigned int len)
+{
+  LPTAGTYPEDESC desc;
+
+  if( name == NULL || len == 0 )
+    return NULL;
+  if( (desc = FindTagTypeDescription(type)) != NULL )
+  {
+    _tcsncpy(name,desc->name,len - 1);
+    name[len - 1] = 0;
+    return name;
+  }
+  _sntprintf(name,len,_T("0x%04X"),type);
+  name[len - 1] = 0;
+  return name;
 }
 
-TCHAR gTT[32];
+/* Unknown types are formatted per thread, so readers on other threads keep their names */
+static THREAD_LOCAL TCHAR gTT[32];
 SKYETEK_API TCHAR *SkyeTek_GetTagTypeNameFromType(SKYETEK_TAGTYPE type)
 {
-  unsigned ix;
+  LPTAGTYPEDESC desc = FindTagTypeDescription(type);
   
-  for(ix = 0; ix < NUM_TAGTYPEDESCS; ix++)
-	{
-    if(TagTypeDescriptions[ix].type == type)
-      return TagTypeDescriptions[ix].name;
-	}
-  memset(gTT,0,32*sizeof(TCHAR));
-  _stprintf(gTT,_T("0x%04X"),type);
-  return gTT;
+  if( desc != NULL )
+    return desc->name;
+  return SkyeTek_FormatTagTypeName(type,gTT,32);
 }
@@ -25,7 +25,7 @@ SKYETEK_STATUS CreateTagImpl(SKYETEK_TAGTYPE type, LPSKYETEK_ID lpId, LPSKYETEK_
   if( tag == NULL )
     return SKYETEK_INVALID_PARAMETER;
 
-  t = *tag = (LPSKYETEK_TAG)malloc(sizeof(SKYETEK_TAG));
+  t = *tag = (LPSKYETEK_TAG)SkyeTek_Malloc(sizeof(SKYETEK_TAG));
   if( t == NULL )
     return SKYETEK_OUT_OF_MEMORY;
 
@@ -38,7 +38,7 @@ SKYETEK_STATUS CreateTagImpl(SKYETEK_TAGTYPE type, LPSKYETEK_ID lpId, LPSKYETEK_
     t->id = SkyeTek_AllocateID(lpId->length);
     if( t->id == NULL )
     {
-      free(t);
+      SkyeTek_Free(t);
       return SKYETEK_OUT_OF_MEMORY;
     }
     for(ix = 0; ix < lpId->length; ix++)
@@ -99,7 +99,7 @@ void FreeTagImpl(LPSKYETEK_TAG tag)
     return;
   if( tag->id != NULL )
     SkyeTek_FreeID(tag->id);
-  free(tag);
+  SkyeTek_Free(tag);
 }
 
 LPSKYETEK_TAG DuplicateTagImpl(LPSKYETEK_TAG tag)
@@ -111,7 +111,7 @@ LPSKYETEK_TAG DuplicateTagImpl(LPSKYETEK_TAG tag)
   if( tag == NULL )
     return NULL;
 
-  t = (LPSKYETEK_TAG)malloc(sizeof(SKYETEK_TAG));
+  t = (LPSKYETEK_TAG)SkyeTek_Malloc(sizeof(SKYETEK_TAG));
   if( t == NULL )
     return NULL;
 
@@ -129,7 +129,7 @@ LPSKYETEK_TAG DuplicateTagImpl(LPSKYETEK_TAG tag)
     t->id = SkyeTek_AllocateID(tag->id->length);
     if( t->id == NULL )
     {
-      free(t);
+      SkyeTek_Free(t);
       return NULL;
     }
     for(ix = 0; ix < tag->id->length; ix++)
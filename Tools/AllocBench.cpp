@@ -0,0 +1,143 @@
+/**
+ * AllocBench.cpp
+ *
+ * skyetek_allocs: counts the allocations and time per read of a select
+ * loop on an in-memory reader, once per way of reading tags:
+ *
+ *   tags    SkyeTek_SelectTags, one LPSKYETEK_TAG per read
+ *   ids     SkyeTek_SelectTagIds, the raw ID lent to the callback
+ *   facade  skyetek::SelectTags with a lambda, as main.cpp reads
+ *
+ * Allocations are counted through SkyeTek_SetAllocator, so only those
+ * of the SDK show up:
+ *
+ *   skyetek_allocs --reads=100000
+ */
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include "SkyeTekAPI.h"
+#include "SkyeTek.h"
+#include "MemoryReader.h"
+
+static unsigned long allocations;
+
+static void *countMalloc(size_t size, void *user) {
+    (void) user;
+    allocations++;
+    return malloc(size);
+}
+
+static void *countRealloc(void *p, size_t size, void *user) {
+    (void) user;
+    if (p == NULL)
+        allocations++;
+    return realloc(p, size);
+}
+
+static void countFree(void *p, void *user) {
+    (void) user;
+    free(p);
+}
+
+struct Run {
+    unsigned long target;
+    unsigned long reads;
+    unsigned long sum;      // keeps the reads from being optimized away
+};
+
+static unsigned char onTag(LPSKYETEK_TAG tag, void *user) {
+    Run *run = (Run *) user;
+
+    if (tag == NULL)
+        return 1;
+    run->reads++;
+    run->sum += tag->id->id[tag->id->length - 1];
+    SkyeTek_FreeTag(tag);
+    return run->reads < run->target;
+}
+
+static unsigned char onId(SKYETEK_TAGTYPE type, const unsigned char *id, unsigned int length, void *user) {
+    Run *run = (Run *) user;
+
+    (void) type;
+    if (id == NULL)
+        return 1;
+    run->reads++;
+    run->sum += id[length - 1];
+    return run->reads < run->target;
+}
+
+static void usage(const char *prog) {
+    printf("usage: %s [options]\n"
+           "  --reads=N            reads per way of reading (default 100000)\n",
+           prog);
+}
+
+static void report(const char *name, SKYETEK_STATUS st, const Run &run, unsigned long count,
+                   std::chrono::steady_clock::time_point start) {
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    unsigned long reads = run.reads ? run.reads : 1;
+
+    printf("%-8s %s  %lu reads  %.2f allocations/read  %.0f ns/read\n", name,
+           st == SKYETEK_SUCCESS ? "ok    " : "failed", run.reads, (double) count / reads, ns / reads);
+}
+
+int main(int argc, char **argv) {
+    static const struct option longOptions[] = {
+            {"reads", required_argument, NULL, 'r'},
+            {"help",  no_argument,       NULL, 'h'},
+            {NULL,    0,                 NULL, 0}
+    };
+    static const uint8_t id[12] = {0xE2, 0x00, 0x34, 0x12, 0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF};
+    SKYETEK_ALLOCATOR allocator = {countMalloc, countRealloc, countFree, NULL};
+    unsigned long reads = 100000;
+    int c;
+
+    while ((c = getopt_long(argc, argv, "h", longOptions, NULL)) != -1) {
+        switch (c) {
+            case 'r':
+                reads = strtoul(optarg, NULL, 10);
+                break;
+            default:
+                usage(argv[0]);
+                return c == 'h' ? 0 : 1;
+        }
+    }
+    if (reads == 0)
+        reads = 1;
+    SkyeTek_SetAllocator(&allocator);
+
+    {
+        MemoryReader reader(ISO_MIFARE_ULTRALIGHT, id, sizeof(id));
+        Run run = {reads, 0, 0};
+        allocations = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        SKYETEK_STATUS st = SkyeTek_SelectTags(reader.reader(), AUTO_DETECT, onTag, 0, 1, &run);
+        report("tags", st, run, allocations, start);
+    }
+    {
+        MemoryReader reader(ISO_MIFARE_ULTRALIGHT, id, sizeof(id));
+        Run run = {reads, 0, 0};
+        allocations = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        SKYETEK_STATUS st = SkyeTek_SelectTagIds(reader.reader(), AUTO_DETECT, onId, 0, 1, &run);
+        report("ids", st, run, allocations, start);
+    }
+    {
+        MemoryReader reader(ISO_MIFARE_ULTRALIGHT, id, sizeof(id));
+        Run run = {reads, 0, 0};
+        allocations = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        SKYETEK_STATUS st = skyetek::SelectTags(reader.reader(), [&run](const skyetek::Read &read) -> bool {
+            if (read.empty())
+                return true;
+            run.reads++;
+            run.sum += read.id()[read.id().size() - 1];
+            return run.reads < run.target;
+        });
+        report("facade", st, run, allocations, start);
+    }
+    return 0;
+}
@@ -0,0 +1,150 @@
+/**
+ * BuildAssets.cpp
+ *
+ * skyetek_assets: compiles a CSV of tag IDs and metadata into the
+ * asset table read by the bridge's --assets option. The first line
+ * names the columns; the first column is the tag ID in hex and the
+ * others become the fields of the metadata object:
+ *
+ *   id,sku,owner,zone
+ *   E28011606000020A1B2C3D4E,SKU-1001,facilities,dock-2
+ *
+ * The table is written aside and renamed over the output, so a running
+ * bridge picks it up without a restart:
+ *
+ *   skyetek_assets assets.csv /var/lib/skyetek/assets.mph
+ */
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../Bridge/AssetTable.h"
+
+// Splits one CSV line; fields may be double-quoted with "" for a quote
+static void splitCsv(const char *line, std::vector<std::string> &fields) {
+    std::string field;
+    bool quoted = false;
+
+    fields.clear();
+    for (const char *p = line; *p != '\0' && *p != '\n' && *p != '\r'; p++) {
+        if (quoted) {
+            if (*p == '"' && p[1] == '"')
+                field += *p++;
+            else if (*p == '"')
+                quoted = false;
+            else
+                field += *p;
+        } else if (*p == '"') {
+            quoted = true;
+        } else if (*p == ',') {
+            fields.push_back(field);
+            field.clear();
+        } else {
+            field += *p;
+        }
+    }
+    fields.push_back(field);
+}
+
+static void appendJsonString(std::string &out, const std::string &s) {
+    out += '"';
+    for (size_t i = 0; i < s.size(); i++) {
+        unsigned char c = (unsigned char) s[i];
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += (char) c;
+        } else if (c < 0x20) {
+            char esc[8];
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+            out += esc;
+        } else {
+            out += (char) c;
+        }
+    }
+    out += '"';
+}
+
+static bool parseId(const std::string &hex, std::vector<uint8_t> &id) {
+    id.clear();
+    if (hex.empty() || hex.size() % 2 != 0 || hex.size() / 2 > TAG_EVENT_MAX_ID)
+        return false;
+    for (size_t i = 0; i < hex.size(); i += 2) {
+        unsigned int b;
+        if (sscanf(hex.c_str() + i, "%2x", &b) != 1 || !isxdigit((unsigned char) hex[i + 1]))
+            return false;
+        id.push_back((uint8_t) b);
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<std::string> columns;
+    std::vector<std::string> fields;
+    std::vector<AssetRecord> records;
+    std::unordered_map<std::string, size_t> seen;
+    char line[4096];
+    unsigned long lineNo = 0;
+    unsigned long skipped = 0;
+    FILE *in;
+
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s input.csv output\n", argv[0]);
+        return 1;
+    }
+    if ((in = fopen(argv[1], "r")) == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    while (fgets(line, sizeof(line), in) != NULL) {
+        lineNo++;
+        if (columns.empty()) {
+            splitCsv(line, columns);
+            continue;
+        }
+        splitCsv(line, fields);
+        if (fields.size() == 1 && fields[0].empty())
+            continue;
+
+        AssetRecord record;
+        if (!parseId(fields[0], record.id)) {
+            fprintf(stderr, "%s:%lu: bad tag ID %s\n", argv[1], lineNo, fields[0].c_str());
+            skipped++;
+            continue;
+        }
+        record.json = "{";
+        for (size_t i = 1; i < fields.size() && i < columns.size(); i++) {
+            if (i > 1)
+                record.json += ',';
+            appendJsonString(record.json, columns[i]);
+            record.json += ':';
+            appendJsonString(record.json, fields[i]);
+        }
+        record.json += '}';
+        if (record.json.size() > ASSET_MAX_VALUE) {
+            fprintf(stderr, "%s:%lu: metadata longer than %d bytes\n", argv[1], lineNo, ASSET_MAX_VALUE);
+            skipped++;
+            continue;
+        }
+
+        // A repeated ID replaces the earlier row
+        std::string key(record.id.begin(), record.id.end());
+        std::unordered_map<std::string, size_t>::iterator it = seen.find(key);
+        if (it != seen.end()) {
+            records[it->second] = record;
+        } else {
+            seen[key] = records.size();
+            records.push_back(record);
+        }
+    }
+    fclose(in);
+
+    if (!AssetTable::build(records, argv[2])) {
+        fprintf(stderr, "cannot build %s\n", argv[2]);
+        return 1;
+    }
+    fprintf(stderr, "%u assets written to %s, %lu rows skipped\n",
+            (unsigned int) records.size(), argv[2], skipped);
+    return 0;
+}
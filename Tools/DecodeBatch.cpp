@@ -0,0 +1,73 @@
+/**
+ * DecodeBatch.cpp
+ *
+ * skyetek_decode: reference decoder for binary batch payloads. Reads
+ * one payload from a file or stdin and prints its events as JSON,
+ * one per line. For example:
+ *
+ *   mosquitto_sub -t 'SkyeT1ek/#' -C 1 > batch.bin && skyetek_decode batch.bin
+ *
+ * Compressed payloads are inflated first; pass the dictionary the bridge
+ * was started with as -d FILE. Compressed JSON batches are printed as is.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "../Bridge/BinaryBatchCodec.h"
+#include "../Bridge/CompressedBatchCodec.h"
+
+int main(int argc, char *argv[]) {
+    std::vector<uint8_t> payload;
+    std::vector<uint8_t> dictionary;
+    std::vector<uint8_t> inflated;
+    std::vector<TagEvent> events;
+    char line[512];
+    uint8_t buf[4096];
+    size_t n;
+    FILE *in = stdin;
+    int arg = 1;
+
+    if (argc > 2 && strcmp(argv[1], "-d") == 0) {
+        if (!ReadFile(argv[2], dictionary)) {
+            perror(argv[2]);
+            return 1;
+        }
+        arg = 3;
+    }
+    if (argc > arg && (in = fopen(argv[arg], "rb")) == NULL) {
+        perror(argv[arg]);
+        return 1;
+    }
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+        payload.insert(payload.end(), buf, buf + n);
+    if (in != stdin)
+        fclose(in);
+
+    if (payload.size() >= 2 && payload[0] == 'S' && payload[1] == 'Z') {
+        size_t compressed = payload.size();
+        if (!CompressedBatchCodec::decompress(&payload[0], payload.size(),
+                                              dictionary.empty() ? NULL : &dictionary, inflated)) {
+            fprintf(stderr, "cannot decompress batch (built with zstd: %s)\n",
+                    CompressedBatchCodec::available() ? "yes" : "no");
+            return 1;
+        }
+        payload.swap(inflated);
+        fprintf(stderr, "%u -> %u bytes\n", (unsigned int) compressed, (unsigned int) payload.size());
+        if (!payload.empty() && payload[0] == '[') {
+            fwrite(&payload[0], 1, payload.size(), stdout);
+            printf("\n");
+            return 0;
+        }
+    }
+
+    if (!BinaryBatchCodec::decode(payload.empty() ? NULL : &payload[0], payload.size(), events)) {
+        fprintf(stderr, "not a version %d binary batch\n", BINARY_BATCH_VERSION);
+        return 1;
+    }
+    for (size_t i = 0; i < events.size(); i++) {
+        if (FormatTagEventJson(events[i], line, sizeof(line)) > 0)
+            printf("%s\n", line);
+    }
+    fprintf(stderr, "%u events in %u bytes\n", (unsigned int) events.size(), (unsigned int) payload.size());
+    return 0;
+}
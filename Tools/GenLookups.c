@@ -0,0 +1,176 @@
+/**
+ * GenLookups.c
+ *
+ * skyetek_lookups: generates the constant time indexes of the tag type
+ * and STPv3 code tables, run by the build before the SDK is compiled:
+ *
+ *   skyetek_lookups <output directory>
+ *
+ * Each code table gets a two level index by code (see Protocol/Lookup.h)
+ * and each named table an index sorted by name. Where a table lists a
+ * code or name twice, the first entry wins, as it did for the linear
+ * scans these indexes replace.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SkyeTekAPI.h"
+#include "Tag/Tag.h"
+#include "Protocol/STPv3.h"
+#include "Protocol/Lookup.h"
+
+#define MAX_ENTRIES 255
+
+typedef struct LOOKUP_TABLE
+{
+  const char    *prefix;
+  unsigned int  count;
+  unsigned int  codes[MAX_ENTRIES];
+  const char    *names[MAX_ENTRIES];
+} LOOKUP_TABLE;
+
+static LOOKUP_TABLE *sortTable;
+
+static int CompareNames(const void *a, const void *b)
+{
+  int cmp = strcmp(sortTable->names[*(const unsigned char *)a],
+                   sortTable->names[*(const unsigned char *)b]);
+  if( cmp != 0 )
+    return cmp;
+  return (int)*(const unsigned char *)a - (int)*(const unsigned char *)b;
+}
+
+static void WriteBytes(FILE *fp, const unsigned char *bytes, unsigned int count)
+{
+  unsigned int ix;
+  for( ix = 0; ix < count; ix++ )
+    fprintf(fp, "%s%3u%s", (ix % 16) == 0 ? "  " : "", bytes[ix],
+            ix + 1 == count ? "\n" : ((ix % 16) == 15 ? ",\n" : ","));
+}
+
+static int WriteCodeIndex(FILE *fp, LOOKUP_TABLE *table)
+{
+  unsigned char pages[256], slots[257][LOOKUP_PAGE_SIZE];
+  unsigned int ix, count = 1;
+
+  memset(pages, 0, sizeof(pages));
+  memset(slots, 0, sizeof(slots));
+  for( ix = 0; ix < table->count; ix++ )
+  {
+    unsigned int code = table->codes[ix];
+    if( code > 0xFFFF )
+    {
+      fprintf(stderr, "skyetek_lookups: %s code 0x%X is wider than 16 bits\n", table->prefix, code);
+      return 0;
+    }
+    if( pages[code >> 8] == 0 )
+      pages[code >> 8] = (unsigned char)count++;
+    if( slots[pages[code >> 8]][code & 0xFF] == 0 )
+      slots[pages[code >> 8]][code & 0xFF] = (unsigned char)(ix + 1);
+  }
+
+  fprintf(fp, "static const unsigned char %sPages[256] = {\n", table->prefix);
+  WriteBytes(fp, pages, 256);
+  fprintf(fp, "};\n\nstatic const unsigned char %sSlots[%u][%u] = {\n", table->prefix, count, LOOKUP_PAGE_SIZE);
+  for( ix = 0; ix < count; ix++ )
+  {
+    fprintf(fp, "  {\n");
+    WriteBytes(fp, slots[ix], LOOKUP_PAGE_SIZE);
+    fprintf(fp, "  }%s\n", ix + 1 == count ? "" : ",");
+  }
+  fprintf(fp, "};\n\n");
+  return 1;
+}
+
+static void WriteNameIndex(FILE *fp, LOOKUP_TABLE *table)
+{
+  unsigned char byName[MAX_ENTRIES];
+  unsigned int ix, count = 0;
+
+  for( ix = 0; ix < table->count; ix++ )
+    byName[ix] = (unsigned char)ix;
+  sortTable = table;
+  qsort(byName, table->count, 1, CompareNames);
+  /* Keep the first of equal names, the sort leaves it in front */
+  for( ix = 0; ix < table->count; ix++ )
+  {
+    if( count > 0 && strcmp(table->names[byName[count - 1]], table->names[byName[ix]]) == 0 )
+      continue;
+    byName[count++] = byName[ix];
+  }
+
+  fprintf(fp, "static const unsigned char %sByName[%u] = {\n", table->prefix, count);
+  WriteBytes(fp, byName, count);
+  fprintf(fp, "};\n\n");
+}
+
+static int WriteHeader(const char *dir, const char *file, LOOKUP_TABLE *tables, unsigned int count)
+{
+  char path[1024], guard[64];
+  unsigned int ix;
+  FILE *fp;
+
+  sprintf(path, "%s/%s", dir, file);
+  if( (fp = fopen(path, "w")) == NULL )
+  {
+    perror(path);
+    return 0;
+  }
+  for( ix = 0; file[ix] != '.' && ix < sizeof(guard) - 1; ix++ )
+    guard[ix] = (char)(file[ix] >= 'a' && file[ix] <= 'z' ? file[ix] - 'a' + 'A' : file[ix]);
+  guard[ix] = 0;
+
+  fprintf(fp, "/* Generated by Tools/GenLookups.c, do not edit */\n");
+  fprintf(fp, "#ifndef STAPI_%s_H\n#define STAPI_%s_H\n\n", guard, guard);
+  for( ix = 0; ix < count; ix++ )
+  {
+    if( !WriteCodeIndex(fp, &tables[ix]) )
+    {
+      fclose(fp);
+      return 0;
+    }
+    if( tables[ix].names[0] != NULL )
+      WriteNameIndex(fp, &tables[ix]);
+  }
+  fprintf(fp, "#endif\n");
+  return fclose(fp) == 0;
+}
+
+#define FILL_TABLE(table, name, source, code, label, n) \
+  do { \
+    unsigned int ix; \
+    if( (n) > MAX_ENTRIES ) \
+    { \
+      fprintf(stderr, "skyetek_lookups: %s has more than %d entries\n", name, MAX_ENTRIES); \
+      return 1; \
+    } \
+    (table).prefix = name; \
+    (table).count = (unsigned int)(n); \
+    for( ix = 0; ix < (n); ix++ ) \
+    { \
+      (table).codes[ix] = (unsigned int)(source)[ix].code; \
+      (table).names[ix] = label; \
+    } \
+  } while( 0 )
+
+int main(int argc, char *argv[])
+{
+  static LOOKUP_TABLE tags[1], stpv3[3];
+
+  if( argc != 2 )
+  {
+    fprintf(stderr, "usage: skyetek_lookups <output directory>\n");
+    return 2;
+  }
+
+  FILL_TABLE(tags[0], "tagType", TagTypeDescriptions, type, TagTypeDescriptions[ix].name, NUM_TAGTYPEDESCS);
+  FILL_TABLE(stpv3[0], "stpv3Command", stpv3Commands, cmd, stpv3Commands[ix].name, STPV3_CMD_LOOKUPS_COUNT);
+  FILL_TABLE(stpv3[1], "stpv3Response", stpv3Responses, cmd, stpv3Responses[ix].name, STPV3_RESP_LOOKUPS_COUNT);
+  FILL_TABLE(stpv3[2], "stpv3Status", stpv3Statuses, cmd, NULL, STPV3_STATUS_LOOKUPS_COUNT);
+
+  if( !WriteHeader(argv[1], "TagLookups.h", tags, 1) )
+    return 1;
+  if( !WriteHeader(argv[1], "STPV3Lookups.h", stpv3, 3) )
+    return 1;
+  return 0;
+}
@@ -0,0 +1,137 @@
+/**
+ * MemoryReader.h
+ *
+ * An STPv3 reader without hardware for the benchmarks. Its device
+ * answers every select with a read of the same tag until the loop is
+ * stopped, so a select loop measures only the SDK. Each instance keeps
+ * its own state and can be driven from its own thread.
+ */
+#ifndef TOOLS_MEMORY_READER_H
+#define TOOLS_MEMORY_READER_H
+
+#include <stdint.h>
+#include <string.h>
+#include "SkyeTekAPI.h"
+#include "Device/Device.h"
+#include "Reader/Reader.h"
+#include "Protocol/Protocol.h"
+#include "Protocol/CRC.h"
+
+extern "C" {
+extern PROTOCOLIMPL STPV3Impl;
+extern READER_IMPL SkyetekReaderImpl;
+}
+
+#define MEMORY_READER_MAX_ID    32
+
+class MemoryReader {
+public:
+    /**
+     * @param tagType Tag type reported with every read
+     * @param id Tag ID reported with every read, at most MEMORY_READER_MAX_ID bytes
+     */
+    MemoryReader(uint16_t tagType, const uint8_t *id, size_t length) : pos_(0), writes_(0) {
+        encode(read_, 0x0101, tagType, id, length);     // SELECT_TAG_PASS
+        encode(loopOff_, 0x81C1, 0, NULL, 0);           // SELECT_TAG_LOOP_OFF
+
+        memset(&impl_, 0, sizeof(impl_));
+        impl_.Read = Read;
+        impl_.Write = Write;
+        impl_.Flush = Flush;
+        memset(&device_, 0, sizeof(device_));
+        strcpy(device_.friendly, "memory");
+        strcpy(device_.address, "memory");
+        device_.user = this;
+        device_.internal = &impl_;
+
+        memset(rid_, 0xFF, sizeof(rid_));
+        id_.id = rid_;
+        id_.length = sizeof(rid_);
+        protocol_.version = 3;
+        protocol_.internal = &STPV3Impl;
+        memset(&reader_, 0, sizeof(reader_));
+        reader_.id = &id_;
+        reader_.lpDevice = &device_;
+        reader_.lpProtocol = &protocol_;
+        reader_.internal = &SkyetekReaderImpl;
+    }
+
+    LPSKYETEK_READER reader() { return &reader_; }
+
+private:
+    struct Message {
+        uint8_t bytes[16 + MEMORY_READER_MAX_ID];
+        unsigned int length;
+    };
+
+    static void encode(Message &m, uint16_t code, uint16_t tagType, const uint8_t *id, size_t length) {
+        unsigned int n = 3;
+
+        if (length > MEMORY_READER_MAX_ID)
+            length = MEMORY_READER_MAX_ID;
+        m.bytes[n++] = (uint8_t) (code >> 8);
+        m.bytes[n++] = (uint8_t) code;
+        if (id != NULL) {
+            m.bytes[n++] = (uint8_t) (tagType >> 8);
+            m.bytes[n++] = (uint8_t) tagType;
+            m.bytes[n++] = (uint8_t) (length >> 8);
+            m.bytes[n++] = (uint8_t) length;
+            memcpy(&m.bytes[n], id, length);
+            n += (unsigned int) length;
+        }
+        // STX, then the length of everything after it including the CRC
+        m.bytes[0] = 0x02;
+        m.bytes[1] = (uint8_t) ((n - 1) >> 8);
+        m.bytes[2] = (uint8_t) (n - 1);
+        unsigned short crc = crc16(0, &m.bytes[1], (unsigned short) (n - 1));
+        m.bytes[n++] = (uint8_t) (crc >> 8);
+        m.bytes[n++] = (uint8_t) crc;
+        m.length = n;
+    }
+
+    // The first write starts the loop, the next one stops it
+    static int Read(LPSKYETEK_DEVICE device, unsigned char *buffer, unsigned int length, unsigned int timeout) {
+        MemoryReader *self = (MemoryReader *) device->user;
+        const Message &m = self->writes_ > 1 ? self->loopOff_ : self->read_;
+        unsigned int n = length;
+
+        (void) timeout;
+        if (self->pos_ + n > m.length)
+            n = m.length - self->pos_;
+        memcpy(buffer, m.bytes + self->pos_, n);
+        self->pos_ += n;
+        if (self->pos_ == m.length)
+            self->pos_ = 0;
+        return (int) n;
+    }
+
+    static int Write(LPSKYETEK_DEVICE device, unsigned char *buffer, unsigned int length, unsigned int timeout) {
+        MemoryReader *self = (MemoryReader *) device->user;
+
+        (void) buffer;
+        (void) timeout;
+        self->writes_++;
+        self->pos_ = 0;
+        return (int) length;
+    }
+
+    static void Flush(LPSKYETEK_DEVICE device) {
+        (void) device;
+    }
+
+    Message read_;
+    Message loopOff_;
+    unsigned int pos_;
+    unsigned int writes_;
+    DEVICEIMPL impl_;
+    SKYETEK_DEVICE device_;
+    unsigned char rid_[4];
+    SKYETEK_ID id_;
+    SKYETEK_PROTOCOL protocol_;
+    SKYETEK_READER reader_;
+
+    MemoryReader(const MemoryReader &);
+    MemoryReader &operator=(const MemoryReader &);
+};
+
+#endif
@@ -0,0 +1,234 @@
+/**
+ * MqttBench.cpp
+ *
+ * skyetek_mqtt_bench: publishes --batches binary batches from each of
+ * --readers threads to a broker, the way the bridge publishes them, and
+ * reports the publish rate and the bytes each message costs on the wire
+ * for the four ways the bridge can be run:
+ *
+ *   v3.1.1 shared       one connection, topic string in every publish
+ *   v5 shared           one connection, topic aliases
+ *   v3.1.1 per-reader   --client-per-reader
+ *   v5 per-reader       --client-per-reader --mqtt-version=5
+ *
+ * Needs a broker that speaks MQTT v5, for instance a local mosquitto:
+ *
+ *   skyetek_mqtt_bench --broker=tcp://localhost:1883 --readers=8 --batches=2000
+ *
+ * Wire bytes count the PUBLISH packets only, estimated from the packet
+ * layout and the number of publishes that went out with an alias.
+ */
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../Bridge/BinaryBatchCodec.h"
+#include "../Bridge/MqttPublisher.h"
+
+#define QOS         1
+#define TIMEOUT     5000L
+
+struct Config {
+    const char *name;
+    int mqttVersion;
+    bool clientPerReader;
+};
+
+struct Reader {
+    char rid[TAG_EVENT_MAX_RID];
+    std::string topic;
+    std::vector<uint8_t> payload;
+    MqttPublisher *client;
+    unsigned long failed;
+};
+
+static void usage(const char *prog) {
+    printf("usage: %s [options]\n"
+           "  --broker=URI         MQTT broker (default tcp://localhost:1883)\n"
+           "  --client-id=ID       MQTT client id (default SkyeTekBench)\n"
+           "  --readers=N          publishing readers (default 4)\n"
+           "  --batches=N          batches each reader publishes per run (default 1000)\n"
+           "  --batch-size=N       tag events per batch (default 32)\n",
+           prog);
+}
+
+// Length of the MQTT variable byte integer encoding n
+static size_t varintLength(size_t n) {
+    size_t length = 1;
+
+    while (n >= 128) {
+        n /= 128;
+        length++;
+    }
+    return length;
+}
+
+// Fixed header, topic, packet identifier, v5 properties and payload of one PUBLISH
+static size_t publishBytes(size_t topicLength, size_t payloadLength, int mqttVersion, size_t properties) {
+    size_t remaining = 2 + topicLength + (QOS > 0 ? 2 : 0) + payloadLength;
+
+    if (mqttVersion == MQTTVERSION_5)
+        remaining += varintLength(properties) + properties;
+    return 1 + varintLength(remaining) + remaining;
+}
+
+// Same tags every batch, spread over distinct IDs so the codec cannot fold them
+static void encodeBatch(Reader &reader, int index, unsigned long batchSize) {
+    std::vector<TagEvent> events(batchSize);
+    uint64_t now = (uint64_t) std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    BinaryBatchCodec codec;
+
+    for (unsigned long i = 0; i < batchSize; i++) {
+        uint8_t id[12] = {0xE2, 0x00, 0x34, 0x12, 0x01, 0x23, 0x45, 0x67, 0x00, 0x00, 0x00, 0x00};
+        id[8] = (uint8_t) index;
+        id[10] = (uint8_t) (i >> 8);
+        id[11] = (uint8_t) i;
+        TagEvent &event = events[i];
+        event.kind = TAG_EVENT_READ;
+        strcpy(event.rid, reader.rid);
+        event.tag = TagKey(0x0008, id, sizeof(id));
+        event.timestamp = event.firstSeen = event.lastSeen = now + i;
+        event.count = 1;
+    }
+    codec.encode(&events[0], events.size(), reader.payload);
+}
+
+static void publishAll(Reader *reader, unsigned long batches) {
+    for (unsigned long i = 0; i < batches; i++) {
+        if (reader->client->publish(reader->topic.c_str(), &reader->payload[0], reader->payload.size()) !=
+            MQTTCLIENT_SUCCESS)
+            reader->failed++;
+    }
+}
+
+static bool runConfig(const Config &config, const char *address, const char *clientId, std::vector<Reader> &readers,
+                      unsigned long batches) {
+    std::vector<MqttPublisher *> clients;
+    std::vector<std::thread> threads;
+    unsigned long failed = 0;
+    uint64_t aliased = 0;
+    int rc;
+
+    for (size_t i = 0; i < readers.size(); i++) {
+        if (i == 0 || config.clientPerReader) {
+            std::string id = config.clientPerReader ? std::string(clientId) + "-" + readers[i].rid : clientId;
+            MqttPublisher *client = new MqttPublisher(address, id.c_str(), QOS, TIMEOUT, config.mqttVersion);
+            clients.push_back(client);
+            if ((rc = client->connect()) != MQTTCLIENT_SUCCESS) {
+                printf("%-18s %s failed to connect, return code %d\n", config.name, id.c_str(), rc);
+                for (size_t j = 0; j < clients.size(); j++)
+                    delete clients[j];
+                return false;
+            }
+        }
+        readers[i].client = clients.back();
+        readers[i].failed = 0;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < readers.size(); i++)
+        threads.push_back(std::thread(publishAll, &readers[i], batches));
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (size_t i = 0; i < clients.size(); i++) {
+        aliased += clients[i]->aliasedPublishes();
+        clients[i]->disconnect();
+        delete clients[i];
+    }
+
+    unsigned long total = 0;
+    double payloadBytes = 0;
+    for (size_t i = 0; i < readers.size(); i++) {
+        unsigned long sent = batches - readers[i].failed;
+        total += sent;
+        payloadBytes += (double) sent * readers[i].payload.size();
+        failed += readers[i].failed;
+    }
+    unsigned long messages = total ? total : 1;
+    size_t payload = (size_t) (payloadBytes / messages + 0.5);
+    size_t topicLength = readers[0].topic.size();
+
+    // Aliased publishes carry an empty topic and the alias property; once
+    // the broker grants aliases, the first publish of each topic carries both
+    double wire = (double) aliased * publishBytes(0, payload, config.mqttVersion, 3) +
+                  (double) (total - aliased) * publishBytes(topicLength, payload, config.mqttVersion,
+                                                            aliased > 0 ? 3 : 0);
+    printf("%-18s %8.0f msgs/s  %6.1f bytes/msg  %6.1f payload bytes/msg  %llu aliased  %lu failed\n",
+           config.name, total / seconds, wire / messages, payloadBytes / messages,
+           (unsigned long long) aliased, failed);
+    return failed == 0;
+}
+
+int main(int argc, char **argv) {
+    static const struct option longOptions[] = {
+            {"broker",     required_argument, NULL, 'b'},
+            {"client-id",  required_argument, NULL, 'c'},
+            {"readers",    required_argument, NULL, 'r'},
+            {"batches",    required_argument, NULL, 'n'},
+            {"batch-size", required_argument, NULL, 's'},
+            {"help",       no_argument,       NULL, 'h'},
+            {NULL,         0,                 NULL, 0}
+    };
+    static const Config configs[] = {
+            {"v3.1.1 shared",     MQTTVERSION_3_1_1, false},
+            {"v5 shared",         MQTTVERSION_5,     false},
+            {"v3.1.1 per-reader", MQTTVERSION_3_1_1, true},
+            {"v5 per-reader",     MQTTVERSION_5,     true},
+    };
+    const char *address = "tcp://localhost:1883";
+    const char *clientId = "SkyeTekBench";
+    int readerCount = 4;
+    unsigned long batches = 1000;
+    unsigned long batchSize = 32;
+    bool ok = true;
+    int c;
+
+    while ((c = getopt_long(argc, argv, "h", longOptions, NULL)) != -1) {
+        switch (c) {
+            case 'b':
+                address = optarg;
+                break;
+            case 'c':
+                clientId = optarg;
+                break;
+            case 'r':
+                readerCount = atoi(optarg);
+                break;
+            case 'n':
+                batches = strtoul(optarg, NULL, 10);
+                break;
+            case 's':
+                batchSize = strtoul(optarg, NULL, 10);
+                break;
+            default:
+                usage(argv[0]);
+                return c == 'h' ? 0 : 1;
+        }
+    }
+    if (readerCount < 1)
+        readerCount = 1;
+    if (batches == 0)
+        batches = 1;
+    if (batchSize == 0)
+        batchSize = 1;
+
+    // Reader IDs and topics as main.cpp names them in raw mode
+    std::vector<Reader> readers(readerCount);
+    for (int i = 0; i < readerCount; i++) {
+        snprintf(readers[i].rid, sizeof(readers[i].rid), "%08X", 0x10000000 + i);
+        readers[i].topic = std::string("SkyeT1ek/") + readers[i].rid;
+        encodeBatch(readers[i], i, batchSize);
+    }
+
+    printf("%d readers, %lu batches of %lu events each\n", readerCount, batches, batchSize);
+    for (size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); i++)
+        ok = runConfig(configs[i], address, clientId, readers, batches) && ok;
+    return ok ? 0 : 1;
+}
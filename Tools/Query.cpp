@@ -0,0 +1,206 @@
+/**
+ * Query.cpp
+ *
+ * skyetek_query: answers questions about the tag read history written
+ * with --history=DIR. For example:
+ *
+ *   skyetek_query /var/lib/skyetek --from=2026-10-01T00:00:00 --tag=E2003412...
+ *   skyetek_query /var/lib/skyetek --from=-86400000 --count
+ *
+ * Times are ms since the epoch, negative ms relative to now, or local
+ * time as YYYY-MM-DDTHH:MM:SS. Only the segments and blocks whose time
+ * range and ID filter can match are read.
+ */
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include "../Bridge/Clock.h"
+#include "../Bridge/HistoryStore.h"
+
+static void usage(const char *prog) {
+    printf("usage: %s DIR [options]\n"
+           "  --from=TIME          first read time (default the beginning)\n"
+           "  --to=TIME            last read time (default now)\n"
+           "  --tag=HEX            only reads of this tag ID\n"
+           "  --reader=RID         only reads of this reader\n"
+           "  --count              print read counts per reader instead of reads\n",
+           prog);
+}
+
+static bool parseTime(const char *s, uint64_t &ms) {
+    struct tm tm;
+    char *end;
+
+    if (s[0] == '-') {
+        ms = WallClockMs() - strtoull(s + 1, &end, 10);
+        return *end == '\0';
+    }
+    memset(&tm, 0, sizeof(tm));
+    end = strptime(s, "%Y-%m-%dT%H:%M:%S", &tm);
+    if (end != NULL && *end == '\0') {
+        tm.tm_isdst = -1;
+        ms = (uint64_t) mktime(&tm) * 1000;
+        return true;
+    }
+    ms = strtoull(s, &end, 10);
+    return *end == '\0';
+}
+
+static bool parseHex(const char *s, std::vector<uint8_t> &bytes) {
+    size_t n = strlen(s);
+
+    if (n == 0 || n % 2 != 0 || n / 2 > TAG_EVENT_MAX_ID)
+        return false;
+    bytes.clear();
+    for (size_t i = 0; i < n; i += 2) {
+        char pair[3] = {s[i], s[i + 1], '\0'};
+        char *end;
+        bytes.push_back((uint8_t) strtoul(pair, &end, 16));
+        if (*end != '\0')
+            return false;
+    }
+    return true;
+}
+
+static void printRead(const HistorySegment &segment, uint32_t row) {
+    static const char hex[] = "0123456789ABCDEF";
+    char when[32];
+    char id[2 * TAG_EVENT_MAX_ID + 1];
+    uint64_t ts = segment.ts(row);
+    time_t seconds = (time_t) (ts / 1000);
+    struct tm tm;
+    size_t length;
+    const uint8_t *bytes = segment.id(row, length);
+
+    localtime_r(&seconds, &tm);
+    strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%S", &tm);
+    for (size_t i = 0; i < length; i++) {
+        id[2 * i] = hex[bytes[i] >> 4];
+        id[2 * i + 1] = hex[bytes[i] & 0x0F];
+    }
+    id[2 * length] = '\0';
+    printf("%s.%03u %s %04X %s\n", when, (unsigned int) (ts % 1000),
+           segment.header().rid[segment.reader(row)], segment.type(row), id);
+}
+
+int main(int argc, char *argv[]) {
+    static const struct option longOptions[] = {
+            {"from",   required_argument, NULL, 'f'},
+            {"to",     required_argument, NULL, 't'},
+            {"tag",    required_argument, NULL, 'g'},
+            {"reader", required_argument, NULL, 'r'},
+            {"count",  no_argument,       NULL, 'c'},
+            {"help",   no_argument,       NULL, 'h'},
+            {NULL,     0,                 NULL, 0}
+    };
+    uint64_t from = 0;
+    uint64_t to = WallClockMs();
+    std::vector<uint8_t> tag;
+    const char *rid = NULL;
+    bool count = false;
+    int c;
+
+    while ((c = getopt_long(argc, argv, "h", longOptions, NULL)) != -1) {
+        switch (c) {
+            case 'f':
+            case 't':
+                if (!parseTime(optarg, c == 'f' ? from : to)) {
+                    fprintf(stderr, "bad time: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'g':
+                if (!parseHex(optarg, tag)) {
+                    fprintf(stderr, "bad tag ID: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'r':
+                rid = optarg;
+                break;
+            case 'c':
+                count = true;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<std::string> paths;
+    if (!ListHistorySegments(argv[optind], paths)) {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    uint64_t tagHash = tag.empty() ? 0 : HistoryIdHash(&tag[0], tag.size());
+    std::map<std::string, uint64_t> counts;
+    uint64_t matches = 0;
+    uint64_t scanned = 0;
+    uint64_t blocks = 0;
+
+    for (size_t i = 0; i < paths.size(); i++) {
+        HistorySegment segment;
+        if (!segment.open(paths[i].c_str())) {
+            fprintf(stderr, "skipping %s\n", paths[i].c_str());
+            continue;
+        }
+        const HistoryHeader &header = segment.header();
+        if (segment.rows() == 0 || header.maxTs < from || header.minTs > to)
+            continue;
+
+        // Resolve the reader filter to this segment's reader index
+        int readerIndex = -1;
+        if (rid != NULL) {
+            for (uint32_t r = 0; r < header.readers && r < HISTORY_MAX_READERS; r++) {
+                if (strncmp(header.rid[r], rid, TAG_EVENT_MAX_RID) == 0)
+                    readerIndex = (int) r;
+            }
+            if (readerIndex < 0)
+                continue;
+        }
+
+        for (uint32_t block = 0; block * HISTORY_BLOCK < segment.rows(); block++) {
+            if (!segment.blockMayMatch(block, from, to, tag.empty() ? NULL : &tagHash))
+                continue;
+            blocks++;
+            uint32_t end = std::min(segment.rows(), (block + 1) * HISTORY_BLOCK);
+            for (uint32_t row = block * HISTORY_BLOCK; row < end; row++) {
+                scanned++;
+                uint64_t ts = segment.ts(row);
+                if (ts < from || ts > to)
+                    continue;
+                if (readerIndex >= 0 && segment.reader(row) != readerIndex)
+                    continue;
+                if (!tag.empty()) {
+                    size_t length;
+                    const uint8_t *id = segment.id(row, length);
+                    if (length != tag.size() || memcmp(id, &tag[0], length) != 0)
+                        continue;
+                }
+                matches++;
+                if (count)
+                    counts[header.rid[segment.reader(row)]]++;
+                else
+                    printRead(segment, row);
+            }
+        }
+    }
+
+    for (std::map<std::string, uint64_t>::iterator it = counts.begin(); it != counts.end(); ++it)
+        printf("%s %llu\n", it->first.c_str(), (unsigned long long) it->second);
+    fprintf(stderr, "%llu reads matched, %llu rows in %llu blocks of %u segments scanned\n",
+            (unsigned long long) matches, (unsigned long long) scanned, (unsigned long long) blocks,
+            (unsigned int) paths.size());
+    return 0;
+}
@@ -0,0 +1,173 @@
+/**
+ * SerialBench.cpp
+ *
+ * skyetek_serial: opens a pty pair, floods the master from a writer
+ * thread and reads the slave back through SerialDevice_Read, the way
+ * the protocol code reads a response, once per read size:
+ *
+ *   ring    SkyeTek_ReadDevice on the opened serial device
+ *   read    read() and, on EAGAIN, poll() on the same descriptor, as
+ *           ports without the ring are read
+ *
+ *   skyetek_serial --megabytes=4 --sizes=1,4,16
+ *
+ * A pty has no baud rate, so the numbers are the ceiling the read path
+ * itself allows. The exit status is 1 if a run lost or reordered bytes.
+ */
+#include <getopt.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "SkyeTekAPI.h"
+#include "SkyeTekProtocol.h"
+#include "Device/DeviceFactory.h"
+
+#define READ_TIMEOUT    100
+
+static void usage(const char *prog) {
+    printf("usage: %s [options]\n"
+           "  --megabytes=N        bytes fed through the pty per run (default 4)\n"
+           "  --sizes=N,N...       bytes asked for per read (default 1,4,16)\n",
+           prog);
+}
+
+// Byte i of the stream, so the reader can check order without a copy
+static inline unsigned char streamByte(size_t i) {
+    return (unsigned char) (i * 131 + (i >> 12));
+}
+
+static void feed(int master, size_t total) {
+    unsigned char block[4096];
+    size_t sent = 0;
+
+    while (sent < total) {
+        size_t n = std::min(sizeof(block), total - sent);
+        for (size_t i = 0; i < n; i++)
+            block[i] = streamByte(sent + i);
+        ssize_t w = write(master, block, n);
+        if (w < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        sent += (size_t) w;
+    }
+}
+
+// The path SerialDevice_Read takes when the port has no ring
+static int readPoll(int fd, unsigned char *buffer, unsigned int length) {
+    int n = (int) read(fd, buffer, length);
+
+    if (n == -1 && errno == EAGAIN) {
+        struct pollfd fds;
+        fds.fd = fd;
+        fds.events = POLLIN;
+        fds.revents = 0;
+        if (poll(&fds, 1, READ_TIMEOUT) <= 0)
+            return 0;
+        n = (int) read(fd, buffer, length);
+    }
+    return n;
+}
+
+static bool run(const char *name, LPSKYETEK_DEVICE device, int master, size_t total, unsigned int size, bool ring) {
+    std::vector<unsigned char> buffer(size);
+    size_t received = 0;
+    bool ordered = true;
+
+    SkyeTek_FlushDevice(device);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::thread writer(feed, master, total);
+    while (received < total) {
+        int n = ring ? SkyeTek_ReadDevice(device, &buffer[0], size, READ_TIMEOUT)
+                     : readPoll(device->readFD, &buffer[0], size);
+        if (n <= 0)
+            break;
+        for (int i = 0; i < n; i++)
+            ordered = ordered && buffer[i] == streamByte(received + i);
+        received += (size_t) n;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    writer.join();
+
+    bool ok = ordered && received == total;
+    printf("%-5s %2u-byte reads: %7.1f MB/s  %s\n", name, size, received / seconds / 1e6,
+           ok ? "ok" : "lost or reordered bytes");
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    static const struct option longOptions[] = {
+            {"megabytes", required_argument, NULL, 'm'},
+            {"sizes",     required_argument, NULL, 's'},
+            {"help",      no_argument,       NULL, 'h'},
+            {NULL,        0,                 NULL, 0}
+    };
+    std::vector<unsigned int> sizes;
+    size_t megabytes = 4;
+    LPSKYETEK_DEVICE device = NULL;
+    TCHAR slave[64];
+    bool ok = true;
+    int master;
+    int c;
+
+    while ((c = getopt_long(argc, argv, "h", longOptions, NULL)) != -1) {
+        switch (c) {
+            case 'm':
+                megabytes = strtoul(optarg, NULL, 10);
+                break;
+            case 's':
+                for (char *p = optarg; *p != '\0'; ) {
+                    char *end;
+                    unsigned long n = strtoul(p, &end, 10);
+                    if (end == p)
+                        break;
+                    if (n > 0)
+                        sizes.push_back((unsigned int) n);
+                    p = *end == ',' ? end + 1 : end;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return c == 'h' ? 0 : 1;
+        }
+    }
+    if (megabytes == 0)
+        megabytes = 1;
+    if (sizes.empty()) {
+        sizes.push_back(1);
+        sizes.push_back(4);
+        sizes.push_back(16);
+    }
+
+    if ((master = posix_openpt(O_RDWR | O_NOCTTY)) == -1 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        perror("skyetek_serial: posix_openpt");
+        return 1;
+    }
+    snprintf(slave, sizeof(slave), "%s", ptsname(master));
+    // SkyeTek_CreateDevice would offer the address to the USB factory first
+    if (SerialDeviceFactory.CreateDevice(slave, &device) != SKYETEK_SUCCESS ||
+        SkyeTek_OpenDevice(device) != SKYETEK_SUCCESS) {
+        printf("skyetek_serial: cannot open %s as a serial device\n", slave);
+        return 1;
+    }
+
+    printf("%s, %zu MB per run\n", slave, megabytes);
+    for (size_t i = 0; i < sizes.size(); i++) {
+        ok = run("ring", device, master, megabytes * 1000000, sizes[i], true) && ok;
+        ok = run("read", device, master, megabytes * 1000000, sizes[i], false) && ok;
+    }
+
+    SkyeTek_CloseDevice(device);
+    SerialDeviceFactory.FreeDevice(device);
+    close(master);
+    return ok ? 0 : 1;
+}
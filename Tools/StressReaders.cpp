@@ -0,0 +1,150 @@
+/**
+ * StressReaders.cpp
+ *
+ * skyetek_stress: runs one select loop per thread, each on its own
+ * in-memory reader, and reports read throughput for 1, 2, 4 ... up to
+ * --threads readers. Every read also resolves the name of an unknown
+ * tag type and logs through a per-thread debugger, and any answer that
+ * belongs to another thread counts as an error:
+ *
+ *   skyetek_stress --threads=8 --reads=200000
+ *
+ * With one core per thread the throughput should grow with the thread
+ * count. The exit status is 1 if any thread saw another's state.
+ */
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "SkyeTekAPI.h"
+#include "SkyeTekProtocol.h"
+#include "MemoryReader.h"
+
+extern "C" void SkyeTek_Debug(TCHAR *sz, ...);
+
+struct Worker {
+    int index;
+    unsigned long target;
+    unsigned long reads;
+    unsigned long logged;
+    unsigned long errors;
+    TCHAR expect[32];
+};
+
+static THREAD_LOCAL Worker *current;
+static TCHAR readFormat[] = _T("stress %d %lu");
+static std::atomic<unsigned long> errors(0);
+
+static void usage(const char *prog) {
+    printf("usage: %s [options]\n"
+           "  --threads=N          most readers run at once (default the number of cores)\n"
+           "  --reads=N            reads per reader and run (default 200000)\n",
+           prog);
+}
+
+// Only sees the messages of its own thread
+static void onDebug(TCHAR *msg) {
+    int index;
+
+    if (strncmp(msg, "stress ", 7) != 0)
+        return;
+    if (sscanf(msg + 7, "%d", &index) != 1 || index != current->index)
+        current->errors++;
+    current->logged++;
+}
+
+static unsigned char onRead(SKYETEK_TAGTYPE type, const unsigned char *id, unsigned int length, void *user) {
+    Worker *worker = (Worker *) user;
+    TCHAR name[32];
+
+    (void) length;
+    if (id == NULL)
+        return 1;
+    worker->reads++;
+    if (_tcscmp(SkyeTek_GetTagTypeNameFromType(type), worker->expect) != 0)
+        worker->errors++;
+    if (_tcscmp(SkyeTek_FormatTagTypeName(type, name, 32), worker->expect) != 0)
+        worker->errors++;
+    SkyeTek_Debug(readFormat, worker->index, worker->reads);
+    return worker->reads < worker->target;
+}
+
+static void run(Worker *worker) {
+    // Unknown types, so each thread formats its own name
+    uint16_t type = (uint16_t) (0xF000 + worker->index);
+    uint8_t id[12];
+
+    for (size_t i = 0; i < sizeof(id); i++)
+        id[i] = (uint8_t) (0xE2 + worker->index + i);
+    MemoryReader reader(type, id, sizeof(id));
+    _sntprintf(worker->expect, 32, _T("0x%04X"), type);
+
+    current = worker;
+    SkyeTek_SetThreadDebugger(onDebug);
+    SKYETEK_STATUS st = SkyeTek_SelectTagIds(reader.reader(), AUTO_DETECT, onRead, 0, 1, worker);
+    SkyeTek_SetThreadDebugger(NULL);
+
+    if (st != SKYETEK_SUCCESS || worker->reads != worker->target || worker->logged != worker->reads)
+        worker->errors++;
+    errors += worker->errors;
+}
+
+int main(int argc, char **argv) {
+    static const struct option longOptions[] = {
+            {"threads", required_argument, NULL, 't'},
+            {"reads",   required_argument, NULL, 'r'},
+            {"help",    no_argument,       NULL, 'h'},
+            {NULL,      0,                 NULL, 0}
+    };
+    int maxThreads = (int) std::thread::hardware_concurrency();
+    unsigned long reads = 200000;
+    double base = 0;
+    int c;
+
+    while ((c = getopt_long(argc, argv, "h", longOptions, NULL)) != -1) {
+        switch (c) {
+            case 't':
+                maxThreads = atoi(optarg);
+                break;
+            case 'r':
+                reads = strtoul(optarg, NULL, 10);
+                break;
+            default:
+                usage(argv[0]);
+                return c == 'h' ? 0 : 1;
+        }
+    }
+    if (maxThreads < 1)
+        maxThreads = 1;
+    if (reads == 0)
+        reads = 1;
+
+    for (int n = 1; ; n = std::min(n * 2, maxThreads)) {
+        std::vector<Worker> workers(n);
+        std::vector<std::thread> threads;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < n; i++) {
+            memset(&workers[i], 0, sizeof(Worker));
+            workers[i].index = i;
+            workers[i].target = reads;
+            threads.push_back(std::thread(run, &workers[i]));
+        }
+        for (int i = 0; i < n; i++)
+            threads[i].join();
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double rate = n * (double) reads / seconds;
+        if (n == 1)
+            base = rate;
+        printf("%2d readers: %8.0f reads/s  x%.2f  errors %lu\n", n, rate, rate / base, (unsigned long) errors);
+        if (n >= maxThreads)
+            break;
+    }
+    return errors != 0 ? 1 : 0;
+}
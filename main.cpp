@@ -2,18 +2,38 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <string>
+#include <thread>
+#include <vector>
 #include <MQTTClient.h>
 
 #include <time.h>
 #include "SkyeTekAPI.h"
 #include "SkyeTekProtocol.h"
+#include "SkyeTek.h"
+#include "Bridge/AssetTable.h"
+#include "Bridge/BinaryBatchCodec.h"
+#include "Bridge/CompressedBatchCodec.h"
+#include "Bridge/Clock.h"
+#include "Bridge/EventBatcher.h"
+#include "Bridge/HistoryStore.h"
+#include "Bridge/Journal.h"
+#include "Bridge/MqttPublisher.h"
+#include "Bridge/Options.h"
+#include "Bridge/PresenceTracker.h"
+#include "Bridge/TagFilter.h"
+#include "Bridge/WindowAggregator.h"
+#include "Bridge/ZoneFusion.h"
 
-#define ADDRESS     "tcp://localhost:1883"
-#define CLIENTID    "SkyeTekMQTT"
 //#define TOPIC       "MQTT Examples"
 //#define PAYLOAD     "Hello World!"
 #define QOS         1
 #define TIMEOUT     5000L
+#define JOURNAL_SEGMENT_MB  4
+#define ASSET_CHECK_MS      1000
+#define ZONE_TOPIC          "SkyeT1ek/zones"
 
 void getTimestamp(TCHAR * buf) {
 
@@ -26,48 +46,147 @@ void getTimestamp(TCHAR * buf) {
     strftime(buf, 26, "%Y:%m:%d %H:%M:%S", tm_info);
 }
 
-unsigned char isStop = 0;
-MQTTClient client;
-TCHAR mqttTopic[256] = "";
+volatile sig_atomic_t isStop = 0;
+BridgeOptions options;
+MqttPublisher *publisher = NULL;
+HistoryWriter *history = NULL;
+TagFilter *filter = NULL;
+AssetCatalog *assets = NULL;
+ZoneFusion *zones = NULL;
 
-unsigned char SelectLoopCallback(LPSKYETEK_TAG lpTag, void *user) {
+void StopHandler(int sig) {
+    isStop = 1;
+}
 
-    MQTTClient_connectOptions conn_opts = MQTTClient_connectOptions_initializer;
-    MQTTClient_message pubmsg = MQTTClient_message_initializer;
-    MQTTClient_deliveryToken token;
-    int rc;
+// Per-reader state handed to the select loop as user data
+struct ReaderContext : public EventSink, public WindowSink {
+    LPSKYETEK_READER reader;
+    TCHAR mqttTopic[256];
+    TCHAR presenceTopic[256];
+    TCHAR windowTopic[256];
+    const TCHAR *eventTopic;    // topic of the current mode
+    PresenceTracker *tracker;
+    WindowAggregator *aggregator;
+    std::vector<uint8_t> windowPayload;
+    EventBatcher *batcher;
+    BatchCodec *codec;
+    EventSink *sink;            // batcher, or this context when batching is off
+    int zone;                   // index of the reader in zones
+    MqttPublisher *client;      // own connection with --client-per-reader, else publisher
+    Journal *journal;           // journal of an own connection
+
+    // Unbatched events go out one JSON object per message
+    void onEvent(const TagEvent &event) {
+        char payload[512 + ASSET_MAX_VALUE];
+        size_t len = FormatTagEventJson(event, payload, sizeof(payload));
+        if (len > 0 && assets != NULL)
+            len = AppendAssetJson(assets->snapshot().get(), event.tag, payload, len, sizeof(payload));
+        if (len > 0)
+            client->publish(eventTopic, payload, len);
+    }
+
+    // Each window goes out as one message, however many tags it holds
+    void onWindow(uint64_t start, uint64_t end, const TagEvent *events, size_t count) {
+        codec->encode(events, count, windowPayload);
+        int rc = client->publish(windowTopic, &windowPayload[0], windowPayload.size());
+        printf("skyetek-mqtt: window %llu-%llu of %s: %u tags, return code %d\n",
+               (unsigned long long) start, (unsigned long long) end, reader->rid, (unsigned int) count, rc);
+    }
+};
 
+// Zone events of all readers go out on one topic
+struct ZoneContext : public EventSink {
+    EventBatcher *batcher;
+    BatchCodec *codec;
+    EventSink *sink;            // batcher, or this context when batching is off
+
+    void onEvent(const TagEvent &event) {
+        char payload[512 + ASSET_MAX_VALUE];
+        size_t len = FormatTagEventJson(event, payload, sizeof(payload));
+        if (len > 0 && assets != NULL)
+            len = AppendAssetJson(assets->snapshot().get(), event.tag, payload, len, sizeof(payload));
+        if (len > 0)
+            publisher->publish(ZONE_TOPIC, payload, len);
+    }
+};
+
+void PublishRead(ReaderContext *ctx, const skyetek::Read &read) {
     TCHAR ts[32] = "";
+    TCHAR type[32];
+    TCHAR friendly[2 * SKYETEK_MAX_TAG_LENGTH];
+    size_t len = read.friendly(friendly, sizeof(friendly));
+    int rc;
 
-    if (!isStop && lpTag != NULL) {
-        getTimestamp(ts);
-        printf("skyetek-mqtt [%s]: Type: %s; Tag: %s\n", ts, SkyeTek_GetTagTypeNameFromType(lpTag->type), lpTag->friendly);
+    getTimestamp(ts);
+    printf("skyetek-mqtt [%s]: Type: %s; Tag: %s\n", ts, read.typeName(type, 32), friendly);
 
-        pubmsg.payload = (void *) lpTag->friendly;
-        pubmsg.payloadlen = strlen(lpTag->friendly);
-        pubmsg.qos = QOS;
-        pubmsg.retained = 0;
-        MQTTClient_publishMessage(client, mqttTopic, &pubmsg, &token);
-        rc = MQTTClient_waitForCompletion(client, token, TIMEOUT);
+    rc = ctx->client->publish(ctx->mqttTopic, friendly, len);
 
-        getTimestamp(ts);
-        printf("skyetek-mqtt [%s]: MQTT message with delivery token %d delivered\n", ts, token);
+    getTimestamp(ts);
+    printf("skyetek-mqtt [%s]: MQTT message delivered, return code %d\n", ts, rc);
+}
+
+// Runs in the SDK on the raw ID, before the read is allocated
+unsigned char FilterRead(SKYETEK_TAGTYPE type, const unsigned char *id, unsigned int length, void *user) {
+    return ((TagFilter *) user)->accept((uint16_t) type, id, length) ? 1 : 0;
+}
 
-        SkyeTek_FreeTag(lpTag);
+// Takes every read of the reader of ctx; an empty read is a loop timeout
+bool OnRead(ReaderContext *ctx, const skyetek::Read &read) {
+    if (!isStop && !read.empty()) {
+        TagKey tag((uint16_t) read.type(), read.id().data(), read.id().size());
+        if (history != NULL)
+            history->append(ctx->reader->rid, WallClockMs(), tag);
+        if (options.mode == BRIDGE_MODE_RAW && ctx->batcher == NULL) {
+            PublishRead(ctx, read);
+        } else if (options.mode == BRIDGE_MODE_RAW) {
+            TagEvent event;
+            event.kind = TAG_EVENT_READ;
+            snprintf(event.rid, sizeof(event.rid), "%s", ctx->reader->rid);
+            event.tag = tag;
+            event.timestamp = event.firstSeen = event.lastSeen = WallClockMs();
+            event.count = 1;
+            ctx->sink->onEvent(event);
+        } else if (options.mode == BRIDGE_MODE_WINDOW) {
+            ctx->aggregator->observe(tag);
+        } else if (options.mode == BRIDGE_MODE_ZONES) {
+            zones->observe(ctx->zone, tag);
+        } else {
+            ctx->tracker->observe(tag);
+        }
+    }
+    return !isStop;
+}
+
+// Drives departure timeouts while the select loops run
+void TimerLoop(std::vector<ReaderContext *> *contexts) {
+    uint64_t assetCheck = MonotonicMs() + ASSET_CHECK_MS;
+
+    while (!isStop) {
+        usleep(options.tickMs * 1000);
+        // Picks up a table renamed over the old one
+        if (assets != NULL && MonotonicMs() >= assetCheck) {
+            assets->refresh();
+            assetCheck = MonotonicMs() + ASSET_CHECK_MS;
+        }
+        for (size_t i = 0; i < contexts->size(); i++) {
+            (*contexts)[i]->tracker->tick();
+            if ((*contexts)[i]->aggregator != NULL)
+                (*contexts)[i]->aggregator->tick();
+        }
+        if (zones != NULL)
+            zones->tick();
     }
-    return (!isStop);
 }
 
-int CallSelectTags(LPSKYETEK_READER lpReader) {
+int CallSelectTags(ReaderContext *ctx) {
     SKYETEK_STATUS st;
 
-    memset(mqttTopic, 0, 256 * sizeof(TCHAR));
-    _stprintf(mqttTopic, "SkyeT1ek/%s", lpReader->rid);
-    printf("topic: %s\n", mqttTopic);
+    printf("topic: %s\n", ctx->eventTopic);
 
-    // the SkyeTek_SelectTags function does not return until the loop is done
+    // the select loop does not return until the callback stops it
     printf("Entering select loop...\n");
-    st = SkyeTek_SelectTags(lpReader, AUTO_DETECT, SelectLoopCallback, 0, 1, NULL);
+    st = skyetek::SelectTags(ctx->reader, [ctx](const skyetek::Read &read) { return OnRead(ctx, read); });
     if (st != SKYETEK_SUCCESS) {
         printf("Select loop failed\n");
         return 0;
@@ -76,26 +195,183 @@ int CallSelectTags(LPSKYETEK_READER lpReader) {
     return 1;
 }
 
+// Bus reads carry the reader that made them; its context hangs off the reader
+unsigned char BusCallback(LPSKYETEK_READER lpReader, LPSKYETEK_TAG lpTag, void *user) {
+    skyetek::Tag tag(lpTag);
+    skyetek::Read read;
+
+    if (tag)
+        read = skyetek::Read(tag.type(), tag.id());
+    return OnRead((ReaderContext *) lpReader->user, read) ? 1 : 0;
+}
+
+// One loop serves every reader of an RS-485 line in turn
+int CallSelectTagsOnBus(std::vector<LPSKYETEK_READER> *line) {
+    SKYETEK_BUS_SETTINGS settings;
+    SKYETEK_STATUS st;
+
+    settings.dwell = options.busDwellMs;
+    settings.idleDwell = options.busIdleDwellMs;
+    printf("Entering bus loop over %u readers on %s...\n", (unsigned int) line->size(),
+           (*line)[0]->lpDevice->address);
+    st = SkyeTek_SelectTagsOnBus(&(*line)[0], line->size(), AUTO_DETECT, &settings, BusCallback, NULL);
+    if (st != SKYETEK_SUCCESS) {
+        printf("Bus loop failed\n");
+        return 0;
+    }
+    printf("Bus loop done\n");
+    return 1;
+}
+
+void AppendReaders(LPSKYETEK_READER **readers, int &count, LPSKYETEK_READER *found, unsigned int n) {
+    if (n == 0)
+        return;
+    *readers = (LPSKYETEK_READER *) SkyeTek_Realloc(*readers, (count + n) * sizeof(LPSKYETEK_READER));
+    memcpy(*readers + count, found, n * sizeof(LPSKYETEK_READER));
+    count += n;
+    SkyeTek_Free(found);
+}
+
+// Serial devices are scanned as RS-485 lines, any other device holds one reader
+int DiscoverBusReaders(LPSKYETEK_DEVICE *devices, int numDevices, LPSKYETEK_READER **readers) {
+    std::vector<LPSKYETEK_DEVICE> others;
+    LPSKYETEK_READER *found;
+    unsigned int n;
+    int count = 0;
+
+    for (int i = 0; i < numDevices; i++) {
+        if (_tcscmp(devices[i]->type, SKYETEK_SERIAL_DEVICE_TYPE) != 0) {
+            others.push_back(devices[i]);
+            continue;
+        }
+        found = NULL;
+        n = SkyeTek_DiscoverBusReaders(devices[i], options.busFirstRid, options.busLastRid, &found);
+        printf("skyetek-mqtt: %u readers on %s\n", n, devices[i]->address);
+        AppendReaders(readers, count, found, n);
+    }
+    if (!others.empty()) {
+        found = NULL;
+        n = SkyeTek_DiscoverReaders(&others[0], others.size(), &found);
+        AppendReaders(readers, count, found, n);
+    }
+    return count;
+}
+
+void PrintResponseTimes(LPSKYETEK_READER reader) {
+    SKYETEK_RESPONSE_TIME times[16];
+    unsigned int count = 0;
+
+    SkyeTek_GetResponseTimes(reader, times, 16, &count);
+    for (unsigned int i = 0; i < count; i++)
+        printf("skyetek-mqtt: %s: %s%s%s: %u answers, %u ms +- %u, timeout %u ms\n", reader->rid,
+               STPV3_LookupCommand(times[i].command & 0xFFFF),
+               times[i].command & SKYETEK_RESPONSE_INVENTORY ? " inventory" : "",
+               times[i].command & SKYETEK_RESPONSE_LOOP ? " loop" : "",
+               times[i].samples, times[i].srtt, times[i].rttvar, times[i].timeout);
+}
+
+void PrintShedStats(EventBatcher *batcher) {
+    if (batcher != NULL && batcher->collapsed() + batcher->sampled() + batcher->dropped() > 0)
+        printf("skyetek-mqtt: overload: %llu reads folded, %llu sampled out, %llu events dropped of %llu published\n",
+               (unsigned long long) batcher->collapsed(), (unsigned long long) batcher->sampled(),
+               (unsigned long long) batcher->dropped(), (unsigned long long) batcher->events());
+}
+
+// Creates and connects a client, journaling to journalDir if given
+MqttPublisher *OpenPublisher(const char *clientId, const char *journalDir, Journal **journal) {
+    TCHAR ts[26];
+    int rc;
+
+    MqttPublisher *client = new MqttPublisher(options.address, clientId, QOS, TIMEOUT, options.mqttVersion);
+    *journal = NULL;
+    if (journalDir != NULL) {
+        uint32_t segments = options.journalMb / JOURNAL_SEGMENT_MB;
+        *journal = new Journal(journalDir, JOURNAL_SEGMENT_MB * 1024 * 1024, segments);
+        if (!(*journal)->open()) {
+            printf("skyetek-mqtt: cannot open journal in %s\n", journalDir);
+            exit(-1);
+        }
+        client->attachJournal(*journal);
+    }
+    if ((rc = client->connect()) != MQTTCLIENT_SUCCESS) {
+        getTimestamp(ts);
+        printf("skyetek-mqtt [%s]: %s failed to connect, return code %d\n", ts, clientId, rc);
+        if (*journal == NULL)
+            exit(-1);
+        printf("skyetek-mqtt [%s]: journaling to %s until the broker is reachable\n", ts, journalDir);
+    }
+    return client;
+}
+
+void ClosePublisher(MqttPublisher *client, Journal *journal) {
+    client->disconnect();
+    if (client->aliasedPublishes() > 0)
+        printf("skyetek-mqtt: %llu publishes sent a topic alias\n", (unsigned long long) client->aliasedPublishes());
+    delete client;
+    if (journal != NULL) {
+        JournalStats js = journal->stats();
+        printf("skyetek-mqtt: journal: %llu stored, %llu forwarded, %llu dropped, %llu bytes left for the next run\n",
+               (unsigned long long) js.appended, (unsigned long long) js.consumed,
+               (unsigned long long) js.dropped, (unsigned long long) js.pendingBytes);
+        delete journal;
+    }
+}
 
 int main(int argc, char *argv[]) {
 
-    MQTTClient_connectOptions conn_opts = MQTTClient_connectOptions_initializer;
-    MQTTClient_message pubmsg = MQTTClient_message_initializer;
-    MQTTClient_deliveryToken token;
     int rc;
 
     TCHAR ts[26];
 
-    MQTTClient_create(&client, ADDRESS, CLIENTID,
-                      MQTTCLIENT_PERSISTENCE_NONE, NULL);
-    conn_opts.keepAliveInterval = 20;
-    conn_opts.cleansession = 1;
+    if (ParseOptions(argc, argv, options) != 0)
+        exit(-1);
 
-    if ((rc = MQTTClient_connect(client, &conn_opts)) != MQTTCLIENT_SUCCESS) {
-        printf("skyetek-mqtt [%s]: Failed to connect, return code %d\n", ts, rc);
+    if (options.compression != PAYLOAD_COMPRESSION_NONE && !CompressedBatchCodec::available()) {
+        printf("skyetek-mqtt: built without zstd, --compress is not available\n");
         exit(-1);
     }
 
+    signal(SIGINT, StopHandler);
+    signal(SIGTERM, StopHandler);
+
+    if (!options.allowRules.empty() || !options.denyRules.empty() || options.rulesFile != NULL) {
+        filter = new TagFilter();
+        for (size_t i = 0; i < options.allowRules.size(); i++) {
+            if (!filter->addRule(true, options.allowRules[i])) {
+                printf("skyetek-mqtt: bad allow rule %s\n", options.allowRules[i]);
+                exit(-1);
+            }
+        }
+        for (size_t i = 0; i < options.denyRules.size(); i++) {
+            if (!filter->addRule(false, options.denyRules[i])) {
+                printf("skyetek-mqtt: bad deny rule %s\n", options.denyRules[i]);
+                exit(-1);
+            }
+        }
+        if (options.rulesFile != NULL && !filter->loadRules(options.rulesFile)) {
+            printf("skyetek-mqtt: cannot load rules from %s\n", options.rulesFile);
+            exit(-1);
+        }
+        filter->compile();
+    }
+
+    if (options.assetsFile != NULL) {
+        assets = new AssetCatalog(options.assetsFile);
+        if (!assets->refresh())
+            printf("skyetek-mqtt: cannot load assets from %s yet, will retry\n", options.assetsFile);
+    }
+
+    if (options.historyDir != NULL) {
+        history = new HistoryWriter(options.historyDir);
+        if (!history->open()) {
+            printf("skyetek-mqtt: cannot open history in %s\n", options.historyDir);
+            exit(-1);
+        }
+    }
+
+    Journal *journal = NULL;
+    publisher = OpenPublisher(options.clientId, options.journalDir, &journal);
+
     LPSKYETEK_DEVICE *devices = NULL;
     LPSKYETEK_READER *readers = NULL;
     LPSKYETEK_TAG *tags = NULL;
@@ -108,15 +384,178 @@ int main(int argc, char *argv[]) {
     int failures = 0;
     int total = 0;
 
+    if (options.baudCache != NULL)
+        SkyeTek_SetSerialBaudCache(options.baudCache);
+
     if ((numDevices = SkyeTek_DiscoverDevices(&devices)) > 0) {
         //printf("example: devices=%d", numDevices);
-        if ((numReaders = SkyeTek_DiscoverReaders(devices, numDevices, &readers)) > 0) {
+        if (options.bus)
+            numReaders = DiscoverBusReaders(devices, numDevices, &readers);
+        else
+            numReaders = SkyeTek_DiscoverReaders(devices, numDevices, &readers);
+        if (numReaders > 0) {
             //printf("example: readers=%d\n", numReaders);
+            std::vector<ReaderContext *> contexts;
+            for (int i = 0; i < numReaders && options.upshiftBaud; i++) {
+                unsigned int baud = 0;
+                // Moving one reader of a line would cut the others off
+                if (_tcscmp(readers[i]->lpDevice->type, SKYETEK_SERIAL_DEVICE_TYPE) != 0 ||
+                    readers[i]->lpBus != NULL)
+                    continue;
+                SKYETEK_STATUS st = SkyeTek_UpshiftSerialBaud(readers[i], options.maxBaud, &baud);
+                printf("skyetek-mqtt: %s runs at %u baud%s\n", readers[i]->rid, baud,
+                       st == SKYETEK_SUCCESS ? "" : ", baud negotiation failed");
+            }
+            ShedPolicy shed;
+            shed.collapseAt = options.shedCollapse;
+            shed.sampleAt = options.shedSample;
+            shed.dropAt = options.shedDrop;
+            shed.sampleEvery = options.shedEvery;
+            ZoneContext zoneContext;
+            if (options.mode == BRIDGE_MODE_ZONES) {
+                zoneContext.batcher = NULL;
+                zoneContext.codec = NULL;
+                zoneContext.sink = &zoneContext;
+                if (options.batchCount > 0) {
+                    zoneContext.codec = new JsonBatchCodec(assets);
+                    if (options.compression == PAYLOAD_COMPRESSION_ZSTD) {
+                        CompressedBatchCodec *compressed = new CompressedBatchCodec(zoneContext.codec,
+                                                                                    options.compressionLevel);
+                        if (options.dictionary != NULL && !compressed->loadDictionary(options.dictionary))
+                            printf("skyetek-mqtt: cannot load dictionary %s, compressing without it\n",
+                                   options.dictionary);
+                        zoneContext.codec = compressed;
+                    }
+                    zoneContext.batcher = new EventBatcher(publisher, ZONE_TOPIC, zoneContext.codec,
+                                                           options.batchCount, options.batchMs, shed);
+                    zoneContext.sink = zoneContext.batcher;
+                }
+                zones = new ZoneFusion(options.zoneWindowMs, options.absenceMs, options.tickMs, zoneContext.sink);
+            }
             for (int i = 0; i < numReaders; i++) {
+                ReaderContext *ctx = new ReaderContext();
+                ctx->reader = readers[i];
+                readers[i]->user = ctx;
+                ctx->client = publisher;
+                ctx->journal = NULL;
+                // A slow delivery on one connection then holds up only its own reader
+                if (options.clientPerReader) {
+                    std::string clientId = std::string(options.clientId) + "-" + readers[i]->rid;
+                    std::string journalDir;
+                    if (options.journalDir != NULL)
+                        journalDir = std::string(options.journalDir) + "/" + readers[i]->rid;
+                    ctx->client = OpenPublisher(clientId.c_str(), journalDir.empty() ? NULL : journalDir.c_str(),
+                                                &ctx->journal);
+                }
+                if (filter != NULL)
+                    SkyeTek_SetTagFilter(readers[i], FilterRead, filter);
+                SkyeTek_SetResponseTimeoutBounds(readers[i], options.responseFloorMs, options.responseCeilingMs);
+                _stprintf(ctx->mqttTopic, "SkyeT1ek/%s", readers[i]->rid);
+                _stprintf(ctx->presenceTopic, "SkyeT1ek/%s/presence", readers[i]->rid);
+                _stprintf(ctx->windowTopic, "SkyeT1ek/%s/window", readers[i]->rid);
+                if (options.mode == BRIDGE_MODE_RAW)
+                    ctx->eventTopic = ctx->mqttTopic;
+                else if (options.mode == BRIDGE_MODE_WINDOW)
+                    ctx->eventTopic = ctx->windowTopic;
+                else if (options.mode == BRIDGE_MODE_ZONES)
+                    ctx->eventTopic = ZONE_TOPIC;
+                else
+                    ctx->eventTopic = ctx->presenceTopic;
+                ctx->batcher = NULL;
+                ctx->codec = NULL;
+                ctx->aggregator = NULL;
+                ctx->sink = ctx;
+                ctx->zone = -1;
+                if (zones != NULL && (ctx->zone = zones->addReader(readers[i]->rid)) < 0)
+                    printf("skyetek-mqtt: more than %d readers, %s is left out of zones\n",
+                           ZONE_MAX_READERS, readers[i]->rid);
+                if ((options.batchCount > 0 && options.mode != BRIDGE_MODE_ZONES) ||
+                    options.mode == BRIDGE_MODE_WINDOW) {
+                    if (options.format == PAYLOAD_FORMAT_BINARY)
+                        ctx->codec = new BinaryBatchCodec();
+                    else
+                        ctx->codec = new JsonBatchCodec(assets);
+                    if (options.compression == PAYLOAD_COMPRESSION_ZSTD) {
+                        CompressedBatchCodec *compressed = new CompressedBatchCodec(ctx->codec,
+                                                                                    options.compressionLevel);
+                        if (options.dictionary != NULL && !compressed->loadDictionary(options.dictionary))
+                            printf("skyetek-mqtt: cannot load dictionary %s, compressing without it\n",
+                                   options.dictionary);
+                        ctx->codec = compressed;
+                    }
+                }
+                if (options.mode == BRIDGE_MODE_WINDOW) {
+                    ctx->aggregator = new WindowAggregator(readers[i]->rid, options.windowMs, options.slideMs, ctx);
+                } else if (options.batchCount > 0 && options.mode != BRIDGE_MODE_ZONES) {
+                    ctx->batcher = new EventBatcher(ctx->client, ctx->eventTopic, ctx->codec,
+                                                    options.batchCount, options.batchMs, shed);
+                    ctx->sink = ctx->batcher;
+                }
+                ctx->tracker = new PresenceTracker(readers[i]->rid, options.absenceMs, options.tickMs, ctx->sink);
+                contexts.push_back(ctx);
+            }
+
+            // Readers sharing an RS-485 line take turns on it
+            std::vector<std::vector<LPSKYETEK_READER> > lines;
+            for (int i = 0; i < numReaders; i++) {
+                if (readers[i]->lpBus == NULL)
+                    continue;
+                size_t k = 0;
+                while (k < lines.size() && lines[k][0]->lpBus != readers[i]->lpBus)
+                    k++;
+                if (k == lines.size())
+                    lines.push_back(std::vector<LPSKYETEK_READER>());
+                lines[k].push_back(readers[i]);
+            }
+
+            // Every reader or line runs its own select loop, which returns only once isStop is set
+            std::thread timer(TimerLoop, &contexts);
+            std::vector<std::thread> loops;
+            for (size_t i = 0; i < contexts.size() && !isStop; i++) {
                 getTimestamp(ts);
                 printf("skyetek-mqtt [%s]: Reader Found: %s-%s-%s-%s-%s\n", ts, readers[i]->rid, readers[i]->friendly,
                        readers[i]->manufacturer, readers[i]->model, readers[i]->firmware);
-                CallSelectTags(readers[i]);
+                if (readers[i]->lpBus == NULL)
+                    loops.push_back(std::thread(CallSelectTags, contexts[i]));
+            }
+            for (size_t k = 0; k < lines.size() && !isStop; k++)
+                loops.push_back(std::thread(CallSelectTagsOnBus, &lines[k]));
+            for (size_t i = 0; i < loops.size(); i++)
+                loops[i].join();
+            isStop = 1;
+            timer.join();
+
+            if (zones != NULL) {
+                zones->flush();
+                printf("skyetek-mqtt: zones: %llu moves\n", (unsigned long long) zones->changes());
+                delete zones;
+                zones = NULL;
+                PrintShedStats(zoneContext.batcher);
+                delete zoneContext.batcher;     // publishes the last partial batch
+                delete zoneContext.codec;
+            }
+
+            for (size_t i = 0; i < contexts.size(); i++) {
+                PrintResponseTimes(contexts[i]->reader);
+                contexts[i]->tracker->flush();
+                delete contexts[i]->tracker;
+                if (contexts[i]->aggregator != NULL)
+                    contexts[i]->aggregator->flush();   // publishes the current partial window
+                delete contexts[i]->aggregator;
+                PrintShedStats(contexts[i]->batcher);
+                delete contexts[i]->batcher;    // publishes the last partial batch
+                CompressedBatchCodec *compressed = dynamic_cast<CompressedBatchCodec *>(contexts[i]->codec);
+                if (compressed != NULL && compressed->stats().batches > 0) {
+                    CompressionStats cs = compressed->stats();
+                    printf("skyetek-mqtt: %s: %llu batches %llu -> %llu bytes (%.2fx), %llu us CPU\n",
+                           contexts[i]->eventTopic, (unsigned long long) cs.batches,
+                           (unsigned long long) cs.rawBytes, (unsigned long long) cs.compressedBytes,
+                           (double) cs.rawBytes / cs.compressedBytes, (unsigned long long) cs.cpuMicros);
+                }
+                delete contexts[i]->codec;
+                if (contexts[i]->client != publisher)
+                    ClosePublisher(contexts[i]->client, contexts[i]->journal);
+                delete contexts[i];
             }
         }
         else {
@@ -134,8 +573,15 @@ int main(int argc, char *argv[]) {
     SkyeTek_FreeReaders(readers, numReaders);
 //    usleep(delay);
 
-    MQTTClient_disconnect(client, 10000);
-    MQTTClient_destroy(&client);
+    ClosePublisher(publisher, journal);
+    delete history;
+    delete assets;
+    if (filter != NULL) {
+        printf("skyetek-mqtt: filter: %llu reads accepted, %llu denied, %llu matched no allow rule\n",
+               (unsigned long long) filter->accepted(), (unsigned long long) filter->denied(),
+               (unsigned long long) filter->unmatched());
+        delete filter;
+    }
 
     rc = -2;
     return rc;